@@ -0,0 +1,769 @@
+/*
+ * Copyright (c) 2017 Wes Hampson <thehambone93@gmail.com>
+ *
+ * Licensed under the MIT License. See LICENSE at top level directory.
+ */
+
+/**
+ * Benchmark suite for the compiler.
+ *
+ * Compiles every source in a corpus directory, then a set of generated
+ * sources of increasing size, several times each. For each phase, the
+ * throughput, the number of allocations per compile and the peak resident set
+ * size are written to stdout as JSON; progress goes to stderr.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <dirent.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "arena.h"
+#include "compiler.h"
+#include "gxt.h"
+#include "gxtmaker.h"
+#include "io.h"
+#include "pool.h"
+
+#define DEFAULT_ITERATIONS      5
+#define DEFAULT_VALUE_LEN       64
+#define DEFAULT_COMMENT_DENSITY 0.1
+#define MAX_SIZES               16
+#define MAX_ITERATIONS          1000
+
+#if defined(GXTMAKER_SOURCE_DIR)
+#define DEFAULT_CORPUS GXTMAKER_SOURCE_DIR "/test/gta3/ios/src"
+#else
+#define DEFAULT_CORPUS "test/gta3/ios/src"
+#endif
+
+#define BENCH_HELP_MESSAGE \
+"Usage: " GXTMAKER_APP_NAME "-bench [options]\n\
+\nCompiles a corpus of sources, then generated sources of each size, and\n\
+prints throughput, allocations and peak memory use for each as JSON.\n\
+\nOptions:\n\
+    -n N                compile each source N times (default: 5)\n\
+    -j N                use up to N threads per compile\n\
+                        (default: number of CPUs)\n\
+    --corpus DIR        compile the sources in DIR (default: the sources in\n\
+                        test/gta3/ios/src; use \"\" to skip the corpus)\n\
+    --size SIZE         generate a source of SIZE bytes; may be given more\n\
+                        than once, and takes a K, M or G suffix\n\
+                        (default: 1M, 16M and 128M)\n\
+    --keys N            number of keys in each generated source; overrides\n\
+                        --value-len\n\
+    --value-len N       length of each generated value (default: 64)\n\
+    --comment-density P fraction of generated entries that have a comment\n\
+                        (default: 0.1)\n\
+    --work-dir DIR      write generated sources and output to DIR\n\
+                        (default: $TMPDIR or /tmp)\n\
+    --help              show this help menu and exit"
+
+/**
+ * Benchmark settings.
+ */
+struct bench_options
+{
+    int iterations;
+    int num_threads;
+    const char *corpus_dir;
+    const char *work_dir;
+    uint64_t sizes[MAX_SIZES];
+    int num_sizes;
+    uint64_t num_keys;      /* 0 to derive from value_len. */
+    uint64_t value_len;
+    double comment_density;
+};
+
+/**
+ * The results of one phase of the benchmark.
+ */
+struct phase_result
+{
+    uint64_t bytes;         /* Source bytes compiled per iteration. */
+    uint64_t keys;          /* Keys compiled per iteration. */
+    double seconds_min;
+    double seconds_median;
+    double allocs;          /* Allocations per iteration (-1 if unknown). */
+    long peak_rss_kb;       /* Peak RSS during the phase (-1 if unknown). */
+    int status;             /* Status of the first failed compile. */
+};
+
+#if defined(GXTMAKER_BENCH_COUNT_ALLOCS)
+/* The allocation functions are wrapped at link time (--wrap) so that every
+   allocation made by the compiler is counted */
+static atomic_size_t num_allocs;
+
+void * __real_malloc(size_t size);
+void * __real_calloc(size_t n, size_t size);
+void * __real_realloc(void *ptr, size_t size);
+
+void * __wrap_malloc(size_t size)
+{
+    atomic_fetch_add_explicit(&num_allocs, 1, memory_order_relaxed);
+    return __real_malloc(size);
+}
+
+void * __wrap_calloc(size_t n, size_t size)
+{
+    atomic_fetch_add_explicit(&num_allocs, 1, memory_order_relaxed);
+    return __real_calloc(n, size);
+}
+
+void * __wrap_realloc(void *ptr, size_t size)
+{
+    atomic_fetch_add_explicit(&num_allocs, 1, memory_order_relaxed);
+    return __real_realloc(ptr, size);
+}
+#endif
+
+static bool parse_args(int argc, char *argv[], struct bench_options *opts,
+                       bool *show_help);
+static bool parse_size(const char *str, uint64_t *size);
+static bool run_corpus(const struct bench_options *opts,
+                       struct phase_result *res);
+static bool run_synthetic(const struct bench_options *opts, uint64_t size,
+                          struct phase_result *res, uint64_t *value_len);
+static void run_phase(const char * const *src_files, int num_files,
+                      const char *out_file, const struct bench_options *opts,
+                      struct phase_result *res);
+static bool generate_source(const char *path, uint64_t size,
+                            uint64_t value_len, double comment_density,
+                            uint64_t *num_keys);
+static uint64_t count_keys(const char *gxt_file);
+static void reset_peak_rss(void);
+static long read_peak_rss(void);
+static double now(void);
+static int compare_doubles(const void *a, const void *b);
+static void print_phase(const char *name, const struct phase_result *res,
+                        bool *first);
+static char * join_path(const char *dir, const char *name);
+
+int main(int argc, char *argv[])
+{
+    struct bench_options opts = { 0 };
+    opts.iterations = DEFAULT_ITERATIONS;
+    opts.num_threads = pool_num_cpus();
+    opts.corpus_dir = DEFAULT_CORPUS;
+    opts.work_dir = (getenv("TMPDIR") != NULL) ? getenv("TMPDIR") : "/tmp";
+    opts.value_len = DEFAULT_VALUE_LEN;
+    opts.comment_density = DEFAULT_COMMENT_DENSITY;
+
+    bool show_help = false;
+    if (!parse_args(argc, argv, &opts, &show_help))
+    {
+        fprintf(stderr, "%s\n", BENCH_HELP_MESSAGE);
+        return GXTMAKER_EXIT_ARGUMENT_ERROR;
+    }
+    if (show_help)
+    {
+        printf("%s\n", BENCH_HELP_MESSAGE);
+        return GXTMAKER_EXIT_SUCCESS;
+    }
+    if (opts.num_sizes == 0)
+    {
+        opts.sizes[opts.num_sizes++] = 1ULL << 20;
+        opts.sizes[opts.num_sizes++] = 16ULL << 20;
+        opts.sizes[opts.num_sizes++] = 128ULL << 20;
+    }
+
+    printf("{\n");
+    printf("  \"version\": \"%d.%d.%d%s\",\n", GXTMAKER_VERSION_MAJOR,
+           GXTMAKER_VERSION_MINOR, GXTMAKER_VERSION_PATCH,
+           GXTMAKER_VERSION_BUILD);
+    printf("  \"iterations\": %d,\n", opts.iterations);
+    printf("  \"threads\": %d,\n", opts.num_threads);
+    printf("  \"phases\": [");
+
+    /* A file that fails to compile is reported in its phase's status, and
+       doesn't stop the run */
+    bool first = true;
+    struct phase_result res;
+
+    if (opts.corpus_dir[0] != '\0')
+    {
+        fprintf(stderr, "corpus: %s\n", opts.corpus_dir);
+        if (!run_corpus(&opts, &res))
+        {
+            return COMPILE_FILE_UNREADABLE;
+        }
+        print_phase("corpus", &res, &first);
+        printf("\n    }");
+        fflush(stdout);
+    }
+
+    for (int i = 0; i < opts.num_sizes; i++)
+    {
+        char name[64];
+        uint64_t value_len;
+        snprintf(name, sizeof(name), "synthetic-%lluK",
+                 (unsigned long long) (opts.sizes[i] >> 10));
+        fprintf(stderr, "%s\n", name);
+
+        if (!run_synthetic(&opts, opts.sizes[i], &res, &value_len))
+        {
+            return COMPILE_FILE_UNWRITABLE;
+        }
+        print_phase(name, &res, &first);
+        printf(",\n      \"value_len\": %llu,\n",
+               (unsigned long long) value_len);
+        printf("      \"comment_density\": %.3f\n    }",
+               opts.comment_density);
+        fflush(stdout);
+    }
+
+    printf("\n  ]\n}\n");
+
+    return GXTMAKER_EXIT_SUCCESS;
+}
+
+/**
+ * Reads the command line arguments into the benchmark settings.
+ *
+ * @return true if the arguments are valid, false otherwise
+ */
+static bool parse_args(int argc, char *argv[], struct bench_options *opts,
+                       bool *show_help)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        const char *arg = argv[i];
+        if (strcmp(arg, "--help") == 0)
+        {
+            *show_help = true;
+            return true;
+        }
+
+        if (i + 1 >= argc)
+        {
+            fprintf(stderr, "missing or unrecognized argument '%s'\n", arg);
+            return false;
+        }
+
+        const char *val = argv[++i];
+        char *end = NULL;
+        bool valid = true;
+
+        if (strcmp(arg, "-n") == 0)
+        {
+            long n = strtol(val, &end, 10);
+            valid = *end == '\0' && n >= 1 && n <= MAX_ITERATIONS;
+            opts->iterations = (int) n;
+        }
+        else if (strcmp(arg, "-j") == 0)
+        {
+            long n = strtol(val, &end, 10);
+            valid = *end == '\0' && n >= 1 && n <= 256;
+            opts->num_threads = (int) n;
+        }
+        else if (strcmp(arg, "--corpus") == 0)
+        {
+            opts->corpus_dir = val;
+        }
+        else if (strcmp(arg, "--work-dir") == 0)
+        {
+            opts->work_dir = val;
+        }
+        else if (strcmp(arg, "--size") == 0)
+        {
+            valid = opts->num_sizes < MAX_SIZES
+                && parse_size(val, &opts->sizes[opts->num_sizes]);
+            opts->num_sizes++;
+        }
+        else if (strcmp(arg, "--keys") == 0)
+        {
+            valid = parse_size(val, &opts->num_keys) && opts->num_keys > 0;
+        }
+        else if (strcmp(arg, "--value-len") == 0)
+        {
+            valid = parse_size(val, &opts->value_len) && opts->value_len > 0;
+        }
+        else if (strcmp(arg, "--comment-density") == 0)
+        {
+            opts->comment_density = strtod(val, &end);
+            valid = *end == '\0' && opts->comment_density >= 0.0
+                && opts->comment_density <= 1.0;
+        }
+        else
+        {
+            fprintf(stderr, "unrecognized option '%s'\n", arg);
+            return false;
+        }
+
+        if (!valid)
+        {
+            fprintf(stderr, "invalid argument '%s' to '%s'\n", val, arg);
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/**
+ * Parses a number with an optional K, M or G (binary) suffix.
+ */
+static bool parse_size(const char *str, uint64_t *size)
+{
+    char *end;
+    unsigned long long n = strtoull(str, &end, 10);
+    if (end == str)
+    {
+        return false;
+    }
+
+    switch (*end)
+    {
+        case 'K': case 'k': n <<= 10; end++; break;
+        case 'M': case 'm': n <<= 20; end++; break;
+        case 'G': case 'g': n <<= 30; end++; break;
+    }
+
+    *size = n;
+
+    return *end == '\0' && n > 0;
+}
+
+/**
+ * Compiles every file in the corpus directory.
+ *
+ * @return false if the directory could not be read
+ */
+static bool run_corpus(const struct bench_options *opts,
+                       struct phase_result *res)
+{
+    DIR *dir = opendir(opts->corpus_dir);
+    if (dir == NULL)
+    {
+        fprintf(stderr, "unable to read directory '%s'\n", opts->corpus_dir);
+        return false;
+    }
+
+    char **src_files = NULL;
+    int num_files = 0;
+    struct dirent *ent;
+
+    while ((ent = readdir(dir)) != NULL)
+    {
+        if (ent->d_name[0] == '.')
+        {
+            continue;
+        }
+
+        char **grown = (char **)
+            realloc(src_files, (num_files + 1) * sizeof(char *));
+        if (grown == NULL)
+        {
+            break;
+        }
+        src_files = grown;
+        src_files[num_files++] = join_path(opts->corpus_dir, ent->d_name);
+    }
+    closedir(dir);
+
+    char *out_file = join_path(opts->work_dir, "gxtmaker-bench-corpus.gxt");
+    run_phase((const char * const *) src_files, num_files, out_file, opts,
+              res);
+
+    remove(out_file);
+    free(out_file);
+    for (int i = 0; i < num_files; i++)
+    {
+        free(src_files[i]);
+    }
+    free(src_files);
+
+    return true;
+}
+
+/**
+ * Generates a source of the given size and compiles it.
+ *
+ * @return false if the source could not be generated
+ */
+static bool run_synthetic(const struct bench_options *opts, uint64_t size,
+                          struct phase_result *res, uint64_t *value_len)
+{
+    /* Each entry is "[KXXXXXX]\n" plus the value and its newline */
+    const uint64_t entry_overhead = GXT_KEY_MAX_LEN + 3;
+
+    *value_len = opts->value_len;
+    if (opts->num_keys > 0)
+    {
+        uint64_t entry_size = size / opts->num_keys;
+        *value_len = (entry_size > entry_overhead + 1)
+                   ? entry_size - entry_overhead : 1;
+    }
+
+    char *src_file = join_path(opts->work_dir, "gxtmaker-bench-src.txt");
+    char *out_file = join_path(opts->work_dir, "gxtmaker-bench-src.gxt");
+    uint64_t num_keys;
+
+    bool generated = generate_source(src_file, size, *value_len,
+                                     opts->comment_density, &num_keys);
+    if (!generated)
+    {
+        fprintf(stderr, "unable to write file '%s'\n", src_file);
+    }
+    else
+    {
+        const char *src_files[1] = { src_file };
+        run_phase(src_files, 1, out_file, opts, res);
+    }
+
+    remove(src_file);
+    remove(out_file);
+    free(src_file);
+    free(out_file);
+
+    return generated;
+}
+
+/**
+ * Compiles a set of files opts->iterations times, one after another,
+ * measuring the whole set each time.
+ */
+static void run_phase(const char * const *src_files, int num_files,
+                      const char *out_file, const struct bench_options *opts,
+                      struct phase_result *res)
+{
+    /* Files are compiled the way a batch worker compiles them, with one
+       arena reused from file to file */
+    struct compile_options copts = { 0 };
+    copts.num_threads = opts->num_threads;
+    arena_create(&copts.arena);
+
+    double *times = (double *) calloc(opts->iterations, sizeof(double));
+
+    memset(res, 0, sizeof(struct phase_result));
+    res->allocs = -1;
+    reset_peak_rss();
+
+#if defined(GXTMAKER_BENCH_COUNT_ALLOCS)
+    size_t allocs_before = atomic_load(&num_allocs);
+#endif
+
+    for (int it = 0; it < opts->iterations; it++)
+    {
+        double start = now();
+        for (int i = 0; i < num_files; i++)
+        {
+            /* A failed compile leaves the last file's output behind, which
+               mustn't be counted as this file's; removing it isn't timed */
+            double pause = now();
+            remove(out_file);
+            start += now() - pause;
+
+            /* Diagnostics are only shown once */
+            struct diag_buf diag = DIAG_BUF_INIT;
+            int status = compile(src_files[i], out_file, &copts, &diag);
+            if (it == 0)
+            {
+                diag_buf_flush(&diag, stderr);
+            }
+            diag_buf_free(&diag);
+
+            if (status != COMPILE_SUCCESS && res->status == COMPILE_SUCCESS)
+            {
+                res->status = status;
+            }
+
+            /* Sizes are only counted once, and only for files that
+               compiled; reading them isn't timed */
+            if (it == 0 && status == COMPILE_SUCCESS)
+            {
+                pause = now();
+                uint64_t size;
+                int64_t mtime;
+                if (stat_file(src_files[i], &size, &mtime))
+                {
+                    res->bytes += size;
+                }
+                res->keys += count_keys(out_file);
+                start += now() - pause;
+            }
+        }
+
+        if (times != NULL)
+        {
+            times[it] = now() - start;
+        }
+    }
+
+#if defined(GXTMAKER_BENCH_COUNT_ALLOCS)
+    res->allocs = (double) (atomic_load(&num_allocs) - allocs_before)
+                / opts->iterations;
+#endif
+    res->peak_rss_kb = read_peak_rss();
+
+    arena_destroy(&copts.arena);
+
+    if (times != NULL)
+    {
+        qsort(times, opts->iterations, sizeof(double), compare_doubles);
+        res->seconds_min = times[0];
+        res->seconds_median = times[opts->iterations / 2];
+        free(times);
+    }
+}
+
+/**
+ * Writes a source file made of generated entries.
+ *
+ * Keys are numbered in base 36. Values are words of lowercase ASCII with the
+ * odd accented letter, so that both the ASCII fast path and the charset
+ * lookup get used. A "[DUMMY]" entry goes at the end, as the last entry is
+ * never compiled.
+ *
+ * @param num_keys a pointer to where the number of keys written should be
+ *                 stored
+ *
+ * @return true if the file was written, false otherwise
+ */
+static bool generate_source(const char *path, uint64_t size,
+                            uint64_t value_len, double comment_density,
+                            uint64_t *num_keys)
+{
+    static const char digits[] = "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZ";
+    static const char comment[] = "{ Generated entry, not compiled. }\n";
+
+    FILE *fp = fopen(path, "wb");
+    if (fp == NULL)
+    {
+        return false;
+    }
+
+    char *value = (char *) malloc(value_len + 1);
+    if (value == NULL)
+    {
+        fclose(fp);
+        return false;
+    }
+
+    /* Fixed seed, so runs are comparable */
+    uint32_t rng = 0x2545F491;
+    uint32_t comment_threshold = (uint32_t) (comment_density * 0xFFFFFFFFu);
+    uint64_t written = 0;
+    uint64_t n = 0;
+
+    while (written < size)
+    {
+        rng ^= rng << 13;
+        rng ^= rng >> 17;
+        rng ^= rng << 5;
+        if (comment_density > 0.0 && rng <= comment_threshold)
+        {
+            fputs(comment, fp);
+            written += sizeof(comment) - 1;
+        }
+
+        char key[GXT_KEY_MAX_LEN];
+        uint64_t id = n;
+        key[0] = 'K';
+        for (int i = GXT_KEY_MAX_LEN - 2; i >= 1; i--)
+        {
+            key[i] = digits[id % 36];
+            id /= 36;
+        }
+        key[GXT_KEY_MAX_LEN - 1] = '\0';
+
+        /* Words of 1-8 letters; every 16th word starts with U+00E9 */
+        size_t len = 0;
+        while (len < value_len)
+        {
+            rng ^= rng << 13;
+            rng ^= rng >> 17;
+            rng ^= rng << 5;
+
+            if ((rng & 0xF00) == 0 && len > 0 && len + 2 <= value_len)
+            {
+                value[len++] = (char) 0xC3;
+                value[len++] = (char) 0xA9;
+            }
+
+            size_t word_len = 1 + (rng & 7);
+            for (size_t i = 0; i < word_len && len < value_len; i++)
+            {
+                value[len++] = (char) ('a' + (rng >> (8 + i * 3)) % 26);
+            }
+            if (len < value_len && len > 0)
+            {
+                value[len++] = ' ';
+            }
+        }
+
+        value[len++] = '\n';
+
+        fprintf(fp, "[%s]\n", key);
+        fwrite(value, 1, len, fp);
+        written += GXT_KEY_MAX_LEN + 2 + len;
+        n++;
+    }
+
+    fputs("[DUMMY]\nTHIS LABEL NEEDS TO BE HERE AS THE LAST LABEL DOES NOT "
+          "GET COMPILED\n", fp);
+
+    free(value);
+
+    *num_keys = n;
+
+    return fclose(fp) == 0;
+}
+
+/**
+ * Reads the number of keys in a GTA3-format GXT file from its TKEY header.
+ */
+static uint64_t count_keys(const char *gxt_file)
+{
+    FILE *fp = fopen(gxt_file, "rb");
+    if (fp == NULL)
+    {
+        return 0;
+    }
+
+    struct gxt_block_header header;
+    bool read = fread(&header, sizeof(header), 1, fp) == 1;
+    fclose(fp);
+
+    return read ? header.size / sizeof(struct gxt_key) : 0;
+}
+
+/**
+ * Resets the peak RSS counter, where the kernel allows it (Linux).
+ * Elsewhere, the peak is over the life of the process.
+ */
+static void reset_peak_rss(void)
+{
+    FILE *fp = fopen("/proc/self/clear_refs", "w");
+    if (fp != NULL)
+    {
+        fputs("5", fp);
+        fclose(fp);
+    }
+}
+
+/**
+ * Gets the peak RSS in kilobytes since the last reset_peak_rss().
+ *
+ * @return the peak RSS, or -1 if it is not available
+ */
+static long read_peak_rss(void)
+{
+    FILE *fp = fopen("/proc/self/status", "r");
+    if (fp != NULL)
+    {
+        char line[256];
+        long kb = -1;
+        while (fgets(line, sizeof(line), fp) != NULL)
+        {
+            if (strncmp(line, "VmHWM:", 6) == 0)
+            {
+                kb = strtol(line + 6, NULL, 10);
+                break;
+            }
+        }
+        fclose(fp);
+
+        if (kb >= 0)
+        {
+            return kb;
+        }
+    }
+
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0)
+    {
+        return -1;
+    }
+
+#if defined(__APPLE__)
+    return usage.ru_maxrss / 1024;
+#else
+    return usage.ru_maxrss;
+#endif
+}
+
+/**
+ * Gets the current time in seconds from a monotonic clock.
+ */
+static double now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int compare_doubles(const void *a, const void *b)
+{
+    double x = *(const double *) a;
+    double y = *(const double *) b;
+
+    return (x > y) - (x < y);
+}
+
+/**
+ * Prints the fields common to every phase, leaving the phase's object open.
+ */
+static void print_phase(const char *name, const struct phase_result *res,
+                        bool *first)
+{
+    double secs = res->seconds_median;
+
+    printf("%s\n    {\n", *first ? "" : ",");
+    printf("      \"name\": \"%s\",\n", name);
+    printf("      \"status\": %d,\n", res->status);
+    printf("      \"bytes\": %llu,\n", (unsigned long long) res->bytes);
+    printf("      \"keys\": %llu,\n", (unsigned long long) res->keys);
+    printf("      \"seconds_min\": %.6f,\n", res->seconds_min);
+    printf("      \"seconds_median\": %.6f,\n", secs);
+    printf("      \"mb_per_s\": %.2f,\n",
+           (secs > 0) ? res->bytes / secs / (1 << 20) : 0.0);
+    printf("      \"keys_per_s\": %.0f,\n",
+           (secs > 0) ? res->keys / secs : 0.0);
+    if (res->allocs >= 0)
+    {
+        printf("      \"allocs\": %.0f,\n", res->allocs);
+    }
+    else
+    {
+        printf("      \"allocs\": null,\n");
+    }
+    if (res->peak_rss_kb >= 0)
+    {
+        printf("      \"peak_rss_kb\": %ld", res->peak_rss_kb);
+    }
+    else
+    {
+        printf("      \"peak_rss_kb\": null");
+    }
+
+    *first = false;
+}
+
+/**
+ * Joins a directory and a file name.
+ *
+ * @return the path (must be freed by the caller)
+ */
+static char * join_path(const char *dir, const char *name)
+{
+    size_t dir_len = strlen(dir);
+    size_t len = dir_len + 1 + strlen(name);
+
+    char *path = (char *) malloc(len + 1);
+    if (path != NULL)
+    {
+        snprintf(path, len + 1, "%s/%s", dir, name);
+    }
+
+    return path;
+}
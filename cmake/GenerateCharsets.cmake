@@ -0,0 +1,71 @@
+# Generates the character set tables from the charsets/*.txt definitions.
+#
+# Usage: cmake -DOUTPUT=<file.c> -DCHARSETS="<a.txt>|<b.txt>" -P GenerateCharsets.cmake
+#
+# Each definition becomes a 128-entry table for U+0080-U+00FF plus a lookup
+# function for everything above U+00FF, and a reverse lookup from non-ASCII
+# glyphs back to the first character listed for them. The charset is named
+# after its file.
+
+# The list is '|'-separated so it survives being passed on a command line
+string(REPLACE "|" ";" CHARSETS "${CHARSETS}")
+
+set(code "/* Generated from the charsets/ definitions by cmake/GenerateCharsets.cmake. */\n")
+set(code "${code}/* Do not edit. */\n\n#include \"charset.h\"\n")
+set(list_code "")
+set(count 0)
+
+foreach(def ${CHARSETS})
+    get_filename_component(name "${def}" NAME_WE)
+    file(READ "${def}" contents)
+    string(MD5 digest "${contents}")
+    string(SUBSTRING "${digest}" 0 16 digest)
+    file(STRINGS "${def}" lines)
+
+    set(table "")
+    set(cases "")
+    set(reverse_cases "")
+    set(glyphs_seen "")
+    foreach(line ${lines})
+        string(REGEX REPLACE "#.*$" "" line "${line}")
+        string(STRIP "${line}" line)
+        if(line STREQUAL "")
+            # Blank or comment-only line
+        elseif(NOT line MATCHES "^U\\+([0-9A-Fa-f]+)[ \t]+(0x[0-9A-Fa-f]+)$")
+            message(FATAL_ERROR "${def}: invalid line '${line}'")
+        else()
+            set(cp "${CMAKE_MATCH_1}")
+            string(TOUPPER "${CMAKE_MATCH_2}" glyph)
+            string(REPLACE "0X" "0x" glyph "${glyph}")
+
+            if(cp MATCHES "^0*[0-7]?[0-9A-Fa-f]$")
+                message(FATAL_ERROR "${def}: ASCII can't be remapped (U+${cp})")
+            elseif(cp MATCHES "^0*[89A-Fa-f][0-9A-Fa-f]$")
+                set(table "${table}    [0x${cp} - 0x80] = ${glyph},\n")
+            else()
+                set(cases "${cases}        case 0x${cp}: return ${glyph};\n")
+            endif()
+
+            list(FIND glyphs_seen "${glyph}" seen)
+            if(seen EQUAL -1 AND NOT glyph MATCHES "^0x0*[0-7]?[0-9A-F]$")
+                list(APPEND glyphs_seen "${glyph}")
+                set(reverse_cases "${reverse_cases}        case ${glyph}: return 0x${cp};\n")
+            endif()
+        endif()
+    endforeach()
+
+    set(code "${code}\nstatic const gxt_char ${name}_latin1[128] =\n{\n${table}};\n")
+    set(code "${code}\nstatic gxt_char ${name}_lookup(uint32_t code_point)\n{\n")
+    set(code "${code}    switch (code_point)\n    {\n${cases}")
+    set(code "${code}        default: return 0;\n    }\n}\n")
+    set(code "${code}\nstatic uint32_t ${name}_reverse(gxt_char glyph)\n{\n")
+    set(code "${code}    switch (glyph)\n    {\n${reverse_cases}")
+    set(code "${code}        default: return 0;\n    }\n}\n")
+    set(list_code "${list_code}    { \"${name}\", 0x${digest}ULL, ${name}_latin1, ${name}_lookup, ${name}_reverse },\n")
+    math(EXPR count "${count} + 1")
+endforeach()
+
+set(code "${code}\nconst struct charset charset_list[] =\n{\n${list_code}};\n")
+set(code "${code}\nconst int charset_count = ${count};\n")
+
+file(WRITE "${OUTPUT}" "${code}")
@@ -0,0 +1,175 @@
+# Generates the formatting token tables from the tokens/*.txt definitions.
+#
+# Usage: cmake -DOUTPUT=<file.c> -DTOKENS="<a.txt>|<b.txt>" -P GenerateTokens.cmake
+#
+# Each definition becomes a perfect hash table: every name is first hashed
+# into a bucket, and each bucket gets a seed that hashes all of its names into
+# slots no other name uses, so a lookup is two hashes and one compare. The
+# hash must match token_hash() in src/token.c. The token set is named after
+# its file.
+
+# The list is '|'-separated so it survives being passed on a command line
+string(REPLACE "|" ";" TOKENS "${TOKENS}")
+
+# Char codes are looked up by position; names only use these chars
+set(alphabet "0123456789<>ABCDEFGHIJKLMNOPQRSTUVWXYZ_abcdefghijklmnopqrstuvwxyz")
+set(alphabet_codes 48 49 50 51 52 53 54 55 56 57 60 62)
+foreach(code RANGE 65 90)
+    list(APPEND alphabet_codes ${code})
+endforeach()
+list(APPEND alphabet_codes 95)
+foreach(code RANGE 97 122)
+    list(APPEND alphabet_codes ${code})
+endforeach()
+
+# Computes token_hash() of a name, given as a list of char codes
+function(token_hash codes seed out)
+    math(EXPR h "2166136261 ^ ${seed}")
+    foreach(c ${codes})
+        math(EXPR h "((${h} ^ ${c}) * 16777619) & 4294967295")
+    endforeach()
+    math(EXPR h "${h} ^ (${h} >> 16)")
+    set(${out} ${h} PARENT_SCOPE)
+endfunction()
+
+set(code "/* Generated from the tokens/ definitions by cmake/GenerateTokens.cmake. */\n")
+set(code "${code}/* Do not edit. */\n\n#include \"token.h\"\n")
+set(list_code "")
+set(count 0)
+
+foreach(def ${TOKENS})
+    get_filename_component(name "${def}" NAME_WE)
+    file(READ "${def}" contents)
+    string(MD5 digest "${contents}")
+    string(SUBSTRING "${digest}" 0 16 digest)
+    file(STRINGS "${def}" lines)
+
+    # Read the tokens, along with the char codes of their names
+    set(names "")
+    set(num_tokens 0)
+    foreach(line ${lines})
+        string(REGEX REPLACE "#.*$" "" line "${line}")
+        string(STRIP "${line}" line)
+        if(line STREQUAL "")
+            # Blank or comment-only line
+        elseif(NOT line MATCHES "^(format|key|control)[ \t]+([0-9<>A-Z_a-z]+)$")
+            message(FATAL_ERROR "${def}: invalid line '${line}'")
+        else()
+            set(kind "${CMAKE_MATCH_1}")
+            set(tok "${CMAKE_MATCH_2}")
+            string(LENGTH "${tok}" len)
+            if(len GREATER 63)
+                message(FATAL_ERROR "${def}: token '${tok}' is too long")
+            endif()
+            list(FIND names "${tok}" seen)
+            if(NOT seen EQUAL -1)
+                message(FATAL_ERROR "${def}: token '${tok}' is listed twice")
+            endif()
+            list(APPEND names "${tok}")
+
+            set(codes "")
+            math(EXPR last "${len} - 1")
+            foreach(i RANGE ${last})
+                string(SUBSTRING "${tok}" ${i} 1 ch)
+                string(FIND "${alphabet}" "${ch}" pos)
+                list(GET alphabet_codes ${pos} c)
+                list(APPEND codes ${c})
+            endforeach()
+
+            string(TOUPPER "${kind}" kind)
+            set(tok_${num_tokens} "${tok}")
+            set(kind_${num_tokens} "TOKEN_${kind}")
+            set(codes_${num_tokens} "${codes}")
+            math(EXPR num_tokens "${num_tokens} + 1")
+        endif()
+    endforeach()
+    if(num_tokens EQUAL 0)
+        message(FATAL_ERROR "${def}: no tokens")
+    endif()
+
+    # Size the table to a power of two with some room to spare, and use a
+    # bucket for every three or so tokens
+    set(num_slots 1)
+    while(num_slots LESS num_tokens OR num_slots EQUAL num_tokens)
+        math(EXPR num_slots "${num_slots} * 2")
+    endwhile()
+    math(EXPR slot_mask "${num_slots} - 1")
+    math(EXPR num_buckets "(${num_tokens} + 2) / 3")
+    math(EXPR last_token "${num_tokens} - 1")
+    math(EXPR last_bucket "${num_buckets} - 1")
+    math(EXPR last_slot "${num_slots} - 1")
+
+    foreach(b RANGE ${last_bucket})
+        set(bucket_${b} "")
+        set(seed_${b} 0)
+    endforeach()
+    foreach(t RANGE ${last_token})
+        token_hash("${codes_${t}}" 0 h)
+        math(EXPR b "${h} % ${num_buckets}")
+        list(APPEND bucket_${b} ${t})
+    endforeach()
+    foreach(s RANGE ${last_slot})
+        set(slot_${s} "")
+    endforeach()
+
+    # Place the biggest buckets first, while the table is emptiest
+    foreach(size RANGE ${num_tokens} 1 -1)
+        foreach(b RANGE ${last_bucket})
+            list(LENGTH bucket_${b} bucket_size)
+            if(bucket_size EQUAL size)
+                set(seed 1)
+                set(placed FALSE)
+                while(NOT placed)
+                    if(seed GREATER 65535)
+                        message(FATAL_ERROR "${def}: no perfect hash found")
+                    endif()
+                    set(slots "")
+                    set(placed TRUE)
+                    foreach(t ${bucket_${b}})
+                        token_hash("${codes_${t}}" ${seed} h)
+                        math(EXPR s "${h} & ${slot_mask}")
+                        list(FIND slots ${s} taken)
+                        if(NOT slot_${s} STREQUAL "" OR NOT taken EQUAL -1)
+                            set(placed FALSE)
+                            break()
+                        endif()
+                        list(APPEND slots ${s})
+                    endforeach()
+                    if(NOT placed)
+                        math(EXPR seed "${seed} + 1")
+                    endif()
+                endwhile()
+
+                set(seed_${b} ${seed})
+                set(i 0)
+                foreach(t ${bucket_${b}})
+                    list(GET slots ${i} s)
+                    set(slot_${s} ${t})
+                    math(EXPR i "${i} + 1")
+                endforeach()
+            endif()
+        endforeach()
+    endforeach()
+
+    set(table "")
+    foreach(s RANGE ${last_slot})
+        if(NOT slot_${s} STREQUAL "")
+            set(t ${slot_${s}})
+            set(table "${table}    [${s}] = { \"${tok_${t}}\", ${kind_${t}} },\n")
+        endif()
+    endforeach()
+    set(seeds "")
+    foreach(b RANGE ${last_bucket})
+        set(seeds "${seeds}    ${seed_${b}},\n")
+    endforeach()
+
+    set(code "${code}\nstatic const struct token_def ${name}_tokens[${num_slots}] =\n{\n${table}};\n")
+    set(code "${code}\nstatic const uint16_t ${name}_seeds[${num_buckets}] =\n{\n${seeds}};\n")
+    set(list_code "${list_code}    { \"${name}\", 0x${digest}ULL, ${name}_tokens, ${name}_seeds, ${num_slots}, ${num_buckets} },\n")
+    math(EXPR count "${count} + 1")
+endforeach()
+
+set(code "${code}\nconst struct token_set token_set_list[] =\n{\n${list_code}};\n")
+set(code "${code}\nconst int token_set_count = ${count};\n")
+
+file(WRITE "${OUTPUT}" "${code}")
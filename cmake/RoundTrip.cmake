@@ -0,0 +1,30 @@
+# Checks that a GXT file comes back byte for byte after being decompiled and
+# compiled again.
+#
+# Usage: cmake -DGXTMAKER=<gxtmaker> -DGXT=<file.gxt> -DWORK_DIR=<dir>
+#              -P RoundTrip.cmake
+
+get_filename_component(name "${GXT}" NAME_WE)
+set(src_dir "${WORK_DIR}/src")
+set(out_dir "${WORK_DIR}/out")
+file(REMOVE_RECURSE "${WORK_DIR}")
+file(MAKE_DIRECTORY "${src_dir}" "${out_dir}")
+
+execute_process(COMMAND "${GXTMAKER}" decompile -o "${src_dir}" "${GXT}"
+                RESULT_VARIABLE result)
+if(NOT result EQUAL 0)
+    message(FATAL_ERROR "${GXT}: decompile failed (${result})")
+endif()
+
+execute_process(COMMAND "${GXTMAKER}" -o "${out_dir}" "${src_dir}/${name}.txt"
+                RESULT_VARIABLE result)
+if(NOT result EQUAL 0)
+    message(FATAL_ERROR "${GXT}: compile failed (${result})")
+endif()
+
+execute_process(COMMAND "${CMAKE_COMMAND}" -E compare_files
+                        "${GXT}" "${out_dir}/${name}.gxt"
+                RESULT_VARIABLE result)
+if(NOT result EQUAL 0)
+    message(FATAL_ERROR "${GXT}: recompiled file differs")
+endif()
@@ -0,0 +1,388 @@
+/*
+ * Copyright (c) 2017 Wes Hampson <thehambone93@gmail.com>
+ *
+ * Licensed under the MIT License. See LICENSE at top level directory.
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+#include "arena.h"
+#include "mem.h"
+
+#define ARENA_ALIGNMENT     16
+#define ARENA_BLOCK_SIZE    (64 * 1024)
+
+/* Allocations bigger than this get a block of their own */
+#define ARENA_LARGE_SIZE    (ARENA_BLOCK_SIZE / 4)
+
+/* Most memory kept in spare blocks across a reset */
+#define ARENA_MAX_RETAINED  ((size_t) 64 * 1024 * 1024)
+
+#define ALIGN_UP(n) \
+    (((n) + (ARENA_ALIGNMENT - 1)) & ~((size_t) ARENA_ALIGNMENT - 1))
+
+/**
+ * A block of memory that allocations are made from. A shared block holds
+ * small allocations packed one after another; a large allocation has a block
+ * to itself, and its size is the block's size.
+ */
+struct arena_block
+{
+    struct arena_block *prev;
+    struct arena_block *next;
+    size_t size;    /* Bytes of data following the header. */
+    size_t used;    /* Bytes handed out so far (shared blocks only). */
+};
+
+#define BLOCK_HEADER_SIZE   ALIGN_UP(sizeof(struct arena_block))
+#define BLOCK_DATA(b)       ((char *) (b) + BLOCK_HEADER_SIZE)
+#define DATA_BLOCK(p)       ((struct arena_block *) ((char *) (p) - BLOCK_HEADER_SIZE))
+
+struct arena_s      /* typedef'd in arena.h as 'arena' */
+{
+    struct allocator alloc;         /* Where blocks come from. */
+    struct arena_block *blocks;     /* Blocks in use (doubly linked). */
+    struct arena_block *current;    /* Shared block being allocated from. */
+    struct arena_block *spare;      /* Blocks kept from before the last
+                                       reset (singly linked). */
+    size_t spare_size;              /* Total size of the spare blocks. */
+};
+
+static size_t round_size(size_t size);
+static bool is_last_alloc(const arena *a, const void *ptr, size_t size);
+static struct arena_block * take_block(arena *a, size_t size);
+static void retire_block(arena *a, struct arena_block *b);
+static void free_block(arena *a, struct arena_block *b);
+static void free_blocks(arena *a, struct arena_block *b);
+
+bool arena_create(arena **a)
+{
+    return arena_create_with(a, &mem_heap_allocator);
+}
+
+bool arena_create_with(arena **a, const struct allocator *alloc)
+{
+    *a = (arena *) alloc->alloc(alloc->ctx, sizeof(arena));
+    if (*a == NULL)
+    {
+        return false;
+    }
+
+    memset(*a, 0, sizeof(arena));
+    (*a)->alloc = *alloc;
+
+    return true;
+}
+
+const struct allocator * arena_allocator(const arena *a)
+{
+    return &a->alloc;
+}
+
+bool arena_destroy(arena **a)
+{
+    if (*a == NULL)
+    {
+        return false;
+    }
+
+    struct allocator alloc = (*a)->alloc;
+
+    free_blocks(*a, (*a)->blocks);
+    free_blocks(*a, (*a)->spare);
+    alloc.free(alloc.ctx, *a, sizeof(arena));
+    *a = NULL;
+
+    return true;
+}
+
+void arena_reset(arena *a)
+{
+    while (a->blocks != NULL)
+    {
+        retire_block(a, a->blocks);
+    }
+
+    a->current = NULL;
+}
+
+void * arena_alloc(arena *a, size_t size)
+{
+    size = round_size(size);
+    if (size == 0)
+    {
+        return NULL;
+    }
+
+    if (size > ARENA_LARGE_SIZE)
+    {
+        struct arena_block *b = take_block(a, size);
+        if (b == NULL)
+        {
+            return NULL;
+        }
+
+        b->used = b->size;
+        return BLOCK_DATA(b);
+    }
+
+    /* Whatever is left of the current block is abandoned; it is never more
+       than a large allocation */
+    if (a->current == NULL || a->current->size - a->current->used < size)
+    {
+        struct arena_block *b = take_block(a, ARENA_BLOCK_SIZE);
+        if (b == NULL)
+        {
+            return NULL;
+        }
+
+        a->current = b;
+    }
+
+    char *p = BLOCK_DATA(a->current) + a->current->used;
+    a->current->used += size;
+
+    return p;
+}
+
+void * arena_calloc(arena *a, size_t n, size_t size)
+{
+    if (size != 0 && n > SIZE_MAX / size)
+    {
+        return NULL;
+    }
+
+    void *p = arena_alloc(a, n * size);
+    if (p != NULL)
+    {
+        memset(p, 0, n * size);
+    }
+
+    return p;
+}
+
+void * arena_realloc(arena *a, void *ptr, size_t old_size, size_t new_size)
+{
+    if (ptr == NULL)
+    {
+        return arena_alloc(a, new_size);
+    }
+
+    size_t old_rounded = round_size(old_size);
+    size_t new_rounded = round_size(new_size);
+    if (new_rounded == 0)
+    {
+        return NULL;
+    }
+
+    if (old_rounded > ARENA_LARGE_SIZE && new_rounded > ARENA_LARGE_SIZE)
+    {
+        struct arena_block *b = DATA_BLOCK(ptr);
+        if (new_rounded <= b->size)
+        {
+            return ptr;
+        }
+
+        /* The block may move, so its neighbours are pointed at it again */
+        b = (struct arena_block *)
+            a->alloc.realloc(a->alloc.ctx, b, BLOCK_HEADER_SIZE + b->size,
+                             BLOCK_HEADER_SIZE + new_rounded);
+        if (b == NULL)
+        {
+            return NULL;
+        }
+
+        b->size = new_rounded;
+        b->used = new_rounded;
+        if (b->prev != NULL)
+        {
+            b->prev->next = b;
+        }
+        else
+        {
+            a->blocks = b;
+        }
+        if (b->next != NULL)
+        {
+            b->next->prev = b;
+        }
+
+        return BLOCK_DATA(b);
+    }
+
+    if (old_rounded <= ARENA_LARGE_SIZE && new_rounded <= ARENA_LARGE_SIZE)
+    {
+        if (new_rounded <= old_rounded)
+        {
+            if (is_last_alloc(a, ptr, old_rounded))
+            {
+                a->current->used -= old_rounded - new_rounded;
+            }
+            return ptr;
+        }
+        if (is_last_alloc(a, ptr, old_rounded)
+            && a->current->size - a->current->used >= new_rounded - old_rounded)
+        {
+            a->current->used += new_rounded - old_rounded;
+            return ptr;
+        }
+    }
+
+    /* Moving between a shared block and a block of its own */
+    void *p = arena_alloc(a, new_size);
+    if (p == NULL)
+    {
+        return NULL;
+    }
+
+    memcpy(p, ptr, (old_size < new_size) ? old_size : new_size);
+    arena_free(a, ptr, old_size);
+
+    return p;
+}
+
+void arena_free(arena *a, void *ptr, size_t size)
+{
+    if (ptr == NULL)
+    {
+        return;
+    }
+
+    size = round_size(size);
+    if (size > ARENA_LARGE_SIZE)
+    {
+        retire_block(a, DATA_BLOCK(ptr));
+    }
+    else if (is_last_alloc(a, ptr, size))
+    {
+        a->current->used -= size;
+    }
+}
+
+/**
+ * Rounds an allocation size up to keep the next allocation aligned. Empty
+ * allocations are given a size so that every allocation has its own address.
+ *
+ * @return the rounded size, or 0 if the size is too big to allocate
+ */
+static size_t round_size(size_t size)
+{
+    if (size > SIZE_MAX - BLOCK_HEADER_SIZE - ARENA_ALIGNMENT)
+    {
+        return 0;
+    }
+
+    return (size == 0) ? ARENA_ALIGNMENT : ALIGN_UP(size);
+}
+
+/**
+ * Checks whether a small allocation is the most recent one made from the
+ * current block, so that it can be resized in place.
+ */
+static bool is_last_alloc(const arena *a, const void *ptr, size_t size)
+{
+    const struct arena_block *b = a->current;
+
+    return b != NULL
+        && (const char *) ptr >= BLOCK_DATA(b)
+        && (const char *) ptr + size == BLOCK_DATA(b) + b->used;
+}
+
+/**
+ * Gets a block with room for at least size bytes and puts it in use. The
+ * smallest spare block that is big enough is used if there is one; otherwise
+ * a new block is allocated.
+ *
+ * @return the block, or NULL if memory could not be allocated
+ */
+static struct arena_block * take_block(arena *a, size_t size)
+{
+    struct arena_block **best = NULL;
+    for (struct arena_block **link = &a->spare; *link != NULL;
+         link = &(*link)->next)
+    {
+        if ((*link)->size >= size && (best == NULL || (*link)->size < (*best)->size))
+        {
+            best = link;
+        }
+    }
+
+    struct arena_block *b;
+    if (best != NULL)
+    {
+        b = *best;
+        *best = b->next;
+        a->spare_size -= b->size;
+    }
+    else
+    {
+        b = (struct arena_block *)
+            a->alloc.alloc(a->alloc.ctx, BLOCK_HEADER_SIZE + size);
+        if (b == NULL)
+        {
+            return NULL;
+        }
+        b->size = size;
+    }
+
+    b->used = 0;
+    b->prev = NULL;
+    b->next = a->blocks;
+    if (a->blocks != NULL)
+    {
+        a->blocks->prev = b;
+    }
+    a->blocks = b;
+
+    return b;
+}
+
+/**
+ * Takes a block out of use, keeping it as a spare unless that would put the
+ * arena over its retention limit.
+ */
+static void retire_block(arena *a, struct arena_block *b)
+{
+    if (b->prev != NULL)
+    {
+        b->prev->next = b->next;
+    }
+    else
+    {
+        a->blocks = b->next;
+    }
+    if (b->next != NULL)
+    {
+        b->next->prev = b->prev;
+    }
+    if (b == a->current)
+    {
+        a->current = NULL;
+    }
+
+    if (a->spare_size + b->size > ARENA_MAX_RETAINED)
+    {
+        free_block(a, b);
+        return;
+    }
+
+    b->next = a->spare;
+    a->spare = b;
+    a->spare_size += b->size;
+}
+
+static void free_block(arena *a, struct arena_block *b)
+{
+    a->alloc.free(a->alloc.ctx, b, BLOCK_HEADER_SIZE + b->size);
+}
+
+static void free_blocks(arena *a, struct arena_block *b)
+{
+    while (b != NULL)
+    {
+        struct arena_block *next = b->next;
+        free_block(a, b);
+        b = next;
+    }
+}
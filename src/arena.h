@@ -0,0 +1,130 @@
+/*
+ * Copyright (c) 2017 Wes Hampson <thehambone93@gmail.com>
+ *
+ * Licensed under the MIT License. See LICENSE at top level directory.
+ */
+
+/**
+ * Declarations for arenas, which hand out memory that is all released at
+ * once.
+ *
+ * Small allocations are carved out of shared blocks one after another, so
+ * they cost little more than a pointer bump. Large ones get a block of their
+ * own so that they can grow in place. Nothing is returned to the system
+ * until the arena is destroyed: resetting it keeps its blocks for the next
+ * round of allocations, so an arena reused for one file after another keeps
+ * working in memory that is already mapped in.
+ *
+ * An arena may only be used by one thread at a time.
+ */
+
+#ifndef _GXTMAKER_ARENA_H_
+#define _GXTMAKER_ARENA_H_
+
+#include <stdbool.h>
+#include <stdlib.h>
+
+#include "mem.h"
+
+typedef struct arena_s arena;
+
+/**
+ * Creates an empty arena that gets its memory from the heap. No blocks are
+ * allocated until the first allocation.
+ *
+ * arena_destroy() should be called when the arena is no longer needed.
+ *
+ * @param a a pointer to the arena to be created
+ *
+ * @return true  if the arena was created
+ *         false if the arena could not be created
+ */
+bool arena_create(arena **a);
+
+/**
+ * Creates an empty arena that gets its memory (including the arena itself)
+ * from the given allocation functions.
+ *
+ * @param a     a pointer to the arena to be created
+ * @param alloc the allocation functions (copied into the arena)
+ *
+ * @return true  if the arena was created
+ *         false if the arena could not be created
+ */
+bool arena_create_with(arena **a, const struct allocator *alloc);
+
+/**
+ * Gets the allocation functions an arena gets its memory from.
+ *
+ * @param a the arena
+ *
+ * @return the allocation functions
+ */
+const struct allocator * arena_allocator(const arena *a);
+
+/**
+ * Releases every block held by an arena and deletes the arena.
+ *
+ * @param a a pointer to the arena to be deleted
+ *
+ * @return true  if the arena was deleted
+ *         false if the arena was never initialized
+ */
+bool arena_destroy(arena **a);
+
+/**
+ * Frees everything allocated from an arena. Blocks are kept for later
+ * allocations, up to a limit; any beyond it are released.
+ *
+ * @param a the arena to reset
+ */
+void arena_reset(arena *a);
+
+/**
+ * Allocates memory from an arena. The memory is aligned for any type.
+ *
+ * @param a    the arena to allocate from
+ * @param size the number of bytes to allocate
+ *
+ * @return the allocated memory, or NULL if memory could not be allocated
+ */
+void * arena_alloc(arena *a, size_t size);
+
+/**
+ * Allocates zeroed memory for an array from an arena.
+ *
+ * @param a    the arena to allocate from
+ * @param n    the number of elements
+ * @param size the size of each element
+ *
+ * @return the allocated memory, or NULL if memory could not be allocated
+ */
+void * arena_calloc(arena *a, size_t n, size_t size);
+
+/**
+ * Resizes memory allocated from an arena, moving it if it can't be resized
+ * in place. The most recent small allocation and any large allocation can
+ * usually be resized in place.
+ *
+ * @param a        the arena the memory came from
+ * @param ptr      the memory to resize (NULL to allocate new memory)
+ * @param old_size the size ptr was allocated with
+ * @param new_size the size to resize to
+ *
+ * @return the resized memory, or NULL if memory could not be allocated, in
+ *         which case ptr is left as it was
+ */
+void * arena_realloc(arena *a, void *ptr, size_t old_size, size_t new_size);
+
+/**
+ * Gives memory back to an arena before it is reset. Large allocations are
+ * made available to later allocations straight away, as is the most recent
+ * small allocation; anything else is only freed by the next reset.
+ *
+ * @param a    the arena the memory came from
+ * @param ptr  the memory to free (may be NULL)
+ * @param size the size ptr was allocated with
+ */
+void arena_free(arena *a, void *ptr, size_t size);
+
+#endif /* _GXTMAKER_ARENA_H_ */
@@ -0,0 +1,212 @@
+/*
+ * Copyright (c) 2017 Wes Hampson <thehambone93@gmail.com>
+ *
+ * Licensed under the MIT License. See LICENSE at top level directory.
+ */
+
+/**
+ * Declarations for typed dynamic arrays.
+ *
+ * ARRAY_DECLARE(name, type) declares 'struct name', a growable array that
+ * stores its elements (not pointers to them) contiguously, along with these
+ * functions:
+ *
+ *   void   name_init(struct name *a)
+ *   void   name_init_arena(struct name *a, arena *ar)  allocate from ar
+ *   void   name_free(struct name *a)
+ *   bool   name_reserve(struct name *a, size_t n)  room for n more elements
+ *   bool   name_shrink(struct name *a)             release unused capacity
+ *   bool   name_push(struct name *a, type elem)
+ *   bool   name_append(struct name *a, const type *elems, size_t n)
+ *   type * name_emplace(struct name *a)            append a zeroed element
+ *   void   name_pop(struct name *a)
+ *   type * name_at(const struct name *a, size_t i)
+ *
+ * A zero-initialized struct is an empty array, same as after name_init().
+ * Its elements are allocated on the heap, unless the array was initialized
+ * with name_init_arena(), in which case they come from the arena and are
+ * released along with it.
+ * Capacity doubles on each growth, so appends run in amortized constant time;
+ * growing may move the elements, so pointers to elements only stay valid
+ * until the next append. Functions that grow the array return false (or
+ * NULL) if memory could not be allocated, leaving the array as it was.
+ *
+ * ARRAY_FOR_EACH walks an array without allocating:
+ *
+ *   ARRAY_FOR_EACH(struct key_entry, k, &keys)
+ *   {
+ *       ...
+ *   }
+ */
+
+#ifndef _GXTMAKER_ARRAY_H_
+#define _GXTMAKER_ARRAY_H_
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "arena.h"
+#include "mem.h"
+
+#define ARRAY_INITIAL_CAPACITY 16
+
+#define ARRAY_FOR_EACH(type, it, a) \
+    for (type *it = (a)->data, *it##_end = (a)->data + (a)->len; \
+         it != it##_end; it++)
+
+#define ARRAY_DECLARE(name, type)                                           \
+                                                                            \
+struct name                                                                 \
+{                                                                           \
+    type *data;                                                             \
+    size_t len;             /* Number of elements in the array. */          \
+    size_t cap;             /* Number of elements the array can hold. */    \
+    arena *arena;           /* Where elements are allocated (NULL for the   \
+                               heap). */                                    \
+};                                                                          \
+                                                                            \
+static inline void name##_init(struct name *a)                             \
+{                                                                           \
+    a->data = NULL;                                                         \
+    a->len = 0;                                                             \
+    a->cap = 0;                                                             \
+    a->arena = NULL;                                                        \
+}                                                                           \
+                                                                            \
+static inline void name##_init_arena(struct name *a, arena *ar)            \
+{                                                                           \
+    name##_init(a);                                                         \
+    a->arena = ar;                                                          \
+}                                                                           \
+                                                                            \
+static inline type * name##_resize(struct name *a, size_t new_cap)         \
+{                                                                           \
+    if (a->arena != NULL)                                                   \
+    {                                                                       \
+        return (type *) arena_realloc(a->arena, a->data,                    \
+                                      a->cap * sizeof(type),                \
+                                      new_cap * sizeof(type));              \
+    }                                                                       \
+                                                                            \
+    return (type *) mem_realloc(a->data, new_cap * sizeof(type));           \
+}                                                                           \
+                                                                            \
+static inline void name##_free(struct name *a)                             \
+{                                                                           \
+    if (a->arena != NULL)                                                   \
+    {                                                                       \
+        arena_free(a->arena, a->data, a->cap * sizeof(type));               \
+    }                                                                       \
+    else                                                                    \
+    {                                                                       \
+        free(a->data);                                                      \
+    }                                                                       \
+                                                                            \
+    a->data = NULL;                                                         \
+    a->len = 0;                                                             \
+    a->cap = 0;                                                             \
+}                                                                           \
+                                                                            \
+static inline bool name##_reserve(struct name *a, size_t n)                \
+{                                                                           \
+    if (a->cap - a->len >= n)                                               \
+    {                                                                       \
+        return true;                                                        \
+    }                                                                       \
+                                                                            \
+    size_t new_cap = (a->cap == 0) ? ARRAY_INITIAL_CAPACITY : a->cap;       \
+    while (new_cap - a->len < n)                                            \
+    {                                                                       \
+        new_cap *= 2;                                                       \
+    }                                                                       \
+                                                                            \
+    type *new_data = name##_resize(a, new_cap);                             \
+    if (new_data == NULL)                                                   \
+    {                                                                       \
+        return false;                                                       \
+    }                                                                       \
+                                                                            \
+    a->data = new_data;                                                     \
+    a->cap = new_cap;                                                       \
+                                                                            \
+    return true;                                                            \
+}                                                                           \
+                                                                            \
+static inline bool name##_shrink(struct name *a)                           \
+{                                                                           \
+    if (a->len == a->cap)                                                   \
+    {                                                                       \
+        return true;                                                        \
+    }                                                                       \
+    if (a->len == 0)                                                        \
+    {                                                                       \
+        name##_free(a);                                                     \
+        return true;                                                        \
+    }                                                                       \
+                                                                            \
+    type *new_data = name##_resize(a, a->len);                              \
+    if (new_data == NULL)                                                   \
+    {                                                                       \
+        return false;                                                       \
+    }                                                                       \
+                                                                            \
+    a->data = new_data;                                                     \
+    a->cap = a->len;                                                        \
+                                                                            \
+    return true;                                                            \
+}                                                                           \
+                                                                            \
+static inline bool name##_push(struct name *a, type elem)                  \
+{                                                                           \
+    if (!name##_reserve(a, 1))                                              \
+    {                                                                       \
+        return false;                                                       \
+    }                                                                       \
+                                                                            \
+    a->data[a->len++] = elem;                                               \
+                                                                            \
+    return true;                                                            \
+}                                                                           \
+                                                                            \
+static inline bool name##_append(struct name *a, const type *elems,        \
+                                 size_t n)                                  \
+{                                                                           \
+    if (!name##_reserve(a, n))                                              \
+    {                                                                       \
+        return false;                                                       \
+    }                                                                       \
+                                                                            \
+    if (n > 0)                                                              \
+    {                                                                       \
+        memcpy(a->data + a->len, elems, n * sizeof(type));                  \
+    }                                                                       \
+    a->len += n;                                                            \
+                                                                            \
+    return true;                                                            \
+}                                                                           \
+                                                                            \
+static inline type * name##_emplace(struct name *a)                        \
+{                                                                           \
+    if (!name##_reserve(a, 1))                                              \
+    {                                                                       \
+        return NULL;                                                        \
+    }                                                                       \
+                                                                            \
+    type *elem = &a->data[a->len++];                                        \
+    memset(elem, 0, sizeof(type));                                          \
+                                                                            \
+    return elem;                                                            \
+}                                                                           \
+                                                                            \
+static inline void name##_pop(struct name *a)                              \
+{                                                                           \
+    a->len--;                                                               \
+}                                                                           \
+                                                                            \
+static inline type * name##_at(const struct name *a, size_t i)             \
+{                                                                           \
+    return &a->data[i];                                                     \
+}
+
+#endif /* _GXTMAKER_ARRAY_H_ */
@@ -0,0 +1,403 @@
+/*
+ * Copyright (c) 2017 Wes Hampson <thehambone93@gmail.com>
+ *
+ * Licensed under the MIT License. See LICENSE at top level directory.
+ */
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <stdatomic.h>
+#endif
+
+#include "batch.h"
+#include "compiler.h"
+#include "decompiler.h"
+#include "errwarn.h"
+#include "libgxtmaker.h"
+#include "pool.h"
+#include "stats.h"
+
+/**
+ * A single file to be compiled or decompiled by a worker.
+ */
+struct batch_job
+{
+    const char *in_file;
+    char *out_file;
+    bool decompile;         /* Turn a GXT file back into source. */
+    struct compile_options opts;
+    struct diag_buf diag;   /* Diagnostics for this file only. */
+    int status;
+    enum stats_format stats_format;
+    struct compile_stats stats;
+};
+
+/**
+ * Jobs shared between workers. Each worker claims the next unclaimed job
+ * until there are none left, so jobs are started in input order.
+ */
+struct batch
+{
+    struct batch_job *jobs;
+    int num_files;
+#if defined(_WIN32)
+    volatile LONG next_job;
+#else
+    atomic_int next_job;
+#endif
+};
+
+static int create_jobs(const char * const *in_files, int num_files,
+                       const char *out_dir, const char *out_ext,
+                       struct batch_job **jobs);
+static bool check_out_paths(const struct batch_job *jobs, int num_files);
+static int compar_out_path(const void *a, const void *b);
+static int run_batch(struct batch_job *jobs, int num_files, int num_jobs);
+static void run_worker(void *arg);
+static int claim_job(struct batch *b);
+static void run_job(struct batch_job *job, gxtmaker *g);
+static void add_job_message(void *ctx, const char *msg);
+
+int compile_batch(const char * const *src_files, int num_files,
+                  const char *out_dir, int num_jobs,
+                  const struct compile_options *opts,
+                  enum stats_format stats_format)
+{
+    struct batch_job *jobs;
+    int status = create_jobs(src_files, num_files, out_dir, GXT_FILE_EXT,
+                             &jobs);
+    if (status != COMPILE_SUCCESS)
+    {
+        return status;
+    }
+
+    /* A lone file can use all of the threads itself. So does each file when
+       collecting stats, as they are compiled one at a time to keep their
+       allocation counts apart */
+    bool one_at_a_time = num_files == 1 || stats_format != STATS_NONE;
+
+    for (int i = 0; i < num_files; i++)
+    {
+        jobs[i].opts = *opts;
+        jobs[i].opts.num_threads = one_at_a_time ? num_jobs : 1;
+        jobs[i].stats_format = stats_format;
+        if (stats_format != STATS_NONE)
+        {
+            jobs[i].opts.stats = &jobs[i].stats;
+        }
+    }
+
+    if (one_at_a_time)
+    {
+        num_jobs = 1;
+    }
+
+    return run_batch(jobs, num_files, num_jobs);
+}
+
+int decompile_batch(const char * const *gxt_files, int num_files,
+                    const char *out_dir, int num_jobs)
+{
+    struct batch_job *jobs;
+    int status = create_jobs(gxt_files, num_files, out_dir, SRC_FILE_EXT,
+                             &jobs);
+    if (status != DECOMPILE_SUCCESS)
+    {
+        return status;
+    }
+
+    for (int i = 0; i < num_files; i++)
+    {
+        jobs[i].decompile = true;
+    }
+
+    return run_batch(jobs, num_files, num_jobs);
+}
+
+/**
+ * Creates a job for each input file, with its output path worked out. Two
+ * inputs with the same name in different directories would be written to the
+ * same output file, so that is reported and no jobs are created.
+ *
+ * @param jobs set to the jobs (to be freed by run_batch())
+ *
+ * @return COMPILE_SUCCESS, COMPILE_OUT_OF_MEMORY, or COMPILE_FILE_UNWRITABLE
+ *         if two inputs share an output file
+ */
+static int create_jobs(const char * const *in_files, int num_files,
+                       const char *out_dir, const char *out_ext,
+                       struct batch_job **jobs)
+{
+    struct batch_job *new_jobs =
+        (struct batch_job *) calloc(num_files, sizeof(struct batch_job));
+    if (new_jobs == NULL)
+    {
+        return COMPILE_OUT_OF_MEMORY;
+    }
+
+    for (int i = 0; i < num_files; i++)
+    {
+        new_jobs[i].in_file = in_files[i];
+        new_jobs[i].out_file = make_out_path(in_files[i], out_dir, out_ext);
+        new_jobs[i].status = (new_jobs[i].out_file != NULL)
+            ? COMPILE_SUCCESS : COMPILE_OUT_OF_MEMORY;
+    }
+
+    if (!check_out_paths(new_jobs, num_files))
+    {
+        for (int i = 0; i < num_files; i++)
+        {
+            free(new_jobs[i].out_file);
+        }
+        free(new_jobs);
+        return COMPILE_FILE_UNWRITABLE;
+    }
+
+    *jobs = new_jobs;
+
+    return COMPILE_SUCCESS;
+}
+
+/**
+ * Checks that no two jobs write the same output file. The jobs are sorted by
+ * output path, so that each path is only compared with its neighbours.
+ *
+ * @return true if every output path is different (or couldn't be checked for
+ *         lack of memory, which the jobs will report themselves), false if
+ *         any are the same
+ */
+static bool check_out_paths(const struct batch_job *jobs, int num_files)
+{
+    const struct batch_job **sorted = (const struct batch_job **)
+        malloc(num_files * sizeof(struct batch_job *));
+    if (sorted == NULL)
+    {
+        return true;
+    }
+
+    int num_sorted = 0;
+    for (int i = 0; i < num_files; i++)
+    {
+        if (jobs[i].out_file != NULL)
+        {
+            sorted[num_sorted++] = &jobs[i];
+        }
+    }
+    qsort(sorted, num_sorted, sizeof(sorted[0]), compar_out_path);
+
+    /* Each job in a run of the same path is reported against the first */
+    bool ok = true;
+    for (int i = 1, first = 0; i < num_sorted; i++)
+    {
+        if (strcmp(sorted[i]->out_file, sorted[first]->out_file) != 0)
+        {
+            first = i;
+            continue;
+        }
+
+        error(NULL, E_DUPLICATE_OUTPUT, sorted[first]->in_file,
+              sorted[i]->in_file, sorted[i]->out_file);
+        ok = false;
+    }
+
+    free(sorted);
+
+    return ok;
+}
+
+/**
+ * qsort() comparator for jobs by output path, then by input order.
+ */
+static int compar_out_path(const void *a, const void *b)
+{
+    const struct batch_job *ja = *(const struct batch_job * const *) a;
+    const struct batch_job *jb = *(const struct batch_job * const *) b;
+
+    int cmp = strcmp(ja->out_file, jb->out_file);
+    if (cmp != 0)
+    {
+        return cmp;
+    }
+
+    return (ja < jb) ? -1 : (ja > jb);
+}
+
+/**
+ * Runs a set of jobs on up to num_jobs threads, prints their diagnostics in
+ * input order and frees them.
+ *
+ * @return 0 if every job succeeded, otherwise the status of the first job
+ *         (in input order) that failed
+ */
+static int run_batch(struct batch_job *jobs, int num_files, int num_jobs)
+{
+    /* No point starting more workers than there are files */
+    if (num_jobs > num_files)
+    {
+        num_jobs = num_files;
+    }
+
+    struct batch b;
+    b.jobs = jobs;
+    b.num_files = num_files;
+    b.next_job = 0;
+
+    thread_pool *pool = NULL;
+    if (num_jobs > 1 && pool_create(&pool, num_jobs))
+    {
+        for (int i = 0; i < num_jobs; i++)
+        {
+            if (!pool_submit(pool, run_worker, &b))
+            {
+                /* Help out with whatever the workers that did start
+                   haven't claimed */
+                run_worker(&b);
+                break;
+            }
+        }
+        pool_destroy(&pool);
+    }
+    else
+    {
+        run_worker(&b);
+    }
+
+    int status = COMPILE_SUCCESS;
+    for (int i = 0; i < num_files; i++)
+    {
+        diag_buf_flush(&jobs[i].diag, stderr);
+        diag_buf_free(&jobs[i].diag);
+        free(jobs[i].out_file);
+
+        if (jobs[i].stats_format != STATS_NONE
+            && jobs[i].status == COMPILE_SUCCESS)
+        {
+            stats_print(&jobs[i].stats, jobs[i].in_file,
+                        jobs[i].stats_format, stdout);
+        }
+
+        if (status == COMPILE_SUCCESS)
+        {
+            status = jobs[i].status;
+        }
+    }
+
+    free(jobs);
+
+    return status;
+}
+
+/**
+ * Runs jobs until there are none left (pool_submit() callback). The worker
+ * keeps one gxtmaker instance for all of its files, so each file after the
+ * first mostly reuses memory the worker already has.
+ */
+static void run_worker(void *arg)
+{
+    struct batch *b = (struct batch *) arg;
+
+    /* Diagnostics go to whichever job is running */
+    struct batch_job *job = NULL;
+    gxtmaker *g = NULL;
+    gxtmaker_create(&g, NULL, add_job_message, &job);
+
+    for (int i = claim_job(b); i < b->num_files; i = claim_job(b))
+    {
+        job = &b->jobs[i];
+        run_job(job, g);
+    }
+
+    gxtmaker_destroy(&g);
+}
+
+/**
+ * Gets the index of the next job no worker has taken yet.
+ *
+ * @return the job index, or a number past the last job if all are taken
+ */
+static int claim_job(struct batch *b)
+{
+#if defined(_WIN32)
+    return (int) InterlockedIncrement(&b->next_job) - 1;
+#else
+    return atomic_fetch_add_explicit(&b->next_job, 1, memory_order_relaxed);
+#endif
+}
+
+static void run_job(struct batch_job *job, gxtmaker *g)
+{
+    if (job->status != COMPILE_SUCCESS)
+    {
+        return;
+    }
+
+    if (g == NULL)
+    {
+        job->status = COMPILE_OUT_OF_MEMORY;
+    }
+    else if (job->decompile)
+    {
+        job->status = gxtmaker_decompile_file(g, job->in_file, job->out_file);
+    }
+    else
+    {
+        job->status = gxtmaker_compile_file(g, job->in_file, job->out_file,
+                                            &job->opts);
+    }
+}
+
+/**
+ * Keeps a diagnostic for the job a worker is running (gxtmaker diagnostics
+ * function).
+ */
+static void add_job_message(void *ctx, const char *msg)
+{
+    struct batch_job *job = *(struct batch_job **) ctx;
+
+    diag_buf_add(&job->diag, msg);
+}
+
+char * make_out_path(const char *in_file, const char *out_dir,
+                     const char *out_ext)
+{
+    const char *base = in_file;
+    for (const char *p = in_file; *p != '\0'; p++)
+    {
+        if (*p == '/' || *p == '\\')
+        {
+            base = p + 1;
+        }
+    }
+
+    size_t base_len = strlen(base);
+    const char *ext = strrchr(base, '.');
+    if (ext != NULL && ext != base)
+    {
+        base_len = ext - base;
+    }
+
+    size_t dir_len = strlen(out_dir);
+    size_t len = dir_len + 1 + base_len + strlen(out_ext);
+
+    char *path = (char *) malloc(len + 1);
+    if (path == NULL)
+    {
+        return NULL;
+    }
+
+    memcpy(path, out_dir, dir_len);
+    if (dir_len > 0 && out_dir[dir_len - 1] != '/' && out_dir[dir_len - 1] != '\\')
+    {
+        path[dir_len++] = '/';
+    }
+    memcpy(path + dir_len, base, base_len);
+    strcpy(path + dir_len + base_len, out_ext);
+
+    return path;
+}
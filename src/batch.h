@@ -0,0 +1,77 @@
+/*
+ * Copyright (c) 2017 Wes Hampson <thehambone93@gmail.com>
+ *
+ * Licensed under the MIT License. See LICENSE at top level directory.
+ */
+
+#ifndef _GXTMAKER_BATCH_H_
+#define _GXTMAKER_BATCH_H_
+
+#include "compiler.h"
+#include "stats.h"
+
+#define GXT_FILE_EXT ".gxt"
+#define SRC_FILE_EXT ".txt"
+
+/**
+ * Compiles several GXT source files at once on a pool of worker threads.
+ *
+ * Each compiled file is written to out_dir and named after its source file,
+ * with the extension replaced by ".gxt". Diagnostics are collected separately
+ * for each file and printed in input order once every file has been compiled.
+ * If two source files would be compiled to the same file (they have the same
+ * name in different directories), that is reported and nothing is compiled.
+ *
+ * @param src_files the paths to the source files
+ * @param num_files the number of source files
+ * @param out_dir   the directory to write compiled files to
+ * @param num_jobs  the maximum number of files to compile at once
+ * @param opts      the settings to compile every file with; num_threads and
+ *                  stats are ignored and worked out from the other arguments
+ * @param stats     the format to print each file's compile statistics to
+ *                  stdout in, or STATS_NONE to not collect them; files are
+ *                  then compiled one at a time
+ *
+ * @return 0 if every file compiled successfully, COMPILE_FILE_UNWRITABLE if
+ *         two files share an output file, otherwise the status of the first
+ *         file (in input order) that failed to compile
+ */
+int compile_batch(const char * const *src_files, int num_files,
+                  const char *out_dir, int num_jobs,
+                  const struct compile_options *opts,
+                  enum stats_format stats);
+
+/**
+ * Decompiles several GXT files at once on a pool of worker threads.
+ *
+ * Each source file is written to out_dir and named after its GXT file, with
+ * the extension replaced by ".txt". Diagnostics and files that share an
+ * output file are handled as for compile_batch().
+ *
+ * @param gxt_files the paths to the GXT files
+ * @param num_files the number of GXT files
+ * @param out_dir   the directory to write source files to
+ * @param num_jobs  the maximum number of files to decompile at once
+ *
+ * @return 0 if every file decompiled successfully, DECOMPILE_FILE_UNWRITABLE
+ *         if two files share an output file, otherwise the status of the
+ *         first file (in input order) that failed to decompile
+ */
+int decompile_batch(const char * const *gxt_files, int num_files,
+                    const char *out_dir, int num_jobs);
+
+/**
+ * Builds the output path for an input file by taking its base name, replacing
+ * the extension with out_ext and prepending the output directory.
+ *
+ * @param in_file the path to the input file
+ * @param out_dir the directory the output goes in
+ * @param out_ext the extension of the output file, including the dot
+ *
+ * @return the output path (must be freed by the caller),
+ *         or NULL if memory could not be allocated
+ */
+char * make_out_path(const char *in_file, const char *out_dir,
+                     const char *out_ext);
+
+#endif /* _GXTMAKER_BATCH_H_ */
@@ -0,0 +1,508 @@
+/*
+ * Copyright (c) 2017 Wes Hampson <thehambone93@gmail.com>
+ *
+ * Licensed under the MIT License. See LICENSE at top level directory.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cache.h"
+#include "io.h"
+#include "mem.h"
+
+#define CACHE_MAGIC     "GXTC"
+#define CACHE_VERSION   2
+
+#define RECORDS_INITIAL_CAPACITY (64 * 1024)
+
+/* Records are padded so that every record (and its chars) stays 8-byte
+   aligned within the file */
+#define RECORD_ALIGN    8
+#define ALIGN_UP(n)     (((n) + RECORD_ALIGN - 1) & ~(size_t) (RECORD_ALIGN - 1))
+
+/**
+ * Cache file header.
+ */
+struct cache_file_header
+{
+    char magic[4];
+    uint32_t version;
+    struct cache_stamp stamp;
+    uint64_t num_entries;
+};
+
+/**
+ * Cache file entry record, followed by the entry's chars and then its source
+ * text.
+ */
+struct cache_file_record
+{
+    uint64_t hash;
+    uint32_t src_len;
+    uint32_t num_chars;
+    char name[GXT_KEY_MAX_LEN];
+};
+
+/**
+ * Hash table slot. The hash is kept alongside the record index so that
+ * probing doesn't have to look at the records themselves.
+ */
+struct cache_slot
+{
+    uint64_t hash;
+    size_t index;               /* Record index plus one (0 = empty slot). */
+};
+
+/*
+ * The records are kept exactly as they appear in the file following the
+ * header. A loaded cache uses the file contents in place; a new cache builds
+ * them up in a buffer that is written out as-is.
+ */
+struct entry_cache_s    /* typedef'd in cache.h as 'entry_cache' */
+{
+    struct cache_stamp stamp;
+    size_t num_entries;
+
+    struct mapped_file file;    /* File the cache was loaded from, if any. */
+
+    char *buf;                  /* Records of a new cache. */
+    size_t buf_len;
+    size_t buf_cap;
+
+    const char *records;        /* Records (file contents or buf). */
+    size_t *offsets;            /* Position of each record (loaded only). */
+
+    struct cache_slot *table;   /* Open-addressed hash table of records. */
+    size_t table_cap;           /* Power of two, or 0 if not built. */
+};
+
+static bool reserve_records(entry_cache *c, size_t n);
+static bool index_records(entry_cache *c, size_t size);
+static bool build_table(entry_cache *c);
+static void read_record(const entry_cache *c, size_t index,
+                        struct cache_entry *entry);
+static bool is_same_entry(const struct cache_entry *e, uint64_t hash,
+                          const char *src, uint32_t src_len);
+
+bool cache_create(entry_cache **c, const struct cache_stamp *stamp)
+{
+    if (c == NULL)
+    {
+        return false;
+    }
+
+    *c = (entry_cache *) mem_calloc(1, sizeof(entry_cache));
+    if (*c == NULL)
+    {
+        return false;
+    }
+
+    (*c)->stamp = *stamp;
+
+    return true;
+}
+
+bool cache_load(entry_cache **c, const char *path)
+{
+    struct mapped_file mf;
+    if (c == NULL || !map_file(path, &mf))
+    {
+        return false;
+    }
+
+    struct cache_file_header header;
+    if (mf.size < ALIGN_UP(sizeof(header)))
+    {
+        unmap_file(&mf);
+        return false;
+    }
+
+    memcpy(&header, mf.data, sizeof(header));
+    if (memcmp(header.magic, CACHE_MAGIC, sizeof(header.magic)) != 0
+        || header.version != CACHE_VERSION
+        || header.num_entries > mf.size / sizeof(struct cache_file_record)
+        || !cache_create(c, &header.stamp))
+    {
+        unmap_file(&mf);
+        return false;
+    }
+
+    (*c)->file = mf;
+    (*c)->num_entries = (size_t) header.num_entries;
+    (*c)->records = mf.data + ALIGN_UP(sizeof(header));
+
+    if (!index_records(*c, mf.size - ALIGN_UP(sizeof(header)))
+        || !build_table(*c))
+    {
+        cache_destroy(c);
+        return false;
+    }
+
+    return true;
+}
+
+bool cache_read_stamp(const char *path, struct cache_stamp *stamp)
+{
+    FILE *f = fopen(path, "rb");
+    if (f == NULL)
+    {
+        return false;
+    }
+
+    struct cache_file_header header;
+    bool ok = fread(&header, sizeof(header), 1, f) == 1
+           && memcmp(header.magic, CACHE_MAGIC, sizeof(header.magic)) == 0
+           && header.version == CACHE_VERSION;
+    fclose(f);
+
+    if (ok)
+    {
+        *stamp = header.stamp;
+    }
+
+    return ok;
+}
+
+bool cache_save(const entry_cache *c, const char *path)
+{
+    /* Write to a temporary file, then move it into place, so that an
+       interrupted build never leaves a truncated cache behind */
+    size_t path_len = strlen(path);
+    char *tmp_path = (char *) mem_malloc(path_len + 5);
+    if (tmp_path == NULL)
+    {
+        return false;
+    }
+    memcpy(tmp_path, path, path_len);
+    strcpy(tmp_path + path_len, ".tmp");
+
+    FILE *f = fopen(tmp_path, "wb");
+    if (f == NULL)
+    {
+        free(tmp_path);
+        return false;
+    }
+
+    char header_buf[ALIGN_UP(sizeof(struct cache_file_header))] = { 0 };
+    struct cache_file_header header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, CACHE_MAGIC, sizeof(header.magic));
+    header.version = CACHE_VERSION;
+    header.stamp = c->stamp;
+    header.num_entries = c->num_entries;
+    memcpy(header_buf, &header, sizeof(header));
+
+    bool ok = fwrite(header_buf, sizeof(header_buf), 1, f) == 1
+           && (c->buf_len == 0 || fwrite(c->buf, c->buf_len, 1, f) == 1);
+    ok = (fclose(f) == 0) && ok;
+
+#if defined(_WIN32)
+    /* rename() won't replace an existing file on Windows */
+    if (ok)
+    {
+        remove(path);
+    }
+#endif
+
+    ok = ok && rename(tmp_path, path) == 0;
+    if (!ok)
+    {
+        remove(tmp_path);
+    }
+
+    free(tmp_path);
+
+    return ok;
+}
+
+bool cache_destroy(entry_cache **c)
+{
+    if (c == NULL || *c == NULL)
+    {
+        return false;
+    }
+
+    if ((*c)->file.data != NULL)
+    {
+        unmap_file(&(*c)->file);
+    }
+    free((*c)->buf);
+    free((*c)->offsets);
+    free((*c)->table);
+    free(*c);
+    *c = NULL;
+
+    return true;
+}
+
+const struct cache_stamp * cache_get_stamp(const entry_cache *c)
+{
+    return &c->stamp;
+}
+
+void cache_set_stamp(entry_cache *c, const struct cache_stamp *stamp)
+{
+    c->stamp = *stamp;
+}
+
+bool cache_find(const entry_cache *c, uint64_t hash, const char *src,
+                uint32_t src_len, size_t *pos, struct cache_entry *entry)
+{
+    if (c->table_cap == 0)
+    {
+        return false;
+    }
+
+    struct cache_entry e;
+
+    /* Try the expected position first; the records are read sequentially
+       that way, which is much kinder to the CPU cache than hash probing */
+    if (*pos < c->num_entries)
+    {
+        read_record(c, *pos, &e);
+        if (is_same_entry(&e, hash, src, src_len))
+        {
+            *entry = e;
+            (*pos)++;
+            return true;
+        }
+    }
+
+    size_t mask = c->table_cap - 1;
+    for (size_t slot = (size_t) hash & mask; c->table[slot].index != 0;
+         slot = (slot + 1) & mask)
+    {
+        if (c->table[slot].hash != hash)
+        {
+            continue;
+        }
+
+        size_t index = c->table[slot].index - 1;
+        read_record(c, index, &e);
+        if (is_same_entry(&e, hash, src, src_len))
+        {
+            *entry = e;
+            *pos = index + 1;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+bool cache_add(entry_cache *c, const struct cache_entry *entry)
+{
+    size_t chars_size = entry->num_chars * sizeof(gxt_char);
+    size_t data_size = chars_size + entry->src_len;
+    size_t rec_size = ALIGN_UP(sizeof(struct cache_file_record) + data_size);
+
+    if (!reserve_records(c, rec_size))
+    {
+        return false;
+    }
+
+    struct cache_file_record rec;
+    memset(&rec, 0, sizeof(rec));
+    rec.hash = entry->hash;
+    rec.src_len = entry->src_len;
+    rec.num_chars = entry->num_chars;
+    memcpy(rec.name, entry->name, sizeof(rec.name));
+
+    char *dest = c->buf + c->buf_len;
+    memcpy(dest, &rec, sizeof(rec));
+    if (chars_size > 0)
+    {
+        memcpy(dest + sizeof(rec), entry->chars, chars_size);
+    }
+    if (entry->src_len > 0)
+    {
+        memcpy(dest + sizeof(rec) + chars_size, entry->src, entry->src_len);
+    }
+    memset(dest + sizeof(rec) + data_size, 0,
+           rec_size - sizeof(rec) - data_size);
+
+    c->buf_len += rec_size;
+    c->num_entries++;
+
+    return true;
+}
+
+bool cache_append(entry_cache *dest, entry_cache *src)
+{
+    if (dest->buf_len == 0)
+    {
+        /* Nothing to append to; just take over the source's records */
+        char *buf = dest->buf;
+        size_t buf_cap = dest->buf_cap;
+
+        dest->buf = src->buf;
+        dest->buf_len = src->buf_len;
+        dest->buf_cap = src->buf_cap;
+        dest->records = src->buf;
+        dest->num_entries = src->num_entries;
+
+        src->buf = buf;
+        src->buf_cap = buf_cap;
+        src->records = buf;
+    }
+    else
+    {
+        if (!reserve_records(dest, src->buf_len))
+        {
+            return false;
+        }
+
+        if (src->buf_len > 0)
+        {
+            memcpy(dest->buf + dest->buf_len, src->buf, src->buf_len);
+        }
+        dest->buf_len += src->buf_len;
+        dest->num_entries += src->num_entries;
+    }
+
+    src->buf_len = 0;
+    src->num_entries = 0;
+
+    return true;
+}
+
+/**
+ * Ensures a new cache has room for at least n more bytes of records.
+ */
+static bool reserve_records(entry_cache *c, size_t n)
+{
+    if (c->buf_cap - c->buf_len >= n)
+    {
+        return true;
+    }
+
+    size_t new_cap = (c->buf_cap == 0) ? RECORDS_INITIAL_CAPACITY : c->buf_cap;
+    while (new_cap - c->buf_len < n)
+    {
+        new_cap *= 2;
+    }
+
+    char *new_buf = (char *) mem_realloc(c->buf, new_cap);
+    if (new_buf == NULL)
+    {
+        return false;
+    }
+
+    c->buf = new_buf;
+    c->buf_cap = new_cap;
+    c->records = new_buf;
+
+    return true;
+}
+
+/**
+ * Finds where each record of a loaded cache starts, checking that every
+ * record lies within the file.
+ */
+static bool index_records(entry_cache *c, size_t size)
+{
+    c->offsets = (size_t *) mem_malloc((c->num_entries + 1) * sizeof(size_t));
+    if (c->offsets == NULL)
+    {
+        return false;
+    }
+
+    size_t pos = 0;
+    for (size_t i = 0; i < c->num_entries; i++)
+    {
+        struct cache_file_record rec;
+        if (size - pos < sizeof(rec))
+        {
+            return false;
+        }
+        memcpy(&rec, c->records + pos, sizeof(rec));
+
+        size_t data_size = (size_t) rec.num_chars * sizeof(gxt_char)
+                         + rec.src_len;
+        if (size - pos - sizeof(rec) < data_size)
+        {
+            return false;
+        }
+
+        size_t rec_size = ALIGN_UP(sizeof(rec) + data_size);
+        if (size - pos < rec_size)
+        {
+            return false;
+        }
+
+        c->offsets[i] = pos;
+        pos += rec_size;
+    }
+
+    return true;
+}
+
+/**
+ * Builds the hash table used by cache_find(). Sized to at most half full.
+ */
+static bool build_table(entry_cache *c)
+{
+    size_t cap = 16;
+    while (cap < c->num_entries * 2)
+    {
+        cap *= 2;
+    }
+
+    c->table = (struct cache_slot *) mem_calloc(cap, sizeof(struct cache_slot));
+    if (c->table == NULL)
+    {
+        return false;
+    }
+    c->table_cap = cap;
+
+    size_t mask = cap - 1;
+    for (size_t i = 0; i < c->num_entries; i++)
+    {
+        uint64_t hash;
+        memcpy(&hash, c->records + c->offsets[i], sizeof(hash));
+
+        size_t slot = (size_t) hash & mask;
+        while (c->table[slot].index != 0)
+        {
+            slot = (slot + 1) & mask;
+        }
+        c->table[slot].hash = hash;
+        c->table[slot].index = i + 1;
+    }
+
+    return true;
+}
+
+/**
+ * Reads a record of a loaded cache.
+ */
+static void read_record(const entry_cache *c, size_t index,
+                        struct cache_entry *entry)
+{
+    const char *p = c->records + c->offsets[index];
+
+    struct cache_file_record rec;
+    memcpy(&rec, p, sizeof(rec));
+
+    entry->hash = rec.hash;
+    entry->src_len = rec.src_len;
+    entry->num_chars = rec.num_chars;
+    memcpy(entry->name, rec.name, sizeof(entry->name));
+
+    /* Records are 8-byte aligned, so the chars are suitably aligned */
+    entry->chars = (const gxt_char *) (p + sizeof(rec));
+    entry->src = p + sizeof(rec) + rec.num_chars * sizeof(gxt_char);
+}
+
+/**
+ * Checks whether a cached entry was made from the given source text. The
+ * hash only narrows the search; the text itself is what has to match.
+ */
+static bool is_same_entry(const struct cache_entry *e, uint64_t hash,
+                          const char *src, uint32_t src_len)
+{
+    return e->hash == hash && e->src_len == src_len
+        && memcmp(e->src, src, src_len) == 0;
+}
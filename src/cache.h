@@ -0,0 +1,179 @@
+/*
+ * Copyright (c) 2017 Wes Hampson <thehambone93@gmail.com>
+ *
+ * Licensed under the MIT License. See LICENSE at top level directory.
+ */
+
+/**
+ * Declarations for the incremental compilation cache.
+ *
+ * The cache remembers the encoded string of every entry in a source file,
+ * keyed by a hash of the entry's source text (from its '[' up to the next
+ * key). On the next build, entries whose source text hasn't changed are
+ * taken from the cache instead of being lexed and encoded again. The source
+ * text is kept too and compared in full, so a hash collision can never pass
+ * one entry's string off as another's. The cache
+ * also records which source and output it was built with, so a build in
+ * which nothing changed can be skipped entirely.
+ */
+
+#ifndef _GXTMAKER_CACHE_H_
+#define _GXTMAKER_CACHE_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "gxt.h"
+
+typedef struct entry_cache_s entry_cache;
+
+/**
+ * Identifies the settings, source file and output file a cache was built
+ * with.
+ */
+struct cache_stamp
+{
+    uint64_t fingerprint;   /* Hash of settings that affect the output. */
+    uint64_t src_hash;      /* Hash of the whole source file. */
+    uint64_t src_size;
+    uint64_t out_size;
+    int64_t out_mtime;      /* Output modification time when written. */
+};
+
+/**
+ * A cached entry.
+ */
+struct cache_entry
+{
+    uint64_t hash;              /* Hash of the entry's source text. */
+    uint32_t src_len;           /* Length of the entry's source text. */
+    const char *src;            /* The entry's source text. */
+    char name[GXT_KEY_MAX_LEN]; /* Key name. */
+    uint32_t num_chars;         /* String length, excluding NUL. */
+    const gxt_char *chars;      /* Encoded string. */
+};
+
+/**
+ * Creates an empty cache.
+ *
+ * cache_destroy() should be called when the cache is no longer needed.
+ *
+ * @param c     a pointer to the cache to be created
+ * @param stamp the settings, source and output the cache describes
+ *
+ * @return true  if the cache was created
+ *         false if the cache could not be created
+ */
+bool cache_create(entry_cache **c, const struct cache_stamp *stamp);
+
+/**
+ * Loads a cache from disk.
+ *
+ * @param c    a pointer to the cache to be loaded
+ * @param path the path to the cache file
+ *
+ * @return true  if the cache was loaded
+ *         false if the file does not exist, is not a cache file, was written
+ *               by a different version, or could not be read
+ */
+bool cache_load(entry_cache **c, const char *path);
+
+/**
+ * Reads only the stamp of a cache on disk, which is much quicker than loading
+ * the whole cache when all that's needed is to check whether it is current.
+ *
+ * @param path  the path to the cache file
+ * @param stamp a pointer to where the stamp should be stored
+ *
+ * @return true  if the stamp was read
+ *         false if the file does not exist, is not a cache file, was written
+ *               by a different version, or could not be read
+ */
+bool cache_read_stamp(const char *path, struct cache_stamp *stamp);
+
+/**
+ * Writes a cache to disk, replacing any existing cache file atomically.
+ *
+ * @param c    the cache to save
+ * @param path the path to the cache file
+ *
+ * @return true  if the cache was saved
+ *         false if the cache could not be written
+ */
+bool cache_save(const entry_cache *c, const char *path);
+
+/**
+ * Deletes a cache.
+ *
+ * @param c a pointer to the cache to be deleted
+ *
+ * @return true  if the cache was deleted
+ *         false if the cache was never initialized
+ */
+bool cache_destroy(entry_cache **c);
+
+/**
+ * Gets the settings, source and output a cache was built with.
+ *
+ * @param c the cache
+ *
+ * @return the cache stamp
+ */
+const struct cache_stamp * cache_get_stamp(const entry_cache *c);
+
+/**
+ * Updates the settings, source and output a cache describes.
+ *
+ * @param c     the cache
+ * @param stamp the new stamp
+ */
+void cache_set_stamp(entry_cache *c, const struct cache_stamp *stamp);
+
+/**
+ * Looks up an entry by its source text. Entries are found by the hash of
+ * their source text, and only match if the text itself is the same.
+ *
+ * Entries are usually looked up in the same order they were added, so the
+ * entry at *pos is checked before searching the rest of the cache.
+ *
+ * @param c       the cache to search
+ * @param hash    the hash of the entry's source text
+ * @param src     the entry's source text
+ * @param src_len the length of the entry's source text
+ * @param pos     a pointer to the position to check first; updated to the
+ *                position after the entry if it is found (start from 0)
+ * @param entry   a pointer to where the entry should be stored if found; its
+ *                chars remain valid until the cache is deleted
+ *
+ * @return true if the entry was found, false otherwise
+ */
+bool cache_find(const entry_cache *c, uint64_t hash, const char *src,
+                uint32_t src_len, size_t *pos, struct cache_entry *entry);
+
+/**
+ * Adds an entry to a cache. The entry's chars and source text are copied.
+ *
+ * @param c     the cache to add to
+ * @param entry the entry to add
+ *
+ * @return true  if the entry was added
+ *         false if the entry could not be added
+ *               (e.g. due to lack of available memory)
+ */
+bool cache_add(entry_cache *c, const struct cache_entry *entry);
+
+/**
+ * Moves every entry of one cache to the end of another, leaving the source
+ * cache empty.
+ *
+ * @param dest the cache to add to
+ * @param src  the cache whose entries should be moved (must have been
+ *             created with cache_create())
+ *
+ * @return true  if the entries were added
+ *         false if the entries could not be added
+ *               (e.g. due to lack of available memory)
+ */
+bool cache_append(entry_cache *dest, entry_cache *src);
+
+#endif /* _GXTMAKER_CACHE_H_ */
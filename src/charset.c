@@ -0,0 +1,617 @@
+/*
+ * Copyright (c) 2017 Wes Hampson <thehambone93@gmail.com>
+ *
+ * Licensed under the MIT License. See LICENSE at top level directory.
+ */
+
+#include <ctype.h>
+#include <string.h>
+
+#include "charset.h"
+
+#if !defined(GXTMAKER_SCALAR_SCAN)
+#if defined(__SSE2__) || defined(_M_X64) \
+    || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define CHARSET_HAVE_SSE2
+#include <emmintrin.h>
+#endif
+#endif /* GXTMAKER_SCALAR_SCAN */
+
+static size_t skip_ascii(const char *text, size_t len);
+static size_t widen_ascii(const char *text, size_t len, gxt_char *dest);
+static size_t utf8_decode(const char *text, size_t len, uint32_t *code_point);
+static size_t encode_utf16(const struct charset *cs, bool big_endian,
+                           const char *text, size_t len,
+                           gxt_char *dest, size_t *dest_len, long *bad_char);
+static size_t copy_ascii16(const char *text, size_t len, bool big_endian,
+                           gxt_char *dest);
+static size_t utf16_decode(const char *text, size_t len, bool big_endian,
+                           uint32_t *code_point);
+static size_t narrow_ascii16(const char *glyphs, size_t len, char *dest);
+static size_t utf8_encode(uint32_t code_point, char *dest);
+static uint16_t load_unit16(const char *p, bool big_endian);
+static gxt_char lookup_glyph(const struct charset *cs, uint32_t code_point);
+
+/**
+ * Encoding names accepted by parse_encoding().
+ */
+static const struct
+{
+    const char *name;
+    enum src_encoding enc;
+} encoding_names[] =
+{
+    { "auto", SRC_ENCODING_AUTO },
+    { "latin1", SRC_ENCODING_LATIN1 },
+    { "iso-8859-1", SRC_ENCODING_LATIN1 },
+    { "utf-8", SRC_ENCODING_UTF8 },
+    { "utf8", SRC_ENCODING_UTF8 },
+    { "utf-16le", SRC_ENCODING_UTF16LE },
+    { "utf-16be", SRC_ENCODING_UTF16BE }
+};
+
+const struct charset * charset_find(const char *name)
+{
+    for (int i = 0; i < charset_count; i++)
+    {
+        if (strcmp(charset_list[i].name, name) == 0)
+        {
+            return &charset_list[i];
+        }
+    }
+
+    return NULL;
+}
+
+const struct charset * charset_for_game(enum gxt_game game,
+                                        bool *is_fallback)
+{
+    const struct charset *cs = charset_find(gxt_game_name(game));
+    if (is_fallback != NULL)
+    {
+        *is_fallback = (cs == NULL);
+    }
+
+    return (cs != NULL) ? cs : charset_find(DEFAULT_CHARSET);
+}
+
+size_t charset_encode(const struct charset *cs, enum src_encoding enc,
+                      const char *text, size_t len,
+                      gxt_char *dest, size_t *dest_len, long *bad_char)
+{
+    if (enc == SRC_ENCODING_UTF16LE || enc == SRC_ENCODING_UTF16BE)
+    {
+        return encode_utf16(cs, enc == SRC_ENCODING_UTF16BE, text, len,
+                            dest, dest_len, bad_char);
+    }
+
+    size_t i = 0;
+    size_t n = 0;
+
+    while (i < len)
+    {
+        size_t run = widen_ascii(text + i, len - i, dest + n);
+        i += run;
+        n += run;
+        if (i >= len)
+        {
+            break;
+        }
+
+        uint32_t code_point;
+        size_t char_len;
+
+        if (enc == SRC_ENCODING_UTF8)
+        {
+            char_len = utf8_decode(text + i, len - i, &code_point);
+            if (char_len == 0)
+            {
+                *bad_char = -1;
+                break;
+            }
+        }
+        else
+        {
+            code_point = (unsigned char) text[i];
+            char_len = 1;
+        }
+
+        gxt_char glyph = lookup_glyph(cs, code_point);
+        if (glyph == 0)
+        {
+            *bad_char = (long) code_point;
+            break;
+        }
+
+        dest[n++] = glyph;
+        i += char_len;
+    }
+
+    *dest_len = n;
+
+    return i;
+}
+
+size_t charset_decode(const struct charset *cs, const char *glyphs,
+                      size_t len, char *dest, size_t *dest_len)
+{
+    size_t i = 0;
+    size_t n = 0;
+
+    while (i < len)
+    {
+        size_t run = narrow_ascii16(glyphs + i * 2, len - i, dest + n);
+        i += run;
+        n += run;
+        if (i >= len)
+        {
+            break;
+        }
+
+        uint32_t code_point = cs->reverse(load_unit16(glyphs + i * 2, false));
+        if (code_point == 0)
+        {
+            break;
+        }
+
+        n += utf8_encode(code_point, dest + n);
+        i++;
+    }
+
+    *dest_len = n;
+
+    return i;
+}
+
+enum src_encoding detect_encoding(const char *text, size_t len,
+                                  size_t *bom_len)
+{
+    static const enum src_encoding marked[] =
+        { SRC_ENCODING_UTF8, SRC_ENCODING_UTF16LE, SRC_ENCODING_UTF16BE };
+
+    for (size_t i = 0; i < sizeof(marked) / sizeof(marked[0]); i++)
+    {
+        *bom_len = bom_length(text, len, marked[i]);
+        if (*bom_len > 0)
+        {
+            return marked[i];
+        }
+    }
+
+    return utf8_validate(text, len) ? SRC_ENCODING_UTF8
+                                    : SRC_ENCODING_LATIN1;
+}
+
+size_t bom_length(const char *text, size_t len, enum src_encoding enc)
+{
+    const char *bom;
+    size_t bom_len;
+
+    switch (enc)
+    {
+        case SRC_ENCODING_UTF8:
+            bom = "\xEF\xBB\xBF";
+            bom_len = 3;
+            break;
+        case SRC_ENCODING_UTF16LE:
+            bom = "\xFF\xFE";
+            bom_len = 2;
+            break;
+        case SRC_ENCODING_UTF16BE:
+            bom = "\xFE\xFF";
+            bom_len = 2;
+            break;
+        default:
+            return 0;
+    }
+
+    return (len >= bom_len && memcmp(text, bom, bom_len) == 0) ? bom_len : 0;
+}
+
+size_t encoding_unit_size(enum src_encoding enc)
+{
+    return (enc == SRC_ENCODING_UTF16LE || enc == SRC_ENCODING_UTF16BE)
+        ? 2
+        : 1;
+}
+
+bool parse_encoding(const char *name, enum src_encoding *enc)
+{
+    for (size_t i = 0; i < sizeof(encoding_names) / sizeof(encoding_names[0]);
+         i++)
+    {
+        const char *a = encoding_names[i].name;
+        const char *b = name;
+        while (*a != '\0' && *a == tolower((unsigned char) *b))
+        {
+            a++;
+            b++;
+        }
+
+        if (*a == '\0' && *b == '\0')
+        {
+            *enc = encoding_names[i].enc;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+bool utf8_validate(const char *text, size_t len)
+{
+    size_t i = 0;
+    while (i < len)
+    {
+        i += skip_ascii(text + i, len - i);
+        if (i >= len)
+        {
+            break;
+        }
+
+        uint32_t code_point;
+        size_t char_len = utf8_decode(text + i, len - i, &code_point);
+        if (char_len == 0)
+        {
+            return false;
+        }
+        i += char_len;
+    }
+
+    return true;
+}
+
+/**
+ * Finds the length of the ASCII at the start of some text.
+ *
+ * @return the number of bytes before the first non-ASCII byte
+ */
+static size_t skip_ascii(const char *text, size_t len)
+{
+    size_t i = 0;
+
+#if defined(CHARSET_HAVE_SSE2)
+    for (; i + 16 <= len; i += 16)
+    {
+        __m128i v = _mm_loadu_si128((const __m128i *) (text + i));
+        if (_mm_movemask_epi8(v) != 0)
+        {
+            break;
+        }
+    }
+#endif
+
+    while (i < len && (unsigned char) text[i] < 0x80)
+    {
+        i++;
+    }
+
+    return i;
+}
+
+/**
+ * Copies the ASCII at the start of some text into a buffer of glyph codes,
+ * stopping at the first non-ASCII byte.
+ *
+ * @return the number of bytes copied
+ */
+static size_t widen_ascii(const char *text, size_t len, gxt_char *dest)
+{
+    size_t i = 0;
+
+#if defined(CHARSET_HAVE_SSE2)
+    const __m128i zero = _mm_setzero_si128();
+    for (; i + 16 <= len; i += 16)
+    {
+        __m128i v = _mm_loadu_si128((const __m128i *) (text + i));
+        if (_mm_movemask_epi8(v) != 0)
+        {
+            break;
+        }
+
+        _mm_storeu_si128((__m128i *) (dest + i), _mm_unpacklo_epi8(v, zero));
+        _mm_storeu_si128((__m128i *) (dest + i + 8),
+                         _mm_unpackhi_epi8(v, zero));
+    }
+#endif
+
+    for (; i < len && (unsigned char) text[i] < 0x80; i++)
+    {
+        dest[i] = (gxt_char) text[i];
+    }
+
+    return i;
+}
+
+/**
+ * Decodes one UTF-8 character. Overlong forms, surrogates and code points
+ * above U+10FFFF are rejected.
+ *
+ * @return the length of the character in bytes, or 0 if it is malformed
+ */
+static size_t utf8_decode(const char *text, size_t len, uint32_t *code_point)
+{
+    const unsigned char *s = (const unsigned char *) text;
+
+    size_t char_len;
+    uint32_t min;
+    uint32_t cp;
+
+    if (s[0] < 0x80)
+    {
+        *code_point = s[0];
+        return 1;
+    }
+    else if ((s[0] & 0xE0) == 0xC0)
+    {
+        char_len = 2;
+        min = 0x80;
+        cp = s[0] & 0x1F;
+    }
+    else if ((s[0] & 0xF0) == 0xE0)
+    {
+        char_len = 3;
+        min = 0x800;
+        cp = s[0] & 0x0F;
+    }
+    else if ((s[0] & 0xF8) == 0xF0)
+    {
+        char_len = 4;
+        min = 0x10000;
+        cp = s[0] & 0x07;
+    }
+    else
+    {
+        return 0;
+    }
+
+    if (len < char_len)
+    {
+        return 0;
+    }
+
+    for (size_t i = 1; i < char_len; i++)
+    {
+        if ((s[i] & 0xC0) != 0x80)
+        {
+            return 0;
+        }
+        cp = (cp << 6) | (s[i] & 0x3F);
+    }
+
+    if (cp < min || cp > 0x10FFFF || (cp >= 0xD800 && cp <= 0xDFFF))
+    {
+        return 0;
+    }
+
+    *code_point = cp;
+
+    return char_len;
+}
+
+/**
+ * Encodes UTF-16 text (see charset_encode()).
+ */
+static size_t encode_utf16(const struct charset *cs, bool big_endian,
+                           const char *text, size_t len,
+                           gxt_char *dest, size_t *dest_len, long *bad_char)
+{
+    size_t num_units = len / 2;
+    size_t i = 0;
+    size_t n = 0;
+
+    while (i < num_units)
+    {
+        size_t run = copy_ascii16(text + i * 2, num_units - i, big_endian,
+                                  dest + n);
+        i += run;
+        n += run;
+        if (i >= num_units)
+        {
+            break;
+        }
+
+        uint32_t code_point;
+        size_t char_len = utf16_decode(text + i * 2, num_units - i,
+                                       big_endian, &code_point);
+        if (char_len == 0)
+        {
+            *bad_char = -1;
+            break;
+        }
+
+        gxt_char glyph = lookup_glyph(cs, code_point);
+        if (glyph == 0)
+        {
+            *bad_char = (long) code_point;
+            break;
+        }
+
+        dest[n++] = glyph;
+        i += char_len;
+    }
+
+    if (i == num_units && len % 2 != 0)
+    {
+        /* Half a unit */
+        *bad_char = -1;
+    }
+
+    *dest_len = n;
+
+    return i * 2;
+}
+
+/**
+ * Copies the ASCII at the start of some UTF-16 text into a buffer of glyph
+ * codes, stopping at the first non-ASCII unit.
+ *
+ * @return the number of units copied
+ */
+static size_t copy_ascii16(const char *text, size_t len, bool big_endian,
+                           gxt_char *dest)
+{
+    size_t i = 0;
+
+#if defined(CHARSET_HAVE_SSE2)
+    const __m128i non_ascii_bits = _mm_set1_epi16((short) 0xFF80);
+    const __m128i zero = _mm_setzero_si128();
+    for (; i + 8 <= len; i += 8)
+    {
+        __m128i v = _mm_loadu_si128((const __m128i *) (text + i * 2));
+        if (big_endian)
+        {
+            v = _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+        }
+
+        __m128i is_ascii =
+            _mm_cmpeq_epi16(_mm_and_si128(v, non_ascii_bits), zero);
+        if (_mm_movemask_epi8(is_ascii) != 0xFFFF)
+        {
+            break;
+        }
+
+        _mm_storeu_si128((__m128i *) (dest + i), v);
+    }
+#endif
+
+    for (; i < len; i++)
+    {
+        uint16_t c = load_unit16(text + i * 2, big_endian);
+        if (c >= 0x80)
+        {
+            break;
+        }
+        dest[i] = c;
+    }
+
+    return i;
+}
+
+/**
+ * Decodes one UTF-16 character. Unpaired surrogates are rejected.
+ *
+ * @return the length of the character in units, or 0 if it is malformed
+ */
+static size_t utf16_decode(const char *text, size_t len, bool big_endian,
+                           uint32_t *code_point)
+{
+    uint16_t hi = load_unit16(text, big_endian);
+    if (hi < 0xD800 || hi > 0xDFFF)
+    {
+        *code_point = hi;
+        return 1;
+    }
+
+    if (hi >= 0xDC00 || len < 2)
+    {
+        return 0;
+    }
+
+    uint16_t lo = load_unit16(text + 2, big_endian);
+    if (lo < 0xDC00 || lo > 0xDFFF)
+    {
+        return 0;
+    }
+
+    *code_point = 0x10000 + (((uint32_t) hi - 0xD800) << 10) + (lo - 0xDC00);
+
+    return 2;
+}
+
+/**
+ * Copies the ASCII glyphs at the start of some little-endian glyph codes
+ * into a text buffer, stopping at the first non-ASCII glyph.
+ *
+ * @return the number of glyphs copied
+ */
+static size_t narrow_ascii16(const char *glyphs, size_t len, char *dest)
+{
+    size_t i = 0;
+
+#if defined(CHARSET_HAVE_SSE2)
+    for (; i + 16 <= len; i += 16)
+    {
+        /* Packing saturates anything above 0xFF to 0xFF, so any non-ASCII
+           glyph leaves its top bit set */
+        __m128i lo = _mm_loadu_si128((const __m128i *) (glyphs + i * 2));
+        __m128i hi = _mm_loadu_si128((const __m128i *) (glyphs + i * 2 + 16));
+        __m128i v = _mm_packus_epi16(lo, hi);
+        if (_mm_movemask_epi8(v) != 0)
+        {
+            break;
+        }
+
+        _mm_storeu_si128((__m128i *) (dest + i), v);
+    }
+#endif
+
+    for (; i < len; i++)
+    {
+        uint16_t c = load_unit16(glyphs + i * 2, false);
+        if (c >= 0x80)
+        {
+            break;
+        }
+        dest[i] = (char) c;
+    }
+
+    return i;
+}
+
+/**
+ * Encodes one character as UTF-8.
+ *
+ * @return the length of the character in bytes
+ */
+static size_t utf8_encode(uint32_t code_point, char *dest)
+{
+    unsigned char *d = (unsigned char *) dest;
+
+    if (code_point < 0x80)
+    {
+        d[0] = (unsigned char) code_point;
+        return 1;
+    }
+    else if (code_point < 0x800)
+    {
+        d[0] = (unsigned char) (0xC0 | (code_point >> 6));
+        d[1] = (unsigned char) (0x80 | (code_point & 0x3F));
+        return 2;
+    }
+    else if (code_point < 0x10000)
+    {
+        d[0] = (unsigned char) (0xE0 | (code_point >> 12));
+        d[1] = (unsigned char) (0x80 | ((code_point >> 6) & 0x3F));
+        d[2] = (unsigned char) (0x80 | (code_point & 0x3F));
+        return 3;
+    }
+
+    d[0] = (unsigned char) (0xF0 | (code_point >> 18));
+    d[1] = (unsigned char) (0x80 | ((code_point >> 12) & 0x3F));
+    d[2] = (unsigned char) (0x80 | ((code_point >> 6) & 0x3F));
+    d[3] = (unsigned char) (0x80 | (code_point & 0x3F));
+    return 4;
+}
+
+/**
+ * Reads a 16-bit unit in a given byte order.
+ */
+static uint16_t load_unit16(const char *p, bool big_endian)
+{
+    const unsigned char *b = (const unsigned char *) p;
+
+    return big_endian ? (uint16_t) ((b[0] << 8) | b[1])
+                      : (uint16_t) (b[0] | (b[1] << 8));
+}
+
+/**
+ * Looks up the glyph for a non-ASCII character.
+ *
+ * @return the glyph code, or 0 if the charset has no glyph for it
+ */
+static gxt_char lookup_glyph(const struct charset *cs, uint32_t code_point)
+{
+    return (code_point <= 0xFF) ? cs->latin1[code_point - 0x80]
+                                : cs->lookup(code_point);
+}
@@ -0,0 +1,172 @@
+/*
+ * Copyright (c) 2017 Wes Hampson <thehambone93@gmail.com>
+ *
+ * Licensed under the MIT License. See LICENSE at top level directory.
+ */
+
+/**
+ * Declarations for character sets, which map the text of a source file to the
+ * glyph codes used by a game's fonts.
+ */
+
+#ifndef _GXTMAKER_CHARSET_H_
+#define _GXTMAKER_CHARSET_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "gxt.h"
+
+#define DEFAULT_CHARSET "gta3"
+
+/**
+ * Source file text encodings.
+ */
+enum src_encoding
+{
+    SRC_ENCODING_AUTO,      /* Detect (see detect_encoding()). */
+    SRC_ENCODING_LATIN1,    /* ISO-8859-1 */
+    SRC_ENCODING_UTF8,
+    SRC_ENCODING_UTF16LE,
+    SRC_ENCODING_UTF16BE
+};
+
+/**
+ * Maps Unicode characters to glyph codes. ASCII always maps to itself.
+ *
+ * The charsets are generated at build time from the definition files in
+ * charsets/, one per charset.
+ */
+struct charset
+{
+    const char *name;
+    uint64_t fingerprint;       /* Changes whenever the mapping changes. */
+    const gxt_char *latin1;     /* Glyphs for U+0080-U+00FF (0 = none). */
+    gxt_char (*lookup)(uint32_t code_point);    /* Glyphs above U+00FF
+                                                   (0 = none). */
+    uint32_t (*reverse)(gxt_char glyph);        /* Characters for glyphs
+                                                   above 0x7F (0 = none). */
+};
+
+extern const struct charset charset_list[];
+extern const int charset_count;
+
+/**
+ * Finds a charset by name.
+ *
+ * @param name the name of the charset (e.g. "gta3")
+ *
+ * @return the charset, or NULL if there is no charset with that name
+ */
+const struct charset * charset_find(const char *name);
+
+/**
+ * Finds the charset for a game: the one named after it (see gxt_game_name()),
+ * or DEFAULT_CHARSET if the game doesn't have one of its own yet.
+ *
+ * @param game        the game
+ * @param is_fallback a pointer to where whether DEFAULT_CHARSET was used
+ *                    instead should be stored (may be NULL)
+ *
+ * @return the charset
+ */
+const struct charset * charset_for_game(enum gxt_game game,
+                                        bool *is_fallback);
+
+/**
+ * Encodes source text as glyph codes.
+ *
+ * Runs of ASCII are widened (or for UTF-16, copied) 16 bytes at a time with
+ * SIMD where available; only other characters are decoded and looked up in
+ * the charset.
+ *
+ * @param cs       the charset to encode with
+ * @param enc      the encoding of the text
+ * @param text     the text to encode
+ * @param len      the size of the text in bytes
+ * @param dest     where to store the glyph codes; must have room for len codes
+ * @param dest_len a pointer to where the number of glyph codes stored should
+ *                 be stored
+ * @param bad_char a pointer to where the code point of a character that has
+ *                 no glyph should be stored (-1 if the text is malformed)
+ *
+ * @return the number of bytes encoded; less than len if the text at that
+ *         position could not be encoded
+ */
+size_t charset_encode(const struct charset *cs, enum src_encoding enc,
+                      const char *text, size_t len,
+                      gxt_char *dest, size_t *dest_len, long *bad_char);
+
+/**
+ * Decodes glyph codes as UTF-8 text; the reverse of charset_encode().
+ *
+ * Runs of ASCII glyphs are narrowed 16 at a time with SIMD where available;
+ * only other glyphs are looked up in the charset.
+ *
+ * @param cs       the charset to decode with
+ * @param glyphs   the glyph codes, stored as 16-bit little-endian units as in
+ *                 a GXT file; need not be aligned
+ * @param len      the number of glyph codes
+ * @param dest     where to store the text; must have room for 4 * len bytes
+ * @param dest_len a pointer to where the size of the text in bytes should be
+ *                 stored
+ *
+ * @return the number of glyph codes decoded; less than len if the glyph at
+ *         that position has no character in the charset
+ */
+size_t charset_decode(const struct charset *cs, const char *glyphs,
+                      size_t len, char *dest, size_t *dest_len);
+
+/**
+ * Works out the encoding of a source file: from its byte order mark if it has
+ * one, otherwise UTF-8 if the text is well-formed UTF-8, otherwise
+ * ISO-8859-1.
+ *
+ * @param text    the file contents
+ * @param len     the size of the file in bytes
+ * @param bom_len a pointer to where the length of the byte order mark should
+ *                be stored (0 if there is none)
+ *
+ * @return the encoding
+ */
+enum src_encoding detect_encoding(const char *text, size_t len,
+                                  size_t *bom_len);
+
+/**
+ * Gets the length of the byte order mark for an encoding at the start of
+ * some text.
+ *
+ * @return the length of the byte order mark, or 0 if there is none
+ */
+size_t bom_length(const char *text, size_t len, enum src_encoding enc);
+
+/**
+ * Gets the size of the code units of an encoding.
+ *
+ * @return 2 for UTF-16, 1 for everything else
+ */
+size_t encoding_unit_size(enum src_encoding enc);
+
+/**
+ * Looks up an encoding by name ("auto", "latin1", "utf-8", "utf-16le" or
+ * "utf-16be"; case-insensitive).
+ *
+ * @param name the name of the encoding
+ * @param enc  a pointer to where the encoding should be stored
+ *
+ * @return true if the name is valid, false otherwise
+ */
+bool parse_encoding(const char *name, enum src_encoding *enc);
+
+/**
+ * Checks whether text is well-formed UTF-8.
+ *
+ * @param text the text to check
+ * @param len  the size of the text in bytes
+ *
+ * @return true if the text is well-formed, false otherwise
+ */
+bool utf8_validate(const char *text, size_t len);
+
+#endif /* _GXTMAKER_CHARSET_H_ */
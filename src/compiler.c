@@ -8,26 +8,103 @@
 #include <stdio.h>
 #include <string.h>
 
+#include "arena.h"
+#include "array.h"
+#include "cache.h"
+#include "charset.h"
 #include "compiler.h"
 #include "errwarn.h"
 #include "gxt.h"
+#include "gxtmaker.h"
+#include "hash.h"
 #include "io.h"
-#include "list.h"
+#include "pool.h"
+#include "scan.h"
+#include "stats.h"
+#include "token.h"
 
-#define CHUNK_SIZE 1024
+/* Sources at least this big are split into segments and lexed in parallel */
+#define PARALLEL_MIN_SRC_SIZE   (4 * 1024 * 1024)
+#define SEGMENT_MIN_SIZE        (256 * 1024)
+#define SEGMENTS_PER_THREAD     4
+
+#define CACHE_FILE_EXT ".cache"
+
+
+#define MIN(a, b) ((a < b) ? (a) : (b))
 
 #define START_OF_KEY        (char) '['
 #define END_OF_KEY          (char) ']'
 #define START_OF_COMMENT    (char) '{'
 #define END_OF_COMMENT      (char) '}'
 #define TOKEN_SPECIFIER     (char) '~'
+#define TABLE_SPECIFIER     (char) '@'
+
+/**
+ * Growable buffer of GXT characters. Holds the NUL-terminated strings of every
+ * entry read so far, laid out exactly as they will appear in TDAT, so reading
+ * a value does not allocate per character or per entry.
+ */
+ARRAY_DECLARE(gxt_str_buf, gxt_char)
+
+/**
+ * A TKEY entry along with where its key was defined in the source file.
+ */
+struct key_entry
+{
+    struct gxt_key key;
+    size_t src_pos;         /* Position of the key's '[' in the source text,
+                               in bytes. */
+};
+
+/**
+ * Keys stored by value, in source order.
+ */
+ARRAY_DECLARE(key_array, struct key_entry)
+
+/**
+ * A table declaration ("[@NAME]"), which puts the keys that follow it into
+ * the named table.
+ */
+struct table_start
+{
+    size_t first_key;       /* Index in TKEY of the first key that follows
+                               the declaration. */
+    char name[GXT_KEY_MAX_LEN];
+};
+
+/**
+ * Table declarations, in source order.
+ */
+ARRAY_DECLARE(table_start_array, struct table_start)
+
+/**
+ * TKEY sort record. Key names are compared as big-endian 64-bit integers,
+ * which orders them the same as strcmp() on the NUL-padded names.
+ */
+struct key_sort_item
+{
+    uint64_t sort_key;
+    const struct key_entry *entry;
+};
 
 struct compiler_state
 {
-    unsigned int src_row;   /* Source file line number. */
-    unsigned int src_col;   /* Source file column number. */
+    const char *src_file;   /* Source file name (for diagnostics). */
+    struct diag_buf *diag;  /* Where diagnostics go (NULL for stderr). */
+
+    const struct charset *charset;  /* Glyphs for GXT strings. */
+    enum src_encoding encoding;     /* Source file text encoding. */
+    const struct token_set *tokens; /* Formatting tokens the game knows
+                                       (NULL to not check them). */
+    enum gxt_game game;             /* Game the file is for. */
+
+    const char *src_text;   /* Start of the source text, which positions
+                               are measured from. */
+    const char *tok_pos;    /* Position of the token being processed. */
 
     bool is_reading_key;    /* GXT key is being read. */
+    bool is_reading_table;  /* The "key" is a table declaration. */
     bool is_reading_val;    /* GXT string is being read. */
     bool is_reading_comment;
     bool key_encountered;   /* Start of next GXT key located. */
@@ -36,23 +113,149 @@ struct compiler_state
     int current_key_chars_read; /* Number of chars read for current key. */
     int num_keys;               /* Number of keys read in total. */
 
-    list *tdat_buf;
-    list *tdat;
+    bool is_reading_token;      /* Formatting token is being read. */
+    bool is_expecting_control;  /* Key binding token was just read. */
+    const char *token_pos;      /* Position of the token's opening '~'. */
+    char token[TOKEN_MAX_LEN + 1];  /* Token name read so far. */
+    int token_len;
+
+    struct gxt_str_buf tdat;    /* TDAT contents built so far. */
+    size_t val_start;           /* Position in TDAT of current value. */
+
+    struct key_entry *key_buf;  /* Key currently being read; always the
+                                   last element of tkey. */
+    struct key_array tkey;      /* Keys in source order. */
+    struct table_start_array tables;    /* Tables declared so far. */
+};
+
+/**
+ * A contiguous piece of the source file that is lexed on its own, with its
+ * own compiler state. Every segment but the first starts at a key.
+ */
+struct src_segment
+{
+    const char *data;
+    size_t size;
+
+    struct compiler_state state;
+    uint32_t tdat_base;     /* Offset of the segment's TDAT in the whole
+                               TDAT, in bytes. */
+    arena *arena;           /* Segment memory (parallel lexing only). */
+    struct diag_buf diag;   /* Segment diagnostics (parallel lexing only). */
+    entry_cache *cache;     /* Entries lexed from this segment (caching only). */
+    int result;
+};
+
+/**
+ * Where each line of the source text ends. Only keys' positions are kept
+ * while lexing, and this is only built once a diagnostic needs to turn one
+ * into a line and column number.
+ */
+struct line_index
+{
+    size_t *ends;           /* Position of each '\n' in the source text. */
+    size_t num_ends;
+    bool is_built;
+};
+
+/**
+ * A table of the output file, which has a TKEY and TDAT of its own. Every
+ * file has a MAIN table, which holds the keys that come before any table
+ * declaration; files for games without tables have nothing else.
+ */
+struct table
+{
+    char name[GXT_KEY_MAX_LEN];
+    struct key_entry **keys;        /* The table's keys, in source order. */
+    size_t num_keys;
+    struct key_sort_item *sorted;   /* The keys, in TKEY order. */
+
+    bool has_own_tdat;              /* The table's strings are in tdat
+                                       rather than the segments. */
+    struct gxt_str_buf tdat;
+    size_t saved;                   /* TDAT chars saved by sharing
+                                       strings. */
+
+    size_t pos;             /* File position of the table. */
+    size_t tkey_pos;        /* File position of TKEY data. */
+    size_t tkey_size;       /* Size of TKEY data (excluding header). */
+    size_t tdat_pos;        /* File position of TDAT data. */
+    size_t tdat_size;       /* Size of TDAT data (excluding header). */
+
+    arena *arena;           /* Table memory (parallel builds only). */
+    int result;
+};
 
-    uint32_t tdat_offset;
+/**
+ * A source file being compiled, split into one or more segments.
+ */
+struct compilation
+{
+    const char *src_file;
+    struct diag_buf *diag;
+    arena *arena;           /* Memory for everything below. */
+
+    const char *text;       /* The source text (after any byte order
+                               mark). */
+    size_t text_size;
+    struct line_index lines;
+
+    const struct charset *charset;
+    bool charset_is_fallback;       /* The game has no charset of its own. */
+    enum src_encoding encoding;
+    enum gxt_game game;
+    const struct token_set *tokens;
+
+    struct src_segment *segs;
+    int num_segs;
+
+    bool use_cache;                 /* Record entries for the next build. */
+    const entry_cache *old_cache;   /* Entries from the last build. */
+
+    bool dedupe;                    /* Share TDAT storage between strings. */
+    struct table *tables;           /* MAIN, then any other tables. */
+    int num_tables;
+};
+
+/**
+ * A distinct string in TDAT (string sharing only).
+ */
+struct tdat_string
+{
+    const gxt_char *chars;  /* String in the unshared TDAT. */
+    uint32_t len;           /* Length, including NUL terminator. */
+    uint32_t owner;         /* Index of the string this one is stored in. */
+    uint32_t pos;           /* Position in the shared TDAT (owners only). */
+};
 
-    struct gxt_key *key_buf;
-    list *tkey;
+/**
+ * Positions and sizes of each part of the output file, computed up front so
+ * that the whole file can be encoded into a single buffer. Each table's own
+ * positions are kept in the table.
+ */
+struct gxt_layout
+{
+    enum gxt_game game;
+    size_t char_size;       /* Size of a TDAT char in the file. */
+    size_t key_size;        /* Size of a TKEY entry in the file. */
+    size_t num_keys;        /* Keys in every table. */
+    bool has_tabl;          /* The file starts with a TABL block. */
+    size_t tabl_pos;        /* File position of the TABL block header. */
+    size_t image_size;      /* Size of the whole file. */
 };
 
-/*struct gxt_tabl
+/**
+ * What emit_table_task() needs to encode the tables into the output.
+ */
+struct emit_job
 {
-    struct gxt_tkey *tkey;
-    struct gxt_tdat *tdat;
-};*/
+    const struct compilation *comp;
+    const struct gxt_layout *layout;
+    char *image;
+};
 
 /* Basic compilation process (ideas, GTA III format)
- *   1) Process file in chunks
+ *   1) Process file (mapped into memory in its entirety)
  *      a) Store keys in list, w/ pointers to their corresponding values
  *         (build TKEY)
  *      b) Store values in list (build TDAT)
@@ -66,341 +269,2668 @@ struct compiler_state
  *            (should maybe see if an upper limit is imposed by game executable and
  *            set a max size based on that)
  *   2) Sort TKEY alphabetically (LATER: introduce a compiler flag to disable
- *      this if wanted)
+ *      this if wanted); radix sort on the 8-byte names, which also puts
+ *      duplicate keys next to each other
  *   3) Output the GXT file
  */
 
 /* TODO (simplified)
  *   1) Handle nested comments
  *   2) Trim GXT strings (leading and trailng whitespace)
- *   3) Character encoding
- *   4) Output GXT file
- *   5) Develop methods for source file error checking
+ *   3) Develop methods for source file error checking
  */
 
 
+static arena * use_arena(const struct compile_options *opts,
+                         arena **own_arena);
+static int compile_file(const char *src_file, const char *out_file,
+                        const struct compile_options *opts,
+                        struct diag_buf *diag, arena *ar);
+static void init_compilation(struct compilation *comp, const char *src_file,
+                             const char *data, size_t size,
+                             const struct compile_options *opts,
+                             struct diag_buf *diag, arena *ar,
+                             const char **text, size_t *text_size);
+static int lex_source(struct compilation *comp, const char *text, size_t size,
+                      int num_threads);
+static int build_image(struct compilation *comp,
+                       const struct compile_options *opts,
+                       const struct allocator *alloc,
+                       char **image, size_t *image_size);
 static int compile_chunk(const char *chunk, size_t chunk_size,
                          struct compiler_state *state);
-static int process_key_token(unsigned char tok, struct compiler_state *state);
-static int process_value_token(unsigned char tok, struct compiler_state *state);
-static int process_comment_token(unsigned char tok, struct compiler_state *state);
+static int encode_value_run(const char *text, size_t len,
+                            struct compiler_state *state);
+static int check_tokens(const char *text, size_t len,
+                        struct compiler_state *state);
+static size_t find_token(const char *buf, size_t len, enum src_encoding enc);
+static int end_token(struct compiler_state *state);
+static int report_token(int e_id, const char *name,
+                        const struct compiler_state *state);
+static size_t scan_plain_run(const char *buf, size_t len,
+                             const struct compiler_state *state);
+static int process_token(unsigned int tok, struct compiler_state *state);
+static int end_entry(struct compiler_state *state);
+static int process_key_token(unsigned int tok, struct compiler_state *state);
+static int end_table(struct compiler_state *state);
+static int process_comment_token(unsigned int tok, struct compiler_state *state);
+
+static int split_source(struct compilation *comp,
+                        const char *data, size_t size, int num_threads);
+static int lex_segments(struct compilation *comp, int num_threads);
+static bool has_non_ascii(const struct compilation *comp);
+static bool init_segment_state(struct compilation *comp, int index);
+static int lex_cached(const char *data, size_t size, bool is_final,
+                      const entry_cache *old_cache, entry_cache *new_cache,
+                      struct compiler_state *state);
+static int reuse_entry(const struct cache_entry *entry,
+                       struct compiler_state *state);
+static size_t find_key_start(const char *data, size_t size, size_t pos,
+                             enum src_encoding enc, bool *in_comment);
+static void lex_segment_task(void *arg, size_t index);
+static void free_compilation(struct compilation *comp);
+static int assign_tables(struct compilation *comp);
+static struct table * find_table(struct compilation *comp,
+                                 const char name[GXT_KEY_MAX_LEN]);
+static int run_tables(struct compilation *comp, thread_pool *pool,
+                      pool_index_fn fn, void *arg);
+static int check_tables(struct compilation *comp);
+static void sort_table_task(void *arg, size_t index);
+static void build_tdat_task(void *arg, size_t index);
+static void emit_table_task(void *arg, size_t index);
+static int compare_table_names(const void *a, const void *b);
+static void plan_layout(struct compilation *comp, struct gxt_layout *layout);
+static int sort_keys(struct table *t, arena *ar);
+static void report_duplicates(struct compilation *comp, const struct table *t);
+static int sort_keys_by_hash(struct table *t, arena *ar);
+static void report_collisions(struct compilation *comp, const struct table *t);
+static int share_strings(const struct compilation *comp, struct table *t,
+                         arena *ar);
+static int gather_strings(const struct compilation *comp, struct table *t,
+                          arena *ar);
+static const gxt_char * segment_string(const struct compilation *comp,
+                                       uint32_t offset);
+static size_t tdat_char_size(enum gxt_game game);
+static int compare_reversed(const void *a, const void *b);
+static void radix_sort(struct key_sort_item *items, struct key_sort_item *tmp,
+                       size_t n);
+static void emit_header(const struct compilation *comp,
+                        const struct gxt_layout *layout, char *image);
+static void emit_table(const struct compilation *comp,
+                       const struct gxt_layout *layout,
+                       const struct table *t, char *image);
+static void write_block_header(char *dest, const char *sig, size_t size);
+static void write_sa_header(char *dest);
+static void copy_tdat(char *dest, const gxt_char *chars, size_t n,
+                      size_t char_size);
+
+static uint64_t options_fingerprint(const struct compile_options *opts,
+                                    const struct charset *cs,
+                                    const struct token_set *tokens,
+                                    enum src_encoding enc);
+static bool is_up_to_date(const struct cache_stamp *last,
+                          const struct cache_stamp *stamp,
+                          const char *out_file);
+static void save_cache(entry_cache *cache, const char *cache_path,
+                       const char *out_file);
+static char * make_cache_path(const char *out_file, arena *ar);
+
+static size_t find_delims(const char *buf, size_t len,
+                          const char delims[SCAN_NUM_DELIMS],
+                          enum src_encoding enc);
+static size_t count_lines(const char *buf, size_t len, enum src_encoding enc);
+static void find_line_col(const char *text, const char *pos,
+                          enum src_encoding enc, int *line, int *col);
+static void find_key_line_col(struct compilation *comp,
+                              const struct key_entry *k, int *line, int *col);
+static bool build_line_index(struct compilation *comp);
+static unsigned int read_unit(const char *p, enum src_encoding enc);
+static uint16_t stored_unit(char c, enum src_encoding enc);
+
+static bool is_whitespace(unsigned int c);
+static bool starts_value(unsigned int c);
+
+int compile(const char *src_file, const char *out_file,
+            const struct compile_options *opts, struct diag_buf *diag)
+{
+    arena *own_arena = NULL;
+    arena *ar = use_arena(opts, &own_arena);
+    if (ar == NULL)
+    {
+        return COMPILE_OUT_OF_MEMORY;
+    }
+
+    int result = compile_file(src_file, out_file, opts, diag, ar);
+
+    /* Everything the compilation allocated goes in one go, however far it
+       got */
+    arena_reset(ar);
+    arena_destroy(&own_arena);
 
-static bool is_whitespace(char c);
+    return result;
+}
 
-int compile(const char *src_file, const char *out_file)
+int compile_buffer(const char *name, const char *src, size_t src_size,
+                   char **out, size_t *out_size,
+                   const struct compile_options *opts, struct diag_buf *diag)
 {
-    FILE *src = fopen(src_file, "rb");
-    if (src == NULL)
+    arena *own_arena = NULL;
+    arena *ar = use_arena(opts, &own_arena);
+    if (ar == NULL)
     {
-        error(E_FILE_UNREADABLE, src_file);
-        return COMPILE_FILE_UNREADABLE;
+        return COMPILE_OUT_OF_MEMORY;
     }
 
-    int bytes_read = 0;
-    int chunk_count = 0;
-
-    struct compiler_state state = { 0 };
-    state.src_row = 1;
-    state.src_col = 1;
-    list_create(&state.tdat_buf);
-    list_create(&state.tdat);
-    list_create(&state.tkey);
+    struct compile_stats *stats = (opts != NULL) ? opts->stats : NULL;
+    stats_begin(stats);
 
-    //printf("Reading %s in chunks of %d bytes...\n", src_file, CHUNK_SIZE);
+    struct compilation comp;
+    const char *text;
+    size_t text_size;
+    init_compilation(&comp, name, src, src_size, opts, diag, ar,
+                     &text, &text_size);
 
-    char buf[CHUNK_SIZE];
-    int result;
-    while ((bytes_read = fread(buf, sizeof(char), sizeof(buf), src)) > 0)
+    if (stats != NULL)
     {
-        //printf("===== Chunk %d ===== \n", chunk_count);
-        chunk_count++;
+        stats->src_size = src_size;
+    }
+    stats_end(stats, PHASE_READ);
+    stats_begin(stats);
 
-        result = compile_chunk(buf, bytes_read, &state);
-        if (result != COMPILE_SUCCESS)
-        {
-            break;
-        }
+    int num_threads = (opts != NULL) ? opts->num_threads : 1;
+    int result = lex_source(&comp, text, text_size, num_threads);
+
+    stats_end(stats, PHASE_LEX);
+
+    /* The output outlives the arena, so it comes straight from the
+       allocator */
+    const struct allocator *alloc = arena_allocator(ar);
+    if (result == COMPILE_SUCCESS)
+    {
+        result = build_image(&comp, opts, alloc, out, out_size);
     }
 
-    fclose(src);
+    free_compilation(&comp);
+    arena_reset(ar);
+    arena_destroy(&own_arena);
+
+    return result;
+}
+
+/**
+ * Gets the arena a compilation should allocate from: the one in the options,
+ * or failing that a new one, which the caller must destroy.
+ *
+ * @param opts      the compilation settings (may be NULL)
+ * @param own_arena a pointer to where a new arena should be stored
+ *
+ * @return the arena, or NULL if one could not be created
+ */
+static arena * use_arena(const struct compile_options *opts,
+                         arena **own_arena)
+{
+    if (opts != NULL && opts->arena != NULL)
+    {
+        return opts->arena;
+    }
 
-    /* TODO: Ensure clean exit when compilation fails */
+    const struct allocator *alloc = (opts != NULL && opts->allocator != NULL)
+        ? opts->allocator
+        : &mem_heap_allocator;
+    if (!arena_create_with(own_arena, alloc))
+    {
+        return NULL;
+    }
 
-    //printf("Read %d keys in %d chunks.\n", (int) list_size(state.tkey), chunk_count);
+    return *own_arena;
+}
 
-    /* Clear remaining chars in TDAT buffer */
-    iterator *it;
-    iterator_create(state.tdat_buf, &it);
-    gxt_char *c;
+/**
+ * Compiles a file, allocating from an arena. Nothing allocated from the arena
+ * is freed; everything else is released before returning.
+ */
+static int compile_file(const char *src_file, const char *out_file,
+                        const struct compile_options *opts,
+                        struct diag_buf *diag, arena *ar)
+{
+    struct compile_stats *stats = (opts != NULL) ? opts->stats : NULL;
+    stats_begin(stats);
 
-    while (iterator_has_next(it))
+    struct mapped_file src;
+    if (!map_file(src_file, &src))
     {
-        iterator_next(it, (void **) &c);
-        free(c);
+        error(diag, E_FILE_UNREADABLE, src_file);
+        stats_end(stats, PHASE_READ);
+        return COMPILE_FILE_UNREADABLE;
     }
-    iterator_destroy(&it);
 
-    /* Clear TKEY buffer */
-    free(state.key_buf);
+    int num_threads = (opts != NULL) ? opts->num_threads : 1;
+    bool use_cache = (opts != NULL) && opts->use_cache;
 
-    /* Build TKEY*/
-    size_t tkey_size = list_size(state.tkey) * sizeof(struct gxt_key);
-    //printf("sizeof(TKEY) = %lu\n", tkey_size);
+    struct compilation comp;
+    const char *text;
+    size_t text_size;
+    init_compilation(&comp, src_file, src.data, src.size, opts, diag, ar,
+                     &text, &text_size);
 
-    struct gxt_key *tkey = (struct gxt_key *) malloc(tkey_size);
-    struct gxt_key *k;
+    /* Load the cache from the last build, and skip this build entirely if
+       nothing has changed since then */
+    char *cache_path = NULL;
+    entry_cache *old_cache = NULL;
+    entry_cache *new_cache = NULL;
 
-    int i = 0;
-    iterator_create(state.tkey, &it);
-    while (iterator_has_next(it))
+    if (use_cache)
     {
-        iterator_next(it, (void **) &k);
-        tkey[i++] = *k;
-        free(k);
+        struct cache_stamp stamp = { 0 };
+        stamp.fingerprint = options_fingerprint(opts, comp.charset,
+                                                comp.tokens, comp.encoding);
+        stamp.src_hash = hash64(src.data, src.size, 0);
+        stamp.src_size = src.size;
+
+        struct cache_stamp last;
+        cache_path = make_cache_path(out_file, ar);
+        if (cache_path != NULL && cache_read_stamp(cache_path, &last))
+        {
+            if (is_up_to_date(&last, &stamp, out_file))
+            {
+                unmap_file(&src);
+                stats_end(stats, PHASE_READ);
+                return COMPILE_SUCCESS;
+            }
+
+            /* Entries encoded with other settings can't be reused */
+            if (last.fingerprint == stamp.fingerprint)
+            {
+                cache_load(&old_cache, cache_path);
+            }
+        }
+
+        if (cache_path == NULL || !cache_create(&new_cache, &stamp))
+        {
+            cache_destroy(&old_cache);
+            unmap_file(&src);
+            stats_end(stats, PHASE_READ);
+            return COMPILE_OUT_OF_MEMORY;
+        }
     }
-    iterator_destroy(&it);
 
-    /* Dump TKEY */
-    //hex_dump((void *) tkey, tkey_size);
-    //printf("\n\n");
+    comp.use_cache = use_cache;
+    comp.old_cache = old_cache;
 
-    /* Build TDAT */
-    size_t tdat_size = 0;
-    iterator_create(state.tdat, &it);
-    while (iterator_has_next(it))
+    if (stats != NULL)
     {
-        iterator_next(it, (void **) &c);
-        tdat_size += (gxt_strlen(c) + 1) * sizeof(gxt_char);
+        stats->src_size = src.size;
     }
-    //printf("sizeof(TDAT) = %lu\n", tdat_size);
-    iterator_destroy(&it);
+    stats_end(stats, PHASE_READ);
+    stats_begin(stats);
 
-    gxt_char *tdat = (gxt_char *) malloc(tdat_size);
-    i = 0;
+    int result = lex_source(&comp, text, text_size, num_threads);
 
-    iterator_create(state.tdat, &it);
-    while (iterator_has_next(it))
+    for (int i = 0; i < comp.num_segs && use_cache; i++)
     {
-        iterator_next(it, (void **) &c);
-        for (size_t j = 0; j < gxt_strlen(c); j++)
+        if (result == COMPILE_SUCCESS
+            && !cache_append(new_cache, comp.segs[i].cache))
         {
-            tdat[i++] = c[j];
+            result = COMPILE_OUT_OF_MEMORY;
         }
-        tdat[i++] = 0;
-        free(c);
     }
-    iterator_destroy(&it);
 
-    /* Dump TDAT */
-    //hex_dump((void *) tdat, tdat_size);
-    //printf("\n");
+    cache_destroy(&old_cache);
+
+    stats_end(stats, PHASE_LEX);
 
-    struct gxt_block_header tkey_header;
-    strncpy(tkey_header.sig, "TKEY", 4);
-    tkey_header.size = tkey_size;
+    /* The source stays mapped while the image is built, as duplicate keys
+       found while sorting TKEY are located by counting lines in it */
+    char *image = NULL;
+    size_t image_size = 0;
+    if (result == COMPILE_SUCCESS)
+    {
+        result = build_image(&comp, opts, NULL, &image, &image_size);
+    }
 
-    struct gxt_block_header tdat_header;
-    strncpy(tdat_header.sig, "TDAT", 4);
-    tdat_header.size = tdat_size;
+    unmap_file(&src);
+    free_compilation(&comp);
 
-    FILE *dest = fopen(out_file, "wb");
-    if (dest == NULL)
+    if (result != COMPILE_SUCCESS)
     {
-        error(E_FILE_UNREADABLE, out_file);
-        return COMPILE_FILE_UNREADABLE;
+        cache_destroy(&new_cache);
+        return result;
     }
 
-    fwrite(&tkey_header, sizeof(struct gxt_block_header), 1, dest);
-    fwrite(tkey, tkey_size, 1, dest);
-    fwrite(&tdat_header, sizeof(struct gxt_block_header), 1, dest);
-    fwrite(tdat, tdat_size, 1, dest);
+    stats_begin(stats);
+
+    /* Replace the output all at once, so that nothing ever loads a partly
+       written file */
+    if (!write_file_atomic(out_file, image, image_size))
+    {
+        error(diag, E_FILE_UNWRITABLE, out_file);
+        cache_destroy(&new_cache);
+        stats_end(stats, PHASE_WRITE);
+        return COMPILE_FILE_UNWRITABLE;
+    }
 
-    fclose(dest);
+    if (new_cache != NULL)
+    {
+        save_cache(new_cache, cache_path, out_file);
+    }
 
-    free(tdat);
-    free(tkey);
+    cache_destroy(&new_cache);
 
-    list_destroy(&state.tdat_buf);
-    list_destroy(&state.tdat);
-    list_destroy(&state.tkey);
+    stats_end(stats, PHASE_WRITE);
 
     return result;
 }
 
-static int compile_chunk(const char *chunk, size_t chunk_size,
-                         struct compiler_state *state)
+/**
+ * Sets up a compilation of a source that is in memory, and works out where
+ * the text of the source starts and ends.
+ *
+ * @param comp      the compilation to set up
+ * @param src_file  the name of the source (for diagnostics)
+ * @param data      the source contents
+ * @param size      the size of the source in bytes
+ * @param opts      the compilation settings (may be NULL)
+ * @param diag      the buffer to write diagnostics to
+ * @param ar        the arena to allocate from
+ * @param text      a pointer to where the start of the text should be stored
+ * @param text_size a pointer to where the size of the text should be stored
+ */
+static void init_compilation(struct compilation *comp, const char *src_file,
+                             const char *data, size_t size,
+                             const struct compile_options *opts,
+                             struct diag_buf *diag, arena *ar,
+                             const char **text, size_t *text_size)
 {
-    unsigned char tok;
-    int result = 0;
+    memset(comp, 0, sizeof(struct compilation));
+    comp->src_file = src_file;
+    comp->diag = diag;
+    comp->arena = ar;
+    comp->game = (opts != NULL) ? opts->game : GXT_GAME_GTA3;
+    comp->charset = charset_for_game(comp->game, &comp->charset_is_fallback);
+    comp->tokens = token_set_find(gxt_game_name(comp->game));
+
+    /* Work out how the source is encoded, and skip its byte order mark */
+    enum src_encoding enc = (opts != NULL) ? opts->input_encoding
+                                           : SRC_ENCODING_AUTO;
+    size_t bom_len;
+    if (enc == SRC_ENCODING_AUTO)
+    {
+        enc = detect_encoding(data, size, &bom_len);
+    }
+    else
+    {
+        bom_len = bom_length(data, size, enc);
+    }
+    comp->encoding = enc;
+
+    /* A trailing partial unit could only be part of the final value, which
+       is always dropped */
+    *text = data + bom_len;
+    *text_size = size - bom_len;
+    *text_size -= *text_size % encoding_unit_size(enc);
+    comp->text = *text;
+    comp->text_size = *text_size;
+}
+
+/**
+ * Lexes the source, in parallel if it is big enough to be worth it.
+ *
+ * @return COMPILE_SUCCESS, or the status of the first error encountered
+ */
+static int lex_source(struct compilation *comp, const char *text, size_t size,
+                      int num_threads)
+{
+    int result = split_source(comp, text, size, num_threads);
+    if (result == COMPILE_SUCCESS)
+    {
+        result = lex_segments(comp, num_threads);
+    }
 
-    for (size_t i = 0; i < chunk_size; i++, state->src_col++)
+    /* Text that is all ASCII comes out the same in every charset, so the
+       stand-in charset only matters if anything else was encoded */
+    if (result == COMPILE_SUCCESS && comp->charset_is_fallback
+        && has_non_ascii(comp))
     {
-        tok = (unsigned char) chunk[i];
+        note(comp->diag, N_CHARSET_FALLBACK, comp->src_file,
+             gxt_game_name(comp->game), comp->charset->name);
+    }
+
+    return result;
+}
+
+/**
+ * Puts the keys into their tables, sorts each table's TKEY and shares
+ * strings if asked to, then sizes the output and encodes everything straight
+ * into it. When there is more than one table, the tables are built and
+ * encoded on up to opts->num_threads threads at once.
+ *
+ * @param comp       the compilation, lexed successfully
+ * @param opts       the compilation settings (may be NULL)
+ * @param alloc      where to allocate the output from
+ *                   (use NULL for the compilation's arena)
+ * @param image      a pointer to where the output should be stored
+ * @param image_size a pointer to where the size of the output should be
+ *                   stored
+ *
+ * @return COMPILE_SUCCESS, or the status of the first error encountered
+ */
+static int build_image(struct compilation *comp,
+                       const struct compile_options *opts,
+                       const struct allocator *alloc,
+                       char **image, size_t *image_size)
+{
+    struct compile_stats *stats = (opts != NULL) ? opts->stats : NULL;
+    int num_threads = (opts != NULL) ? opts->num_threads : 1;
+    stats_begin(stats);
+
+    comp->dedupe = (opts != NULL) && opts->dedupe;
+    int result = assign_tables(comp);
 
-        /* Check whether compiler needs to switch processing mode */
-        switch (tok)
+    /* Tables built on different threads each need an arena of their own */
+    thread_pool *pool = NULL;
+    if (result == COMPILE_SUCCESS && comp->num_tables > 1 && num_threads > 1)
+    {
+        for (int i = 0; i < comp->num_tables; i++)
+        {
+            if (!arena_create_with(&comp->tables[i].arena,
+                                   arena_allocator(comp->arena)))
+            {
+                result = COMPILE_OUT_OF_MEMORY;
+                break;
+            }
+        }
+        if (result == COMPILE_SUCCESS)
         {
-            /* Only act on LF characters, ignore pesky Windows CR characters */
-            /* TODO: Check line-ending compliance with current input file
-               encoding */
-            case '\n':
-                state->src_row++;
-                state->src_col = 0;
-                /* TODO: insert space if reading GXT string? */
+            pool_create(&pool, MIN(num_threads, comp->num_tables));
+        }
+    }
 
-            case '\r':
-                continue;
+    if (result == COMPILE_SUCCESS)
+    {
+        result = run_tables(comp, pool, sort_table_task, comp);
+    }
 
-            case START_OF_KEY:
-                if (state->is_reading_comment)
-                {
-                    break;
-                }
+    /* TABL lists MAIN first, then the other tables by name, and the tables
+       are stored in that order too */
+    if (result == COMPILE_SUCCESS)
+    {
+        qsort(comp->tables + 1, comp->num_tables - 1, sizeof(struct table),
+              compare_table_names);
+    }
 
-                if (state->val_encountered)
-                {
-                    //printf("Done reading value.\n");
+    stats_end(stats, PHASE_TKEY);
+    stats_begin(stats);
 
-                    size_t len = list_size(state->tdat_buf);
-                    gxt_char *buf = (gxt_char *) malloc((len + 1) * sizeof(gxt_char));
+    if (result == COMPILE_SUCCESS)
+    {
+        result = run_tables(comp, pool, build_tdat_task, comp);
+    }
+    if (result == COMPILE_SUCCESS && comp->dedupe)
+    {
+        size_t saved = 0;
+        size_t total = 0;
+        for (int i = 0; i < comp->num_tables; i++)
+        {
+            saved += comp->tables[i].saved;
+            total += comp->tables[i].tdat.len + comp->tables[i].saved;
+        }
 
-                    iterator *it;
-                    iterator_create(state->tdat_buf, &it);
+        size_t char_size = tdat_char_size(comp->game);
+        saved *= char_size;
+        total *= char_size;
+        note(comp->diag, N_TDAT_SHARED, comp->src_file, saved, total,
+             (total > 0) ? 100.0 * saved / total : 0.0);
+    }
 
-                    int pos = 0;
-                    gxt_char *c;
-                    while (iterator_has_next(it))
-                    {
-                        iterator_next(it, (void **) &c);
-                        buf[pos++] = *c;
-                        free(c);
-                    }
-                    buf[len] = 0;
+    char *buf = NULL;
+    struct gxt_layout layout;
+    if (result == COMPILE_SUCCESS)
+    {
+        plan_layout(comp, &layout);
 
-                    iterator_destroy(&it);
-                    list_clear(state->tdat_buf);
+        buf = (alloc != NULL)
+            ? (char *) alloc->alloc(alloc->ctx, layout.image_size)
+            : (char *) arena_alloc(comp->arena, layout.image_size);
+        if (buf == NULL)
+        {
+            result = COMPILE_OUT_OF_MEMORY;
+        }
+    }
+    if (result == COMPILE_SUCCESS)
+    {
+        struct emit_job job = { comp, &layout, buf };
+        emit_header(comp, &layout, buf);
+        result = run_tables(comp, pool, emit_table_task, &job);
+    }
 
-                    list_append(state->tdat, (void *) buf);
-                    state->tdat_offset += sizeof(gxt_char); /* NUL char */
+    pool_destroy(&pool);
 
-                    list_append(state->tkey, (void *) state->key_buf);
+    if (result != COMPILE_SUCCESS)
+    {
+        if (buf != NULL && alloc != NULL)
+        {
+            alloc->free(alloc->ctx, buf, layout.image_size);
+        }
+        stats_end(stats, PHASE_TDAT);
+        return result;
+    }
 
-                    //free(buf);
-                }
+    if (stats != NULL)
+    {
+        stats->num_keys = layout.num_keys;
+        stats->out_size = layout.image_size;
+    }
+    stats_end(stats, PHASE_TDAT);
 
-                state->key_buf = (struct gxt_key *) calloc(1, sizeof(struct gxt_key));
-                state->key_buf->offset = state->tdat_offset;
+    *image = buf;
+    *image_size = layout.image_size;
 
-                state->is_reading_key = true;
-                state->is_reading_val = false;
-                state->is_reading_comment = false;
-                state->key_encountered = true;
-                state->current_key_chars_read = 0;
-                continue;
+    return COMPILE_SUCCESS;
+}
 
-            case START_OF_COMMENT:
-                state->is_reading_key = false;
-                state->is_reading_val = false;
-                state->is_reading_comment = true;
-                //state->key_encountered = true;
-                continue;
+/**
+ * Divides the source into segments that can be lexed independently.
+ *
+ * Small sources, or any source when only one thread may be used, become a
+ * single segment. Otherwise the source is cut at the first key start ('['
+ * outside of a comment) after each target segment size. A '[' outside of a
+ * comment always puts the lexer into the same state no matter what came
+ * before it, so lexing the pieces separately gives the same keys and strings
+ * as lexing the whole source.
+ *
+ * @param comp        the compilation to create the segments for
+ * @param data        the source text
+ * @param size        the size of the source text in bytes
+ * @param num_threads the number of threads that may be used
+ *
+ * @return COMPILE_SUCCESS, or COMPILE_OUT_OF_MEMORY if the segments could not
+ *         be allocated
+ */
+static int split_source(struct compilation *comp,
+                        const char *data, size_t size, int num_threads)
+{
+    static const char comment_delims[SCAN_NUM_DELIMS] =
+        { START_OF_COMMENT, END_OF_COMMENT, START_OF_COMMENT, END_OF_COMMENT };
+    static const char split_delims[SCAN_NUM_DELIMS] =
+        { START_OF_COMMENT, END_OF_COMMENT, START_OF_KEY, START_OF_KEY };
+
+    enum src_encoding enc = comp->encoding;
+    size_t width = encoding_unit_size(enc);
+
+    size_t max_segs = 1;
+    size_t target_size = size;
+    if (num_threads > 1 && size >= PARALLEL_MIN_SRC_SIZE)
+    {
+        max_segs = (size_t) num_threads * SEGMENTS_PER_THREAD;
+        target_size = size / max_segs;
+        if (target_size < SEGMENT_MIN_SIZE)
+        {
+            target_size = SEGMENT_MIN_SIZE;
+            max_segs = size / target_size;
         }
+    }
+
+    comp->segs = (struct src_segment *)
+        arena_calloc(comp->arena, max_segs, sizeof(struct src_segment));
+    if (comp->segs == NULL)
+    {
+        return COMPILE_OUT_OF_MEMORY;
+    }
+
+    /* Find segment start positions. The comment state only changes at '{'
+       and '}', so only those need to be looked at until the next target
+       position is reached. */
+    comp->segs[0].data = data;
+    comp->num_segs = 1;
+
+    size_t pos = 0;
+    size_t next_split = target_size;
+    bool in_comment = false;
 
-        if (state->is_reading_key)
+    while (pos < size && (size_t) comp->num_segs < max_segs)
+    {
+        const char *delims = (pos < next_split) ? comment_delims
+                                                : split_delims;
+        pos += find_delims(data + pos, size - pos, delims, enc);
+        if (pos >= size)
         {
-            result = process_key_token(tok, state);
+            break;
         }
-        else if (state->is_reading_val)
+
+        unsigned int c = read_unit(data + pos, enc);
+        if (c == START_OF_COMMENT)
         {
-            result = process_value_token(tok, state);
+            in_comment = true;
         }
-        else if (state->is_reading_comment)
+        else if (c == END_OF_COMMENT)
         {
-            result = process_comment_token(tok, state);
+            in_comment = false;
         }
-
-        if (result != 0)
+        else if (!in_comment && pos >= next_split)
         {
-            break;
+            comp->segs[comp->num_segs++].data = data + pos;
+            next_split = pos + target_size;
         }
+
+        pos += width;
     }
 
-    return result;
+    for (int i = 0; i < comp->num_segs; i++)
+    {
+        struct src_segment *seg = &comp->segs[i];
+        const char *end = (i + 1 < comp->num_segs) ? comp->segs[i + 1].data
+                                                   : data + size;
+        seg->size = end - seg->data;
+    }
+
+    return COMPILE_SUCCESS;
 }
 
-static int process_key_token(unsigned char tok, struct compiler_state *state)
+/**
+ * Lexes every segment of the source, then merges the results so that TDAT
+ * offsets are relative to the start of the whole TDAT.
+ *
+ * Diagnostics from each segment are passed on in source order. Lexing stops
+ * at the first error, so diagnostics from any segment after the first one
+ * that failed are discarded, exactly as if the source had been lexed in one
+ * go.
+ *
+ * @param comp        the compilation holding the segments
+ * @param num_threads the number of threads that may be used
+ *
+ * @return the status of the first segment that failed, or COMPILE_SUCCESS
+ */
+static int lex_segments(struct compilation *comp, int num_threads)
 {
-    if (tok == END_OF_KEY && state->is_reading_key && !state->is_reading_comment)
+    int result = COMPILE_SUCCESS;
+
+    for (int i = 0; i < comp->num_segs; i++)
     {
-        //printf("Done reading key.\n");
-        state->is_reading_key = false;
-        state->is_reading_val = true;
-        state->is_reading_comment = false;
-        state->key_encountered = false;
-        state->val_encountered = false;
-        state->num_keys++;
+        if (!init_segment_state(comp, i))
+        {
+            return COMPILE_OUT_OF_MEMORY;
+        }
+    }
 
-        return COMPILE_SUCCESS;
+    thread_pool *pool = NULL;
+    if (comp->num_segs > 1
+        && pool_create(&pool, MIN(num_threads, comp->num_segs)))
+    {
+        if (!pool_parallel_for(pool, lex_segment_task, comp, comp->num_segs))
+        {
+            result = COMPILE_OUT_OF_MEMORY;
+        }
+        pool_destroy(&pool);
+    }
+    else
+    {
+        for (int i = 0; i < comp->num_segs; i++)
+        {
+            lex_segment_task(comp, i);
+        }
     }
 
-    state->key_buf->name[state->current_key_chars_read] = tok;
-    state->current_key_chars_read++;
-    if (state->current_key_chars_read >= GXT_KEY_MAX_LEN)
+    /* Merge results in source order */
+    uint32_t tdat_base = 0;
+    for (int i = 0; i < comp->num_segs && result == COMPILE_SUCCESS; i++)
     {
-        fprintf(stderr, "gxt key exceeds maximum length (%02d:%02d)\n",
-                state->src_row, state->src_col);
+        struct src_segment *seg = &comp->segs[i];
 
-        return COMPILE_GXT_KEY_TOO_LONG;
-    }
+        if (comp->num_segs > 1)
+        {
+            diag_buf_move(comp->diag, &seg->diag);
+        }
+        result = seg->result;
 
-    //printf("K(%02d:%02d) = %c\n", state->src_row, state->src_col, tok);
+        ARRAY_FOR_EACH(struct key_entry, k, &seg->state.tkey)
+        {
+            k->key.offset += tdat_base;
+        }
 
-    return COMPILE_SUCCESS;
+        seg->tdat_base = tdat_base;
+        tdat_base += (uint32_t) (seg->state.tdat.len * sizeof(gxt_char));
+    }
+
+    return result;
 }
 
-static int process_value_token(unsigned char tok, struct compiler_state *state)
+/**
+ * Checks whether any string of a lexed source has a glyph outside ASCII.
+ */
+static bool has_non_ascii(const struct compilation *comp)
 {
-    if (!state->val_encountered && !is_whitespace(tok))
+    for (int i = 0; i < comp->num_segs; i++)
     {
-        state->val_encountered = true;
+        const struct gxt_str_buf *tdat = &comp->segs[i].state.tdat;
+        for (size_t j = 0; j < tdat->len; j++)
+        {
+            if (tdat->data[j] > 0x7F)
+            {
+                return true;
+            }
+        }
     }
 
-    if (state->val_encountered)
-    {
-        //printf("V(%02d:%02d) = %c\n",
-        //       state->src_row, state->src_col, tok);
+    return false;
+}
 
-        gxt_char *c = (gxt_char *) malloc(sizeof(gxt_char));
-        *c = tok;
+/**
+ * Lexes one segment of the source (pool_parallel_for() callback).
+ */
+static void lex_segment_task(void *arg, size_t index)
+{
+    struct compilation *comp = (struct compilation *) arg;
+    struct src_segment *seg = &comp->segs[index];
+    struct compiler_state *state = &seg->state;
 
-        list_append(state->tdat_buf, (void *) c);
+    bool is_final = ((int) index + 1 == comp->num_segs);
 
-        state->tdat_offset += sizeof(gxt_char);
-    }
+    seg->result = comp->use_cache
+        ? lex_cached(seg->data, seg->size, is_final,
+                     comp->old_cache, seg->cache, state)
+        : compile_chunk(seg->data, seg->size, state);
 
-    return COMPILE_SUCCESS;
+    if (seg->result == COMPILE_SUCCESS && (int) index + 1 < comp->num_segs)
+    {
+        /* The next segment starts with a key, which ends this entry */
+        seg->result = end_entry(state);
+    }
+    else
+    {
+        /* Like the final value of the file, an unterminated value is
+           dropped */
+        if (state->key_buf != NULL)
+        {
+            key_array_pop(&state->tkey);
+            state->key_buf = NULL;
+        }
+        state->tdat.len = state->val_start;
+    }
 }
 
-static int process_comment_token(unsigned char tok, struct compiler_state *state)
+/**
+ * Sets up the compiler state for lexing a segment.
+ *
+ * @return true if the state was set up, false if out of memory
+ */
+static bool init_segment_state(struct compilation *comp, int index)
 {
-    if (tok == END_OF_COMMENT && state->is_reading_comment)
-    {
-        //printf("Done reading comment.\n");
-        state->is_reading_key = false;
-        state->is_reading_val = true;
-        state->is_reading_comment = false;
-        state->key_encountered = false;
-        //state->val_encountered = false;
+    struct src_segment *seg = &comp->segs[index];
+    struct compiler_state *state = &seg->state;
 
-        return COMPILE_SUCCESS;
+    /* Segments lexed in parallel are on different threads, so each needs an
+       arena of its own */
+    arena *ar = comp->arena;
+    if (comp->num_segs > 1)
+    {
+        if (!arena_create_with(&seg->arena, arena_allocator(comp->arena)))
+        {
+            return false;
+        }
+        ar = seg->arena;
     }
-    //printf("C(%02d:%02d) = %c\n",
-    //       state->src_row, state->src_col, tok);
 
-    return COMPILE_SUCCESS;
-}
+    gxt_str_buf_init_arena(&state->tdat, ar);
+    key_array_init_arena(&state->tkey, ar);
+    table_start_array_init_arena(&state->tables, ar);
+    seg->diag.arena = ar;
 
-static bool is_whitespace(char c)
-{
-    return c == ' ' || c == '\t';
+    state->src_file = comp->src_file;
+    state->diag = (comp->num_segs > 1) ? &seg->diag : comp->diag;
+    state->charset = comp->charset;
+    state->encoding = comp->encoding;
+    state->tokens = comp->tokens;
+    state->game = comp->game;
+    state->src_text = comp->text;
+
+    if (comp->use_cache)
+    {
+        struct cache_stamp stamp = { 0 };
+        if (!cache_create(&seg->cache, &stamp))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/**
+ * Lexes a segment one entry at a time, taking each entry whose source text is
+ * unchanged since the last build from the cache rather than lexing and
+ * encoding it again.
+ *
+ * An entry's source text runs from its key start ('[' outside of a comment)
+ * up to the next key start. As with splitting a source into segments, a key
+ * start always puts the lexer into the same state, so an entry's encoded
+ * string depends only on its own source text. The last entry of the file is
+ * always lexed, since it is dropped rather than completed.
+ *
+ * @param data      the segment contents
+ * @param size      the size of the segment
+ * @param is_final  whether this is the last segment of the file
+ * @param old_cache the cache from the last build (NULL if there isn't one)
+ * @param new_cache the cache to record every completed entry in
+ * @param state     the compiler state
+ *
+ * @return COMPILE_SUCCESS, or the status of the first error encountered
+ */
+static int lex_cached(const char *data, size_t size, bool is_final,
+                      const entry_cache *old_cache, entry_cache *new_cache,
+                      struct compiler_state *state)
+{
+    /* Anything before the first key is lexed as usual */
+    enum src_encoding enc = state->encoding;
+    bool in_comment = false;
+    size_t cache_pos = 0;
+    size_t start = find_key_start(data, size, 0, enc, &in_comment);
+    int result = compile_chunk(data, start, state);
+
+    while (result == COMPILE_SUCCESS && start < size)
+    {
+        size_t end = find_key_start(data, size,
+                                    start + encoding_unit_size(enc), enc,
+                                    &in_comment);
+        const char *span = data + start;
+        size_t span_len = end - start;
+        bool is_last = is_final && (end == size);
+
+        struct cache_entry entry;
+        entry.hash = hash64(span, span_len, 0);
+        entry.src_len = (uint32_t) span_len;
+        entry.src = span;
+
+        if (!is_last && old_cache != NULL
+            && cache_find(old_cache, entry.hash, span, entry.src_len,
+                          &cache_pos, &entry))
+        {
+            state->tok_pos = span;
+            result = reuse_entry(&entry, state);
+        }
+        else
+        {
+            result = compile_chunk(span, span_len, state);
+            if (result != COMPILE_SUCCESS || is_last)
+            {
+                break;
+            }
+
+            /* Keep the entry for the cache if it made it into TKEY; ending
+               it never moves the keys */
+            const struct key_entry *k = state->key_buf;
+            size_t val_start = state->val_start;
+            size_t num_keys = state->tkey.len;
+
+            result = end_entry(state);
+            if (result != COMPILE_SUCCESS)
+            {
+                break;
+            }
+            else if (k == NULL || state->tkey.len < num_keys)
+            {
+                start = end;
+                continue;
+            }
+
+            memcpy(entry.name, k->key.name, GXT_KEY_MAX_LEN);
+            entry.chars = state->tdat.data + val_start;
+            entry.num_chars = (uint32_t) (state->tdat.len - val_start - 1);
+        }
+
+        if (result == COMPILE_SUCCESS && !cache_add(new_cache, &entry))
+        {
+            result = COMPILE_OUT_OF_MEMORY;
+        }
+
+        start = end;
+    }
+
+    return result;
+}
+
+/**
+ * Adds an entry taken from the cache, just as if it had been lexed.
+ */
+static int reuse_entry(const struct cache_entry *entry,
+                       struct compiler_state *state)
+{
+    /* Complete whatever came before the key */
+    int result = end_entry(state);
+    if (result != COMPILE_SUCCESS)
+    {
+        return result;
+    }
+
+    state->key_buf = key_array_emplace(&state->tkey);
+    if (state->key_buf == NULL
+        || !gxt_str_buf_append(&state->tdat, entry->chars, entry->num_chars))
+    {
+        return COMPILE_OUT_OF_MEMORY;
+    }
+
+    memcpy(state->key_buf->key.name, entry->name, GXT_KEY_MAX_LEN);
+    state->key_buf->src_pos = state->tok_pos - state->src_text;
+    state->val_encountered = true;
+    state->num_keys++;
+
+    return end_entry(state);
+}
+
+/**
+ * Finds the next key start ('[' outside of a comment) at or after a given
+ * position.
+ *
+ * @param data       the source text
+ * @param size       the size of the source text in bytes
+ * @param pos        the position to start searching from
+ * @param enc        the source text encoding
+ * @param in_comment whether pos is inside a comment; updated to match the
+ *                   returned position
+ *
+ * @return the position of the key start, or size if there are no more keys
+ */
+static size_t find_key_start(const char *data, size_t size, size_t pos,
+                             enum src_encoding enc, bool *in_comment)
+{
+    static const char delims[SCAN_NUM_DELIMS] =
+        { START_OF_COMMENT, END_OF_COMMENT, START_OF_KEY, START_OF_KEY };
+
+    while (pos < size)
+    {
+        pos += find_delims(data + pos, size - pos, delims, enc);
+        if (pos >= size)
+        {
+            break;
+        }
+
+        unsigned int c = read_unit(data + pos, enc);
+        if (c == START_OF_COMMENT)
+        {
+            *in_comment = true;
+        }
+        else if (c == END_OF_COMMENT)
+        {
+            *in_comment = false;
+        }
+        else if (!*in_comment)
+        {
+            return pos;
+        }
+
+        pos += encoding_unit_size(enc);
+    }
+
+    return size;
+}
+
+/**
+ * Releases what a compilation holds outside of its arena: the segment caches
+ * and the arenas of segments and tables that were built in parallel.
+ */
+static void free_compilation(struct compilation *comp)
+{
+    for (int i = 0; i < comp->num_segs; i++)
+    {
+        cache_destroy(&comp->segs[i].cache);
+        arena_destroy(&comp->segs[i].arena);
+    }
+
+    for (int i = 0; i < comp->num_tables; i++)
+    {
+        arena_destroy(&comp->tables[i].arena);
+    }
+
+    comp->segs = NULL;
+    comp->num_segs = 0;
+    comp->tables = NULL;
+    comp->num_tables = 0;
+}
+
+/**
+ * Puts every key into the table it was declared in, creating a table for
+ * each name declared. Keys that come before any declaration go in MAIN. A
+ * table that is declared more than once gets the keys that follow each of
+ * its declarations.
+ *
+ * @return COMPILE_SUCCESS, or COMPILE_OUT_OF_MEMORY
+ */
+static int assign_tables(struct compilation *comp)
+{
+    size_t max_tables = 1;
+    size_t num_keys = 0;
+    for (int s = 0; s < comp->num_segs; s++)
+    {
+        max_tables += comp->segs[s].state.tables.len;
+        num_keys += comp->segs[s].state.tkey.len;
+    }
+
+    comp->tables = (struct table *)
+        arena_calloc(comp->arena, max_tables, sizeof(struct table));
+    uint32_t *key_tables = (uint32_t *)
+        arena_alloc(comp->arena, (num_keys + 1) * sizeof(uint32_t));
+    if (comp->tables == NULL || key_tables == NULL)
+    {
+        return COMPILE_OUT_OF_MEMORY;
+    }
+
+    memcpy(comp->tables[0].name, GXT_MAIN_TABLE, sizeof(GXT_MAIN_TABLE) - 1);
+    comp->num_tables = 1;
+
+    /* Work out which table each key goes in, and count each table's keys */
+    struct table *current = &comp->tables[0];
+    size_t k = 0;
+
+    for (int s = 0; s < comp->num_segs; s++)
+    {
+        const struct compiler_state *state = &comp->segs[s].state;
+        size_t next = 0;
+
+        for (size_t i = 0; i <= state->tkey.len; i++)
+        {
+            while (next < state->tables.len
+                   && state->tables.data[next].first_key == i)
+            {
+                current = find_table(comp, state->tables.data[next].name);
+                next++;
+            }
+
+            if (i < state->tkey.len)
+            {
+                key_tables[k++] = (uint32_t) (current - comp->tables);
+                current->num_keys++;
+            }
+        }
+    }
+
+    for (int i = 0; i < comp->num_tables; i++)
+    {
+        struct table *t = &comp->tables[i];
+        t->keys = (struct key_entry **)
+            arena_alloc(comp->arena,
+                        (t->num_keys + 1) * sizeof(struct key_entry *));
+        if (t->keys == NULL)
+        {
+            return COMPILE_OUT_OF_MEMORY;
+        }
+        t->num_keys = 0;
+    }
+
+    k = 0;
+    for (int s = 0; s < comp->num_segs; s++)
+    {
+        ARRAY_FOR_EACH(struct key_entry, key, &comp->segs[s].state.tkey)
+        {
+            struct table *t = &comp->tables[key_tables[k++]];
+            t->keys[t->num_keys++] = key;
+        }
+    }
+
+    return COMPILE_SUCCESS;
+}
+
+/**
+ * Finds a table by name, adding it if there isn't one with that name yet.
+ * There is always room for another table, as there are never more tables
+ * than declarations (plus MAIN).
+ */
+static struct table * find_table(struct compilation *comp,
+                                 const char name[GXT_KEY_MAX_LEN])
+{
+    for (int i = 0; i < comp->num_tables; i++)
+    {
+        if (memcmp(comp->tables[i].name, name, GXT_KEY_MAX_LEN) == 0)
+        {
+            return &comp->tables[i];
+        }
+    }
+
+    struct table *t = &comp->tables[comp->num_tables++];
+    memcpy(t->name, name, GXT_KEY_MAX_LEN);
+
+    return t;
+}
+
+/**
+ * Runs a function for every table, on the pool if there is one, then
+ * reports any problems the tables ran into (see check_tables()).
+ *
+ * @param comp the compilation holding the tables
+ * @param pool the pool to run on (NULL to run on this thread)
+ * @param fn   the function to run for each table index
+ * @param arg  the argument to pass to the function
+ *
+ * @return COMPILE_SUCCESS, or the status of the first table that failed
+ */
+static int run_tables(struct compilation *comp, thread_pool *pool,
+                      pool_index_fn fn, void *arg)
+{
+    if (pool != NULL)
+    {
+        if (!pool_parallel_for(pool, fn, arg, comp->num_tables))
+        {
+            return COMPILE_OUT_OF_MEMORY;
+        }
+    }
+    else
+    {
+        for (int i = 0; i < comp->num_tables; i++)
+        {
+            fn(arg, i);
+        }
+    }
+
+    return check_tables(comp);
+}
+
+/**
+ * Reports the problems found while building the tables, in table order.
+ * Locating a key may build the line index, so this is never done on the
+ * threads that build the tables.
+ *
+ * @return COMPILE_SUCCESS, or the status of the first table that failed
+ */
+static int check_tables(struct compilation *comp)
+{
+    int result = COMPILE_SUCCESS;
+
+    for (int i = 0; i < comp->num_tables; i++)
+    {
+        const struct table *t = &comp->tables[i];
+        if (t->result == COMPILE_DUPLICATE_KEY)
+        {
+            report_duplicates(comp, t);
+        }
+        else if (t->result == COMPILE_KEY_HASH_COLLISION)
+        {
+            report_collisions(comp, t);
+        }
+
+        if (result == COMPILE_SUCCESS)
+        {
+            result = t->result;
+        }
+    }
+
+    return result;
+}
+
+/**
+ * Sorts a table's keys into TKEY order (pool_parallel_for() callback).
+ */
+static void sort_table_task(void *arg, size_t index)
+{
+    struct compilation *comp = (struct compilation *) arg;
+    struct table *t = &comp->tables[index];
+    arena *ar = (t->arena != NULL) ? t->arena : comp->arena;
+
+    t->result = sort_keys(t, ar);
+    if (t->result == COMPILE_SUCCESS && comp->game == GXT_GAME_SA)
+    {
+        t->result = sort_keys_by_hash(t, ar);
+    }
+}
+
+/**
+ * Builds a table's TDAT (pool_parallel_for() callback). A lone table uses
+ * the strings where they were lexed unless they are to be shared; any other
+ * table needs a TDAT of its own.
+ */
+static void build_tdat_task(void *arg, size_t index)
+{
+    struct compilation *comp = (struct compilation *) arg;
+    struct table *t = &comp->tables[index];
+    arena *ar = (t->arena != NULL) ? t->arena : comp->arena;
+
+    if (comp->dedupe)
+    {
+        t->result = share_strings(comp, t, ar);
+    }
+    else if (comp->num_tables > 1)
+    {
+        t->result = gather_strings(comp, t, ar);
+    }
+}
+
+/**
+ * Encodes a table into the output (pool_parallel_for() callback).
+ */
+static void emit_table_task(void *arg, size_t index)
+{
+    const struct emit_job *job = (const struct emit_job *) arg;
+    const struct table *t = &job->comp->tables[index];
+
+    emit_table(job->comp, job->layout, t, job->image);
+}
+
+/**
+ * qsort() comparator that orders tables by name.
+ */
+static int compare_table_names(const void *a, const void *b)
+{
+    const struct table *x = (const struct table *) a;
+    const struct table *y = (const struct table *) b;
+
+    return memcmp(x->name, y->name, GXT_KEY_MAX_LEN);
+}
+
+static void plan_layout(struct compilation *comp, struct gxt_layout *layout)
+{
+    /* Strings are stored in their final TDAT positions while lexing (or
+       while building the tables), so only the block sizes and positions need
+       to be worked out here. */
+    const size_t header_size = sizeof(struct gxt_block_header);
+
+    layout->game = comp->game;
+    layout->char_size = tdat_char_size(comp->game);
+    layout->key_size = (comp->game == GXT_GAME_SA)
+        ? sizeof(struct gxt_key_saiv)
+        : sizeof(struct gxt_key);
+    layout->has_tabl = (comp->game != GXT_GAME_GTA3);
+    layout->num_keys = 0;
+
+    size_t pos = 0;
+    if (comp->game == GXT_GAME_SA)
+    {
+        pos += sizeof(struct gxt_sa_header);
+    }
+    layout->tabl_pos = pos;
+    if (layout->has_tabl)
+    {
+        pos += header_size + comp->num_tables * sizeof(struct gxt_tabl_entry);
+    }
+
+    size_t seg_chars = 0;
+    for (int i = 0; i < comp->num_segs; i++)
+    {
+        seg_chars += comp->segs[i].state.tdat.len;
+    }
+
+    for (int i = 0; i < comp->num_tables; i++)
+    {
+        struct table *t = &comp->tables[i];
+        size_t num_chars = t->has_own_tdat ? t->tdat.len : seg_chars;
+
+        /* Tables other than MAIN start with a copy of their name */
+        t->pos = pos;
+        if (i > 0)
+        {
+            pos += GXT_KEY_MAX_LEN;
+        }
+
+        t->tkey_size = t->num_keys * layout->key_size;
+        t->tdat_size = num_chars * layout->char_size;
+        t->tkey_pos = pos + header_size;
+        t->tdat_pos = t->tkey_pos + t->tkey_size + header_size;
+        pos = t->tdat_pos + t->tdat_size;
+
+        layout->num_keys += t->num_keys;
+    }
+
+    layout->image_size = pos;
+}
+
+/**
+ * Sorts a table's keys into TKEY order and checks for keys that are defined
+ * more than once (which report_duplicates() reports).
+ *
+ * @param t  the table to sort; t->sorted is set to the sorted keys
+ * @param ar the arena to allocate from
+ *
+ * @return COMPILE_SUCCESS if the keys were sorted and are all unique,
+ *         COMPILE_DUPLICATE_KEY if any key is defined more than once,
+ *         COMPILE_OUT_OF_MEMORY if the sort array could not be allocated
+ */
+static int sort_keys(struct table *t, arena *ar)
+{
+    size_t n = t->num_keys;
+
+    /* Allocate room for at least one item so an empty TKEY isn't mistaken
+       for an allocation failure */
+    size_t items_size = (n + 1) * sizeof(struct key_sort_item);
+    struct key_sort_item *items =
+        (struct key_sort_item *) arena_alloc(ar, items_size);
+    struct key_sort_item *tmp =
+        (struct key_sort_item *) arena_alloc(ar, items_size);
+    if (items == NULL || tmp == NULL)
+    {
+        return COMPILE_OUT_OF_MEMORY;
+    }
+
+    for (size_t i = 0; i < n; i++)
+    {
+        items[i].sort_key = gxt_key_order(t->keys[i]->key.name);
+        items[i].entry = t->keys[i];
+    }
+
+    radix_sort(items, tmp, n);
+    arena_free(ar, tmp, items_size);
+    t->sorted = items;
+
+    /* The sort is stable, so the first definition of a duplicated key comes
+       before any redefinition and duplicates are always adjacent. */
+    for (size_t i = 1; i < n; i++)
+    {
+        if (items[i].sort_key == items[i - 1].sort_key)
+        {
+            return COMPILE_DUPLICATE_KEY;
+        }
+    }
+
+    return COMPILE_SUCCESS;
+}
+
+/**
+ * Reports every key of a table sorted by sort_keys() that is defined more
+ * than once.
+ */
+static void report_duplicates(struct compilation *comp, const struct table *t)
+{
+    const struct key_sort_item *items = t->sorted;
+    size_t n = t->num_keys;
+
+    for (size_t i = 1; i < n; i++)
+    {
+        if (items[i].sort_key == items[i - 1].sort_key)
+        {
+            /* Report every redefinition against the first one */
+            const struct key_entry *first = items[i - 1].entry;
+            int first_line, first_col;
+            find_key_line_col(comp, first, &first_line, &first_col);
+
+            for (;;)
+            {
+                const struct key_entry *dup = items[i].entry;
+                int line, col;
+                find_key_line_col(comp, dup, &line, &col);
+                error_f(comp->diag, E_DUPLICATE_KEY, comp->src_file,
+                        line, col, dup->key.name, first_line, first_col);
+
+                if (i + 1 == n || items[i + 1].sort_key != items[i].sort_key)
+                {
+                    break;
+                }
+                i++;
+            }
+        }
+    }
+}
+
+/**
+ * Re-sorts a table's name-sorted keys into GTA SA's TKEY order, by the hash
+ * of their names, and checks that no two names hash to the same value (which
+ * report_collisions() reports). Each record's sort_key is left holding the
+ * hash.
+ *
+ * @param t  the table, sorted by name and free of duplicates
+ * @param ar the arena to allocate from
+ *
+ * @return COMPILE_SUCCESS if all hashes are unique,
+ *         COMPILE_KEY_HASH_COLLISION if any two keys have the same hash,
+ *         COMPILE_OUT_OF_MEMORY if the sort space could not be allocated
+ */
+static int sort_keys_by_hash(struct table *t, arena *ar)
+{
+    struct key_sort_item *items = t->sorted;
+    size_t n = t->num_keys;
+
+    size_t tmp_size = (n + 1) * sizeof(struct key_sort_item);
+    struct key_sort_item *tmp =
+        (struct key_sort_item *) arena_alloc(ar, tmp_size);
+    if (tmp == NULL)
+    {
+        return COMPILE_OUT_OF_MEMORY;
+    }
+
+    for (size_t i = 0; i < n; i++)
+    {
+        items[i].sort_key = gxt_key_hash(items[i].entry->key.name);
+    }
+
+    /* The upper four bytes are all zero, so only four passes are made */
+    radix_sort(items, tmp, n);
+    arena_free(ar, tmp, tmp_size);
+
+    for (size_t i = 1; i < n; i++)
+    {
+        if (items[i].sort_key == items[i - 1].sort_key)
+        {
+            return COMPILE_KEY_HASH_COLLISION;
+        }
+    }
+
+    return COMPILE_SUCCESS;
+}
+
+/**
+ * Reports every pair of keys of a table sorted by sort_keys_by_hash() whose
+ * names have the same hash.
+ */
+static void report_collisions(struct compilation *comp, const struct table *t)
+{
+    const struct key_sort_item *items = t->sorted;
+
+    for (size_t i = 1; i < t->num_keys; i++)
+    {
+        if (items[i].sort_key == items[i - 1].sort_key)
+        {
+            const struct key_entry *first = items[i - 1].entry;
+            const struct key_entry *other = items[i].entry;
+            int first_line, first_col, line, col;
+            find_key_line_col(comp, first, &first_line, &first_col);
+            find_key_line_col(comp, other, &line, &col);
+            error_f(comp->diag, E_KEY_HASH_COLLISION, comp->src_file,
+                    line, col, other->key.name, first->key.name,
+                    (unsigned int) items[i].sort_key, first_line, first_col);
+        }
+    }
+}
+
+/**
+ * Builds a TDAT for a table in which each distinct string is only stored
+ * once, and a string that is the tail end of another (e.g. "CAR" and
+ * "POLICE CAR") is stored inside it. Key offsets are updated to match, and
+ * t->saved is set to the number of TDAT chars saved.
+ *
+ * Equal strings are found by hashing. Tails are then found by sorting the
+ * distinct strings by their reversed contents, which puts each string right
+ * before the strings it is a tail of. Strings are kept in source order of
+ * their first use.
+ *
+ * @param comp the compilation holding the strings
+ * @param t    the table whose strings should be shared
+ * @param ar   the arena to allocate from
+ *
+ * @return COMPILE_SUCCESS, or COMPILE_OUT_OF_MEMORY
+ */
+static int share_strings(const struct compilation *comp, struct table *t,
+                         arena *ar)
+{
+    size_t num_keys = t->num_keys;
+    size_t tdat_len = 0;
+
+    size_t table_cap = 16;
+    while (table_cap < num_keys * 2)
+    {
+        table_cap *= 2;
+    }
+
+    struct key_entry **keys = t->keys;
+    uint32_t *key_strings = (uint32_t *)
+        arena_alloc(ar, (num_keys + 1) * sizeof(uint32_t));
+    struct tdat_string *strs = (struct tdat_string *)
+        arena_alloc(ar, (num_keys + 1) * sizeof(struct tdat_string));
+    struct tdat_string **order = (struct tdat_string **)
+        arena_alloc(ar, (num_keys + 1) * sizeof(struct tdat_string *));
+    uint32_t *table = (uint32_t *) arena_calloc(ar, table_cap, sizeof(uint32_t));
+
+    struct gxt_str_buf shared;
+    gxt_str_buf_init_arena(&shared, ar);
+
+    if (key_strings == NULL || strs == NULL || order == NULL || table == NULL)
+    {
+        return COMPILE_OUT_OF_MEMORY;
+    }
+
+    /* Find the distinct strings, in source order */
+    size_t num_strs = 0;
+    size_t k;
+
+    for (k = 0; k < num_keys; k++)
+    {
+        const gxt_char *chars = segment_string(comp, keys[k]->key.offset);
+        uint32_t len = 1;
+        while (chars[len - 1] != 0)
+        {
+            len++;
+        }
+        tdat_len += len;
+
+        uint64_t hash = hash64(chars, len * sizeof(gxt_char), 0);
+        size_t slot = (size_t) hash & (table_cap - 1);
+        while (table[slot] != 0)
+        {
+            const struct tdat_string *s = &strs[table[slot] - 1];
+            if (s->len == len
+                && memcmp(s->chars, chars, len * sizeof(gxt_char)) == 0)
+            {
+                break;
+            }
+            slot = (slot + 1) & (table_cap - 1);
+        }
+
+        if (table[slot] == 0)
+        {
+            strs[num_strs].chars = chars;
+            strs[num_strs].len = len;
+            strs[num_strs].owner = (uint32_t) num_strs;
+            order[num_strs] = &strs[num_strs];
+            table[slot] = (uint32_t) ++num_strs;
+        }
+
+        key_strings[k] = table[slot] - 1;
+    }
+
+    if (!gxt_str_buf_reserve(&shared, tdat_len))
+    {
+        return COMPILE_OUT_OF_MEMORY;
+    }
+
+    /* Store each string inside the next one in reversed order if it is a
+       tail of that one (and so, in turn, of whatever that one is stored in) */
+    qsort(order, num_strs, sizeof(struct tdat_string *), compare_reversed);
+
+    for (size_t i = num_strs; i-- > 1; )
+    {
+        const struct tdat_string *next = order[i];
+        struct tdat_string *s = order[i - 1];
+        if (s->len <= next->len
+            && memcmp(next->chars + next->len - s->len, s->chars,
+                      s->len * sizeof(gxt_char)) == 0)
+        {
+            s->owner = next->owner;
+        }
+    }
+
+    /* Lay out the strings that aren't stored in another one */
+    for (size_t i = 0; i < num_strs; i++)
+    {
+        if (strs[i].owner == i)
+        {
+            strs[i].pos = (uint32_t) shared.len;
+            gxt_str_buf_append(&shared, strs[i].chars, strs[i].len);
+        }
+    }
+
+    for (k = 0; k < num_keys; k++)
+    {
+        const struct tdat_string *s = &strs[key_strings[k]];
+        const struct tdat_string *owner = &strs[s->owner];
+        keys[k]->key.offset = (uint32_t)
+            ((owner->pos + owner->len - s->len) * sizeof(gxt_char));
+    }
+
+    t->saved = tdat_len - shared.len;
+    t->tdat = shared;
+    t->has_own_tdat = true;
+
+    return COMPILE_SUCCESS;
+}
+
+/**
+ * Builds a TDAT for a table by copying its keys' strings, in source order,
+ * and updates the key offsets to match.
+ *
+ * @return COMPILE_SUCCESS, or COMPILE_OUT_OF_MEMORY
+ */
+static int gather_strings(const struct compilation *comp, struct table *t,
+                          arena *ar)
+{
+    gxt_str_buf_init_arena(&t->tdat, ar);
+
+    for (size_t i = 0; i < t->num_keys; i++)
+    {
+        struct key_entry *k = t->keys[i];
+        const gxt_char *chars = segment_string(comp, k->key.offset);
+        size_t len = gxt_strlen(chars) + 1;
+
+        k->key.offset = (uint32_t) (t->tdat.len * sizeof(gxt_char));
+        if (!gxt_str_buf_append(&t->tdat, chars, len))
+        {
+            return COMPILE_OUT_OF_MEMORY;
+        }
+    }
+
+    t->has_own_tdat = true;
+
+    return COMPILE_SUCCESS;
+}
+
+/**
+ * Finds the string at an offset in the segments' TDATs, which together make
+ * up the TDAT of the whole source.
+ */
+static const gxt_char * segment_string(const struct compilation *comp,
+                                       uint32_t offset)
+{
+    /* Find the last segment whose TDAT starts at or before the offset; any
+       empty segment starting there comes before the one holding the
+       string */
+    int lo = 0;
+    int hi = comp->num_segs - 1;
+    while (lo < hi)
+    {
+        int mid = lo + (hi - lo + 1) / 2;
+        if (comp->segs[mid].tdat_base <= offset)
+        {
+            lo = mid;
+        }
+        else
+        {
+            hi = mid - 1;
+        }
+    }
+
+    const struct src_segment *seg = &comp->segs[lo];
+
+    return seg->state.tdat.data
+        + (offset - seg->tdat_base) / sizeof(gxt_char);
+}
+
+/**
+ * qsort() comparator that orders strings by their reversed contents.
+ */
+static int compare_reversed(const void *a, const void *b)
+{
+    const struct tdat_string *x = *(const struct tdat_string * const *) a;
+    const struct tdat_string *y = *(const struct tdat_string * const *) b;
+
+    uint32_t n = MIN(x->len, y->len);
+
+    for (uint32_t i = 1; i <= n; i++)
+    {
+        gxt_char cx = x->chars[x->len - i];
+        gxt_char cy = y->chars[y->len - i];
+        if (cx != cy)
+        {
+            return (cx < cy) ? -1 : 1;
+        }
+    }
+
+    return (x->len < y->len) ? -1 : (x->len > y->len);
+}
+
+/**
+ * Sorts key records by their 64-bit sort key using an LSD radix sort, one byte
+ * per pass. Passes in which every record has the same byte value are skipped,
+ * which drops most of the passes for short key names. The sort is stable.
+ *
+ * @param items the records to sort
+ * @param tmp   scratch space for at least n records
+ * @param n     the number of records
+ */
+static void radix_sort(struct key_sort_item *items, struct key_sort_item *tmp,
+                       size_t n)
+{
+    if (n < 2)
+    {
+        return;
+    }
+
+    /* Build histograms for all bytes in a single pass */
+    size_t counts[8][256] = { { 0 } };
+    for (size_t i = 0; i < n; i++)
+    {
+        uint64_t k = items[i].sort_key;
+        for (int b = 0; b < 8; b++)
+        {
+            counts[b][(k >> (b * 8)) & 0xFF]++;
+        }
+    }
+
+    struct key_sort_item *src = items;
+    struct key_sort_item *dst = tmp;
+
+    for (int b = 0; b < 8; b++)
+    {
+        int shift = b * 8;
+        if (counts[b][(src[0].sort_key >> shift) & 0xFF] == n)
+        {
+            continue;
+        }
+
+        size_t pos[256];
+        size_t sum = 0;
+        for (int v = 0; v < 256; v++)
+        {
+            pos[v] = sum;
+            sum += counts[b][v];
+        }
+
+        for (size_t i = 0; i < n; i++)
+        {
+            dst[pos[(src[i].sort_key >> shift) & 0xFF]++] = src[i];
+        }
+
+        struct key_sort_item *swap = src;
+        src = dst;
+        dst = swap;
+    }
+
+    if (src != items)
+    {
+        memcpy(items, src, n * sizeof(struct key_sort_item));
+    }
+}
+
+/**
+ * Writes the parts of the output that come before the tables: GTA SA's
+ * version header and the TABL block.
+ */
+static void emit_header(const struct compilation *comp,
+                        const struct gxt_layout *layout, char *image)
+{
+    if (layout->game == GXT_GAME_SA)
+    {
+        write_sa_header(image);
+    }
+
+    if (!layout->has_tabl)
+    {
+        return;
+    }
+
+    char *dest = image + layout->tabl_pos;
+    write_block_header(dest, "TABL",
+                       comp->num_tables * sizeof(struct gxt_tabl_entry));
+    dest += sizeof(struct gxt_block_header);
+
+    for (int i = 0; i < comp->num_tables; i++)
+    {
+        struct gxt_tabl_entry entry;
+        memcpy(entry.name, comp->tables[i].name, GXT_KEY_MAX_LEN);
+        entry.offset = (uint32_t) comp->tables[i].pos;
+
+        memcpy(dest, &entry, sizeof(struct gxt_tabl_entry));
+        dest += sizeof(struct gxt_tabl_entry);
+    }
+}
+
+/**
+ * Writes a table's name copy (for tables other than MAIN), TKEY and TDAT.
+ * Tables don't overlap in the output, so they can be written at the same
+ * time.
+ */
+static void emit_table(const struct compilation *comp,
+                       const struct gxt_layout *layout,
+                       const struct table *t, char *image)
+{
+    if (t != comp->tables)
+    {
+        memcpy(image + t->pos, t->name, GXT_KEY_MAX_LEN);
+    }
+
+    write_block_header(image + t->tkey_pos - sizeof(struct gxt_block_header),
+                       "TKEY", t->tkey_size);
+    write_block_header(image + t->tdat_pos - sizeof(struct gxt_block_header),
+                       "TDAT", t->tdat_size);
+
+    const struct key_sort_item *sorted = t->sorted;
+    char *tkey = image + t->tkey_pos;
+    char *tdat = image + t->tdat_pos;
+
+    if (layout->game == GXT_GAME_SA)
+    {
+        /* Offsets are in bytes of the narrower TDAT, and the names are
+           replaced by the hashes sort_keys_by_hash() left in sort_key */
+        for (size_t i = 0; i < t->num_keys; i++)
+        {
+            struct gxt_key_saiv key;
+            key.offset = (uint32_t) (sorted[i].entry->key.offset
+                / sizeof(gxt_char) * layout->char_size);
+            key.name_crc = (uint32_t) sorted[i].sort_key;
+
+            memcpy(tkey, &key, sizeof(struct gxt_key_saiv));
+            tkey += sizeof(struct gxt_key_saiv);
+        }
+    }
+    else
+    {
+        for (size_t i = 0; i < t->num_keys; i++)
+        {
+            memcpy(tkey, &sorted[i].entry->key, sizeof(struct gxt_key));
+            tkey += sizeof(struct gxt_key);
+        }
+    }
+
+    if (t->has_own_tdat)
+    {
+        copy_tdat(tdat, t->tdat.data, t->tdat.len, layout->char_size);
+        return;
+    }
+
+    /* Segments' TDATs are laid end to end in source order */
+    for (int i = 0; i < comp->num_segs; i++)
+    {
+        const struct gxt_str_buf *buf = &comp->segs[i].state.tdat;
+        copy_tdat(tdat, buf->data, buf->len, layout->char_size);
+        tdat += buf->len * layout->char_size;
+    }
+}
+
+static void write_block_header(char *dest, const char *sig, size_t size)
+{
+    struct gxt_block_header header;
+    memcpy(header.sig, sig, sizeof(header.sig));
+    header.size = (uint32_t) size;
+
+    memcpy(dest, &header, sizeof(struct gxt_block_header));
+}
+
+/**
+ * Gets the size of a TDAT char in a game's GXT files.
+ */
+static size_t tdat_char_size(enum gxt_game game)
+{
+    return (game == GXT_GAME_SA) ? GXT_SA_CHAR_BITS / 8 : sizeof(gxt_char);
+}
+
+/**
+ * Writes the GTA SA version header.
+ */
+static void write_sa_header(char *dest)
+{
+    struct gxt_sa_header header;
+    header.version = GXT_SA_VERSION;
+    header.char_bits = GXT_SA_CHAR_BITS;
+    memcpy(dest, &header, sizeof(struct gxt_sa_header));
+}
+
+/**
+ * Copies TDAT chars into the output, narrowing them if the file uses smaller
+ * chars. The charset never produces glyph codes that don't fit.
+ */
+static void copy_tdat(char *dest, const gxt_char *chars, size_t n,
+                      size_t char_size)
+{
+    if (n == 0)
+    {
+        return;
+    }
+
+    if (char_size == sizeof(gxt_char))
+    {
+        memcpy(dest, chars, n * sizeof(gxt_char));
+        return;
+    }
+
+    unsigned char *out = (unsigned char *) dest;
+    for (size_t i = 0; i < n; i++)
+    {
+        out[i] = (unsigned char) chars[i];
+    }
+}
+
+/**
+ * Hashes every setting that affects how entries are encoded or how the output
+ * file is laid out, so that a cache built with different settings is never
+ * used.
+ */
+static uint64_t options_fingerprint(const struct compile_options *opts,
+                                    const struct charset *cs,
+                                    const struct token_set *tokens,
+                                    enum src_encoding enc)
+{
+    uint64_t tokens_fingerprint = (tokens != NULL) ? tokens->fingerprint : 0;
+    const uint32_t settings[] =
+    {
+        opts->dedupe,
+        (uint32_t) opts->game,
+        (uint32_t) enc,
+        (uint32_t) cs->fingerprint,
+        (uint32_t) (cs->fingerprint >> 32),
+        (uint32_t) tokens_fingerprint,
+        (uint32_t) (tokens_fingerprint >> 32),
+        GXTMAKER_VERSION_MAJOR,
+        GXTMAKER_VERSION_MINOR,
+        GXTMAKER_VERSION_PATCH,
+        (uint32_t) sizeof(gxt_char),
+        (uint32_t) sizeof(struct gxt_key)
+    };
+
+    return hash64(settings, sizeof(settings), 0);
+}
+
+/**
+ * Checks whether the output of the last build is still current, i.e. the
+ * settings and source are the same as last time and the output has not been
+ * touched since it was written.
+ */
+static bool is_up_to_date(const struct cache_stamp *last,
+                          const struct cache_stamp *stamp,
+                          const char *out_file)
+{
+    uint64_t out_size;
+    int64_t out_mtime;
+
+    return last->fingerprint == stamp->fingerprint
+        && last->src_hash == stamp->src_hash
+        && last->src_size == stamp->src_size
+        && stat_file(out_file, &out_size, &out_mtime)
+        && last->out_size == out_size
+        && last->out_mtime == out_mtime;
+}
+
+/**
+ * Records the freshly written output in the cache and saves it. The cache only
+ * speeds up later builds, so failing to save it is not an error.
+ */
+static void save_cache(entry_cache *cache, const char *cache_path,
+                       const char *out_file)
+{
+    struct cache_stamp stamp = *cache_get_stamp(cache);
+    if (!stat_file(out_file, &stamp.out_size, &stamp.out_mtime))
+    {
+        return;
+    }
+
+    cache_set_stamp(cache, &stamp);
+    cache_save(cache, cache_path);
+}
+
+/**
+ * Builds the cache path for an output file.
+ *
+ * @return the cache path (allocated from ar),
+ *         or NULL if memory could not be allocated
+ */
+static char * make_cache_path(const char *out_file, arena *ar)
+{
+    size_t len = strlen(out_file);
+    char *path = (char *) arena_alloc(ar, len + strlen(CACHE_FILE_EXT) + 1);
+    if (path == NULL)
+    {
+        return NULL;
+    }
+
+    memcpy(path, out_file, len);
+    strcpy(path + len, CACHE_FILE_EXT);
+
+    return path;
+}
+
+static int compile_chunk(const char *chunk, size_t chunk_size,
+                         struct compiler_state *state)
+{
+    int result = 0;
+    size_t width = encoding_unit_size(state->encoding);
+    size_t i = 0;
+
+    while (i < chunk_size)
+    {
+        unsigned int tok = read_unit(chunk + i, state->encoding);
+
+        /* The first char of a value starts a run, so that a multi-unit char
+           is never split */
+        if (state->is_reading_val && !state->val_encountered
+            && starts_value(tok))
+        {
+            state->val_encountered = true;
+        }
+
+        /* Skip ahead over units that can't change the processing mode */
+        size_t run = scan_plain_run(chunk + i, chunk_size - i, state);
+        if (run > 0)
+        {
+            if (state->is_reading_val && state->val_encountered)
+            {
+                result = encode_value_run(chunk + i, run, state);
+                if (result != COMPILE_SUCCESS)
+                {
+                    break;
+                }
+            }
+
+            i += run;
+            continue;
+        }
+
+        state->tok_pos = chunk + i;
+        result = process_token(tok, state);
+        if (result != 0)
+        {
+            break;
+        }
+
+        i += width;
+    }
+
+    return result;
+}
+
+/**
+ * Encodes a run of value text with the charset and appends it to TDAT.
+ *
+ * @param text  the value text
+ * @param len   the length of the text in bytes
+ * @param state the compiler state
+ *
+ * @return COMPILE_SUCCESS if the run was encoded,
+ *         COMPILE_UNENCODABLE_CHAR if it contains a character that can't be
+ *         encoded (which is reported),
+ *         COMPILE_OUT_OF_MEMORY if TDAT could not be grown
+ */
+static int encode_value_run(const char *text, size_t len,
+                            struct compiler_state *state)
+{
+    struct gxt_str_buf *tdat = &state->tdat;
+    if (!gxt_str_buf_reserve(tdat, len))
+    {
+        return COMPILE_OUT_OF_MEMORY;
+    }
+
+    size_t num_chars;
+    long bad_char;
+    size_t done = charset_encode(state->charset, state->encoding, text, len,
+                                 tdat->data + tdat->len, &num_chars,
+                                 &bad_char);
+    tdat->len += num_chars;
+
+    if (done == len)
+    {
+        return (state->tokens != NULL) ? check_tokens(text, len, state)
+                                       : COMPILE_SUCCESS;
+    }
+
+    int line, col;
+    find_line_col(state->src_text, text + done, state->encoding, &line, &col);
+    if (bad_char < 0)
+    {
+        error_f(state->diag, E_MALFORMED_TEXT, state->src_file, line, col);
+    }
+    else
+    {
+        error_f(state->diag, E_UNENCODABLE_CHAR, state->src_file, line, col,
+                bad_char, state->charset->name);
+    }
+
+    return COMPILE_UNENCODABLE_CHAR;
+}
+
+/**
+ * Checks the formatting tokens in a run of value text against the game's
+ * token set. A line break or comment can split a token across runs, so the
+ * token being read is kept in the compiler state until its closing '~'.
+ *
+ * @return COMPILE_SUCCESS if every token so far is valid,
+ *         COMPILE_INVALID_TOKEN if not (which is reported)
+ */
+static int check_tokens(const char *text, size_t len,
+                        struct compiler_state *state)
+{
+    enum src_encoding enc = state->encoding;
+    size_t width = encoding_unit_size(enc);
+    size_t i = 0;
+
+    while (i < len)
+    {
+        if (!state->is_reading_token)
+        {
+            /* A key binding token is followed straight away by a control
+               name; anywhere else, skip ahead to the next token */
+            if (state->is_expecting_control)
+            {
+                if (read_unit(text + i, enc) != TOKEN_SPECIFIER)
+                {
+                    return report_token(E_MISSING_CONTROL, state->token,
+                                        state);
+                }
+            }
+            else
+            {
+                i += find_token(text + i, len - i, enc);
+                if (i == len)
+                {
+                    break;
+                }
+            }
+
+            state->is_reading_token = true;
+            state->token_pos = text + i;
+            state->token_len = 0;
+            i += width;
+            continue;
+        }
+
+        unsigned int c = read_unit(text + i, enc);
+        if (c == TOKEN_SPECIFIER)
+        {
+            int result = end_token(state);
+            if (result != COMPILE_SUCCESS)
+            {
+                return result;
+            }
+        }
+        else if (c < 0x20 || c > 0x7E || state->token_len == TOKEN_MAX_LEN)
+        {
+            /* No token looks like this; the '~' is most likely a stray */
+            state->token[state->token_len] = '\0';
+            return report_token(E_UNTERMINATED_TOKEN, state->token, state);
+        }
+        else
+        {
+            state->token[state->token_len++] = (char) c;
+        }
+
+        i += width;
+    }
+
+    return COMPILE_SUCCESS;
+}
+
+/**
+ * Finds the next '~' in a buffer.
+ *
+ * Most runs of value text are a line or less and hold no token at all, so
+ * for 8-bit text this uses memchr(), which handles short buffers with
+ * less overhead than find_delims().
+ *
+ * @return the position of the '~' in bytes, or len if there isn't one
+ */
+static size_t find_token(const char *buf, size_t len, enum src_encoding enc)
+{
+    static const char token_delims[SCAN_NUM_DELIMS] =
+        { TOKEN_SPECIFIER, TOKEN_SPECIFIER, TOKEN_SPECIFIER, TOKEN_SPECIFIER };
+
+    if (encoding_unit_size(enc) == 1)
+    {
+        const char *p = (const char *) memchr(buf, TOKEN_SPECIFIER, len);
+        return (p != NULL) ? (size_t) (p - buf) : len;
+    }
+
+    return find_delims(buf, len, token_delims, enc);
+}
+
+/**
+ * Looks up the token that has just been read, checking that it is one the
+ * game knows and that it is used where it is allowed.
+ *
+ * @return COMPILE_SUCCESS if the token is valid,
+ *         COMPILE_INVALID_TOKEN if not (which is reported)
+ */
+static int end_token(struct compiler_state *state)
+{
+    state->token[state->token_len] = '\0';
+    state->is_reading_token = false;
+
+    const struct token_def *def = token_find(state->tokens, state->token,
+                                             state->token_len);
+    if (state->is_expecting_control)
+    {
+        state->is_expecting_control = false;
+        if (def == NULL || def->kind != TOKEN_CONTROL)
+        {
+            return report_token(E_UNKNOWN_CONTROL, state->token, state);
+        }
+    }
+    else if (def == NULL)
+    {
+        return report_token(E_UNKNOWN_TOKEN, state->token, state);
+    }
+    else if (def->kind == TOKEN_CONTROL)
+    {
+        return report_token(E_UNBOUND_CONTROL, state->token, state);
+    }
+    else if (def->kind == TOKEN_KEY)
+    {
+        state->is_expecting_control = true;
+    }
+
+    return COMPILE_SUCCESS;
+}
+
+/**
+ * Reports a problem with the formatting token that starts at token_pos.
+ *
+ * @param e_id  the ID of the error (see err_ids enum)
+ * @param name  the token name to put in the message
+ * @param state the compiler state
+ *
+ * @return COMPILE_INVALID_TOKEN
+ */
+static int report_token(int e_id, const char *name,
+                        const struct compiler_state *state)
+{
+    int line, col;
+    find_line_col(state->src_text, state->token_pos, state->encoding,
+                  &line, &col);
+    error_f(state->diag, e_id, state->src_file, line, col, name);
+
+    return COMPILE_INVALID_TOKEN;
+}
+
+/**
+ * Gets the number of bytes at the start of a buffer that can be consumed in
+ * bulk in the current processing mode, i.e. that contain nothing that would
+ * switch modes or be left out of a value. Value text found this way is
+ * encoded into TDAT; anything else found this way is ignored.
+ */
+static size_t scan_plain_run(const char *buf, size_t len,
+                             const struct compiler_state *state)
+{
+    static const char value_delims[SCAN_NUM_DELIMS] =
+        { START_OF_KEY, START_OF_COMMENT, '\n', '\r' };
+    static const char comment_delims[SCAN_NUM_DELIMS] =
+        { END_OF_COMMENT, END_OF_COMMENT, END_OF_COMMENT, END_OF_COMMENT };
+    static const char idle_delims[SCAN_NUM_DELIMS] =
+        { START_OF_KEY, START_OF_COMMENT, START_OF_KEY, START_OF_COMMENT };
+
+    if (state->is_reading_key)
+    {
+        /* Keys are short; read them one char at a time */
+        return 0;
+    }
+    else if (state->is_reading_val)
+    {
+        /* Leading whitespace is handled one char at a time */
+        return state->val_encountered
+            ? find_delims(buf, len, value_delims, state->encoding)
+            : 0;
+    }
+    else if (state->is_reading_comment)
+    {
+        return find_delims(buf, len, comment_delims, state->encoding);
+    }
+
+    return find_delims(buf, len, idle_delims, state->encoding);
+}
+
+static int process_token(unsigned int tok, struct compiler_state *state)
+{
+    /* Check whether compiler needs to switch processing mode */
+    switch (tok)
+    {
+        /* Only act on LF characters, ignore pesky Windows CR characters */
+        /* TODO: Check line-ending compliance with current input file
+           encoding */
+        case '\n':
+            /* TODO: insert space if reading GXT string? */
+
+        case '\r':
+            return COMPILE_SUCCESS;
+
+        case START_OF_KEY:
+            if (state->is_reading_comment)
+            {
+                break;
+            }
+
+            int result = end_entry(state);
+            if (result != COMPILE_SUCCESS)
+            {
+                return result;
+            }
+
+            state->key_buf = key_array_emplace(&state->tkey);
+            if (state->key_buf == NULL)
+            {
+                return COMPILE_OUT_OF_MEMORY;
+            }
+            state->key_buf->src_pos = state->tok_pos - state->src_text;
+
+            state->is_reading_key = true;
+            state->is_reading_val = false;
+            state->is_reading_comment = false;
+            state->key_encountered = true;
+            state->val_encountered = false;
+            state->is_reading_table = false;
+            state->current_key_chars_read = 0;
+            return COMPILE_SUCCESS;
+
+        case START_OF_COMMENT:
+            state->is_reading_key = false;
+            state->is_reading_val = false;
+            state->is_reading_comment = true;
+            //state->key_encountered = true;
+            return COMPILE_SUCCESS;
+    }
+
+    /* Value text is encoded a run at a time by compile_chunk(); only the
+       whitespace before a value gets here as a token, and it is skipped */
+    if (state->is_reading_key)
+    {
+        return process_key_token(tok, state);
+    }
+    else if (state->is_reading_comment)
+    {
+        return process_comment_token(tok, state);
+    }
+
+    return COMPILE_SUCCESS;
+}
+
+/**
+ * Completes the entry currently being read, adding it to TKEY if it has both
+ * a key and a value and dropping it otherwise.
+ *
+ * @return COMPILE_SUCCESS if the entry was completed,
+ *         COMPILE_INVALID_TOKEN if its value ends partway through a
+ *         formatting token (which is reported)
+ */
+static int end_entry(struct compiler_state *state)
+{
+    /* A token can't carry on into the next value */
+    int result = COMPILE_SUCCESS;
+    if (state->is_reading_token)
+    {
+        state->token[state->token_len] = '\0';
+        result = report_token(E_UNTERMINATED_TOKEN, state->token, state);
+    }
+    else if (state->is_expecting_control)
+    {
+        result = report_token(E_MISSING_CONTROL, state->token, state);
+    }
+    state->is_reading_token = false;
+    state->is_expecting_control = false;
+
+    if (state->key_buf != NULL && state->val_encountered)
+    {
+        /* Terminate string; it is already in place in TDAT, and the key is
+           already in place in TKEY */
+        gxt_str_buf_push(&state->tdat, 0);
+        state->key_buf->key.offset =
+            (uint32_t) (state->val_start * sizeof(gxt_char));
+    }
+    else
+    {
+        /* Key has no value (or value has no key); drop it */
+        if (state->key_buf != NULL)
+        {
+            key_array_pop(&state->tkey);
+        }
+        state->tdat.len = state->val_start;
+    }
+
+    state->key_buf = NULL;
+    state->val_start = state->tdat.len;
+
+    return result;
+}
+
+static int process_key_token(unsigned int tok, struct compiler_state *state)
+{
+    if (tok == END_OF_KEY && state->is_reading_table)
+    {
+        return end_table(state);
+    }
+    else if (tok == TABLE_SPECIFIER && state->current_key_chars_read == 0
+             && !state->is_reading_table)
+    {
+        if (state->game == GXT_GAME_GTA3)
+        {
+            int line, col;
+            find_line_col(state->src_text, state->tok_pos, state->encoding,
+                          &line, &col);
+            error_f(state->diag, E_TABLES_UNSUPPORTED, state->src_file,
+                    line, col, gxt_game_name(state->game));
+
+            return COMPILE_INVALID_TABLE;
+        }
+
+        state->is_reading_table = true;
+        return COMPILE_SUCCESS;
+    }
+    else if (tok == END_OF_KEY && state->is_reading_key
+             && !state->is_reading_comment)
+    {
+        //printf("Done reading key.\n");
+        state->is_reading_key = false;
+        state->is_reading_val = true;
+        state->is_reading_comment = false;
+        state->key_encountered = false;
+        state->val_encountered = false;
+        state->num_keys++;
+
+        return COMPILE_SUCCESS;
+    }
+
+    state->key_buf->key.name[state->current_key_chars_read] = (char) tok;
+    state->current_key_chars_read++;
+    if (state->current_key_chars_read >= GXT_KEY_MAX_LEN)
+    {
+        int line, col;
+        find_line_col(state->src_text, state->tok_pos, state->encoding,
+                      &line, &col);
+        error_f(state->diag, E_GXT_KEY_TOO_LONG, state->src_file, line, col,
+                GXT_KEY_MAX_LEN - 1);
+
+        return COMPILE_GXT_KEY_TOO_LONG;
+    }
+
+    return COMPILE_SUCCESS;
+}
+
+/**
+ * Finishes a table declaration ("[@NAME]"). The keys that follow go in the
+ * named table, up to the next declaration. Nothing else is read until then.
+ *
+ * @return COMPILE_SUCCESS, COMPILE_INVALID_TABLE if the table has no name
+ *         (which is reported), or COMPILE_OUT_OF_MEMORY
+ */
+static int end_table(struct compiler_state *state)
+{
+    if (state->current_key_chars_read == 0)
+    {
+        int line, col;
+        find_line_col(state->src_text, state->tok_pos, state->encoding,
+                      &line, &col);
+        error_f(state->diag, E_MISSING_TABLE_NAME, state->src_file,
+                line, col);
+
+        return COMPILE_INVALID_TABLE;
+    }
+
+    struct table_start *t = table_start_array_emplace(&state->tables);
+    if (t == NULL)
+    {
+        return COMPILE_OUT_OF_MEMORY;
+    }
+    memcpy(t->name, state->key_buf->key.name, GXT_KEY_MAX_LEN);
+
+    /* The declaration was read as a key, which is dropped */
+    key_array_pop(&state->tkey);
+    t->first_key = state->tkey.len;
+
+    state->key_buf = NULL;
+    state->is_reading_key = false;
+    state->is_reading_table = false;
+    state->key_encountered = false;
+
+    return COMPILE_SUCCESS;
+}
+
+static int process_comment_token(unsigned int tok, struct compiler_state *state)
+{
+    if (tok == END_OF_COMMENT && state->is_reading_comment)
+    {
+        //printf("Done reading comment.\n");
+        state->is_reading_key = false;
+        state->is_reading_val = true;
+        state->is_reading_comment = false;
+        state->key_encountered = false;
+        //state->val_encountered = false;
+
+        return COMPILE_SUCCESS;
+    }
+
+    return COMPILE_SUCCESS;
+}
+
+/**
+ * Finds the first delimiter in a buffer of source text (see scan_delims()).
+ * UTF-16 text is searched a whole unit at a time.
+ *
+ * @return the offset of the first delimiter in bytes, or len if there is none
+ */
+static size_t find_delims(const char *buf, size_t len,
+                          const char delims[SCAN_NUM_DELIMS],
+                          enum src_encoding enc)
+{
+    if (encoding_unit_size(enc) == 1)
+    {
+        return scan_delims(buf, len, delims);
+    }
+
+    uint16_t units[SCAN_NUM_DELIMS];
+    for (int i = 0; i < SCAN_NUM_DELIMS; i++)
+    {
+        units[i] = stored_unit(delims[i], enc);
+    }
+
+    size_t pos = scan_delims16(buf, len / 2, units);
+
+    return (pos == len / 2) ? len : pos * 2;
+}
+
+/**
+ * Counts the line feeds in a buffer of source text.
+ */
+static size_t count_lines(const char *buf, size_t len, enum src_encoding enc)
+{
+    if (encoding_unit_size(enc) == 1)
+    {
+        return scan_count(buf, len, '\n');
+    }
+
+    return scan_count16(buf, len / 2, stored_unit('\n', enc));
+}
+
+/**
+ * Works out the line and column number of a position in the source text by
+ * counting the line feeds before it. Lines are numbered from 1, as are
+ * columns, which are counted in code units.
+ *
+ * @param text the start of the source text
+ * @param pos  the position
+ * @param enc  the source text encoding
+ * @param line a pointer to where the line number should be stored
+ * @param col  a pointer to where the column number should be stored
+ */
+static void find_line_col(const char *text, const char *pos,
+                          enum src_encoding enc, int *line, int *col)
+{
+    size_t width = encoding_unit_size(enc);
+
+    const char *line_start = pos;
+    while (line_start > text && read_unit(line_start - width, enc) != '\n')
+    {
+        line_start -= width;
+    }
+
+    *line = (int) count_lines(text, line_start - text, enc) + 1;
+    *col = (int) ((pos - line_start) / width) + 1;
+}
+
+/**
+ * Works out the line and column number of a key (see find_line_col()),
+ * looking its position up in the line index so that reporting many keys
+ * doesn't mean counting through the source again for each one.
+ */
+static void find_key_line_col(struct compilation *comp,
+                              const struct key_entry *k, int *line, int *col)
+{
+    const struct line_index *lines = &comp->lines;
+    if (!lines->is_built && !build_line_index(comp))
+    {
+        find_line_col(comp->text, comp->text + k->src_pos, comp->encoding,
+                      line, col);
+        return;
+    }
+
+    /* Find how many lines end before the key */
+    size_t lo = 0;
+    size_t hi = lines->num_ends;
+    while (lo < hi)
+    {
+        size_t mid = lo + (hi - lo) / 2;
+        if (lines->ends[mid] < k->src_pos)
+        {
+            lo = mid + 1;
+        }
+        else
+        {
+            hi = mid;
+        }
+    }
+
+    size_t width = encoding_unit_size(comp->encoding);
+    size_t line_start = (lo > 0) ? lines->ends[lo - 1] + width : 0;
+
+    *line = (int) lo + 1;
+    *col = (int) ((k->src_pos - line_start) / width) + 1;
+}
+
+/**
+ * Builds the line index of the source text, counting the lines first so
+ * that it can be allocated in one go.
+ *
+ * @return true if the index was built, false if out of memory
+ */
+static bool build_line_index(struct compilation *comp)
+{
+    static const char newline_delims[SCAN_NUM_DELIMS] =
+        { '\n', '\n', '\n', '\n' };
+
+    struct line_index *lines = &comp->lines;
+    enum src_encoding enc = comp->encoding;
+    size_t width = encoding_unit_size(enc);
+
+    size_t num_ends = count_lines(comp->text, comp->text_size, enc);
+    lines->ends = (size_t *) arena_alloc(comp->arena,
+                                         num_ends * sizeof(size_t));
+    if (lines->ends == NULL)
+    {
+        return false;
+    }
+
+    size_t pos = 0;
+    for (size_t i = 0; i < num_ends; i++)
+    {
+        pos += find_delims(comp->text + pos, comp->text_size - pos,
+                           newline_delims, enc);
+        lines->ends[i] = pos;
+        pos += width;
+    }
+
+    lines->num_ends = num_ends;
+    lines->is_built = true;
+
+    return true;
+}
+
+/**
+ * Reads one code unit of source text.
+ */
+static unsigned int read_unit(const char *p, enum src_encoding enc)
+{
+    const unsigned char *b = (const unsigned char *) p;
+
+    switch (enc)
+    {
+        case SRC_ENCODING_UTF16LE:
+            return b[0] | (b[1] << 8);
+        case SRC_ENCODING_UTF16BE:
+            return (b[0] << 8) | b[1];
+        default:
+            return b[0];
+    }
+}
+
+/**
+ * Gets the 16-bit unit an ASCII char is stored as in UTF-16 source text, as
+ * it would be loaded from memory on this machine.
+ */
+static uint16_t stored_unit(char c, enum src_encoding enc)
+{
+    unsigned char bytes[2] = { 0, 0 };
+    bytes[(enc == SRC_ENCODING_UTF16BE) ? 1 : 0] = (unsigned char) c;
+
+    uint16_t unit;
+    memcpy(&unit, bytes, sizeof(unit));
+
+    return unit;
+}
+
+static bool is_whitespace(unsigned int c)
+{
+    return c == ' ' || c == '\t';
+}
+
+/**
+ * Checks whether a char is the first char of a value, i.e. it is neither
+ * leading whitespace nor something that switches modes.
+ */
+static bool starts_value(unsigned int c)
+{
+    return !is_whitespace(c) && c != START_OF_KEY && c != START_OF_COMMENT
+        && c != '\n' && c != '\r';
 }
@@ -7,21 +7,125 @@
 #ifndef _GXTMAKER_COMPILER_H_
 #define _GXTMAKER_COMPILER_H_
 
+#include <stdbool.h>
+
+#include "arena.h"
+#include "charset.h"
+#include "errwarn.h"
+#include "gxt.h"
+#include "mem.h"
+#include "stats.h"
+
 enum compiler_status
 {
     COMPILE_SUCCESS             = 0x00,
     COMPILE_FILE_UNREADABLE     = 0x80,
-    COMPILE_GXT_KEY_TOO_LONG    = 0x81
+    COMPILE_GXT_KEY_TOO_LONG    = 0x81,
+    COMPILE_OUT_OF_MEMORY       = 0x82,
+    COMPILE_DUPLICATE_KEY       = 0x83,
+    COMPILE_FILE_UNWRITABLE     = 0x84,
+    COMPILE_UNENCODABLE_CHAR    = 0x85,
+    COMPILE_KEY_HASH_COLLISION  = 0x86,
+    COMPILE_INVALID_TOKEN       = 0x87,
+    COMPILE_INVALID_TABLE       = 0x88
+};
+
+/**
+ * Settings that control how a file is compiled.
+ */
+struct compile_options
+{
+    int num_threads;        /* Max threads to use within a single file. */
+    bool use_cache;         /* Reuse unchanged entries from the last build. */
+    bool dedupe;            /* Share TDAT storage between equal strings. */
+    enum src_encoding input_encoding;   /* Source encoding (AUTO to detect
+                                           it from the source). */
+    enum gxt_game game;     /* Output format. */
+    struct compile_stats *stats;    /* Filled in with phase timings and
+                                       allocation counts (unless NULL). */
+    arena *arena;           /* Where compilation memory comes from (NULL to
+                               use an arena of its own). */
+    const struct allocator *allocator;  /* Where an arena of its own gets
+                                           memory from (NULL for the heap). */
 };
 
 /*
  * Translates the specified GXT source file into a proper GXT file.
  *
+ * This function is reentrant; separate files may be compiled concurrently on
+ * different threads as long as each has its own diagnostic buffer. Large
+ * files are themselves split up and compiled on up to opts->num_threads
+ * threads; the output is the same no matter how many threads are used.
+ *
+ * If opts->use_cache is set, the encoded entries are saved alongside the
+ * output in "<out_file>.cache". The next compilation of the same file only
+ * re-encodes the entries whose source text has changed, and does nothing at
+ * all if neither the source nor the output has changed.
+ *
+ * The source is decoded as opts->input_encoding. With SRC_ENCODING_AUTO it
+ * is UTF-8 or UTF-16 if it starts with a byte order mark, otherwise UTF-8 if
+ * it is well-formed UTF-8, otherwise ISO-8859-1. UTF-16 sources are lexed a
+ * 16-bit unit at a time, and their columns are counted in units.
+ *
+ * The output format is that of opts->game. For GTA SA, keys are stored as
+ * hashes (see gxt_key_hash()) sorted in hash order, and two keys whose names
+ * hash to the same value are an error.
+ *
+ * For GTA VC and SA, "[@NAME]" declares a table: the keys that follow go in
+ * table NAME until the next declaration, and keys before the first
+ * declaration go in MAIN. Each table gets its own TKEY and TDAT, so a key
+ * may be defined once in each table. The tables are built on up to
+ * opts->num_threads threads, and are written MAIN first and then in order of
+ * name, as listed in TABL.
+ *
+ * If opts->dedupe is set, keys whose strings are equal, or where one string
+ * is the tail end of another, point to the same place in TDAT. The number of
+ * bytes saved is reported as a note.
+ *
+ * If opts->stats is set, it is filled in with the time each phase took and
+ * the allocations it made. The counts cover every thread in the process, so
+ * they are only accurate if nothing else is compiling at the same time.
+ *
+ * Memory needed while compiling comes from opts->arena, which is reset before
+ * returning whether or not compilation succeeded. Passing the same arena to
+ * each of a series of compilations lets later ones reuse the memory of
+ * earlier ones. An arena may only be used for one compilation at a time.
+ * Without an arena, compile() makes its own, using opts->allocator.
+ *
  * @param src_file the path to the source file
  * @param out_file the path to the compiled file
+ * @param opts     the compilation settings (use NULL for defaults)
+ * @param diag     the buffer to write diagnostics to
+ *                 (use NULL to print them to the standard error stream)
+ *
+ * @return 0 if compilation was successful, nozero if unsuccessful
+ */
+int compile(const char *src_file, const char *out_file,
+            const struct compile_options *opts, struct diag_buf *diag);
+
+/*
+ * Translates GXT source held in memory into a GXT file held in memory.
+ *
+ * This works just like compile(), except that nothing is read from or written
+ * to disk, so opts->use_cache is ignored. The output is allocated with the
+ * allocation functions of opts->arena if it is set, otherwise with
+ * opts->allocator (or on the heap if that isn't set either), and belongs to
+ * the caller.
+ *
+ * @param name     the name of the source (for diagnostics)
+ * @param src      the source contents
+ * @param src_size the size of the source in bytes
+ * @param out      a pointer to where the compiled file should be stored
+ * @param out_size a pointer to where the size of the compiled file should be
+ *                 stored
+ * @param opts     the compilation settings (use NULL for defaults)
+ * @param diag     the buffer to write diagnostics to
+ *                 (use NULL to print them to the standard error stream)
  *
  * @return 0 if compilation was successful, nozero if unsuccessful
  */
-int compile(const char *src_file, const char *out_file);
+int compile_buffer(const char *name, const char *src, size_t src_size,
+                   char **out, size_t *out_size,
+                   const struct compile_options *opts, struct diag_buf *diag);
 
 #endif /* _GXTMAKER_COMPILER_H_ */
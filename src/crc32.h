@@ -0,0 +1,36 @@
+/*
+ * Copyright (c) 2017 Wes Hampson <thehambone93@gmail.com>
+ *
+ * Licensed under the MIT License. See LICENSE at top level directory.
+ */
+
+#ifndef _GXTMAKER_CRC32_H_
+#define _GXTMAKER_CRC32_H_
+
+#include <stdint.h>
+#include <stdlib.h>
+
+/**
+ * Updates a CRC-32 (the IEEE 802.3 polynomial, as used by zlib) with more
+ * data. No conditioning is applied: the caller picks the initial value and
+ * whether to invert the result.
+ *
+ * Uses the ARMv8 CRC32 instructions where the compiler targets them, and
+ * slice-by-8 tables (8 bytes per step) elsewhere. The x86 CRC32 instruction
+ * computes a different polynomial (CRC-32C), so it can't be used here.
+ * Defining GXTMAKER_SCALAR_SCAN at build time forces the table path.
+ *
+ * @param crc  the CRC so far
+ * @param data the data to add
+ * @param len  the size of the data in bytes
+ *
+ * @return the updated CRC
+ */
+uint32_t crc32_update(uint32_t crc, const void *data, size_t len);
+
+/**
+ * Slice-by-8 table implementation of crc32_update().
+ */
+uint32_t crc32_update_scalar(uint32_t crc, const void *data, size_t len);
+
+#endif /* _GXTMAKER_CRC32_H_ */
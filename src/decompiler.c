@@ -0,0 +1,319 @@
+/*
+ * Copyright (c) 2017 Wes Hampson <thehambone93@gmail.com>
+ *
+ * Licensed under the MIT License. See LICENSE at top level directory.
+ */
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "charset.h"
+#include "decompiler.h"
+#include "errwarn.h"
+#include "gxt.h"
+#include "scan.h"
+
+/* Bytes written around each string: "[" name "]\n" string "\n\n" */
+#define ENTRY_OVERHEAD      (GXT_KEY_MAX_LEN + 5)
+
+/* The last entry of a source file is never compiled */
+#define SRC_TRAILER \
+    "[DUMMY]\nTHIS LABEL NEEDS TO BE HERE AS THE LAST LABEL DOES NOT GET " \
+    "COMPILED\n"
+
+/**
+ * A TKEY entry, along with the length of its string.
+ */
+struct tkey_ref
+{
+    struct gxt_key key;
+    size_t index;           /* Position in TKEY. */
+    size_t len;             /* String length in chars. */
+};
+
+static int read_keys(const struct gxt_reader *gxt, const char *gxt_file,
+                     struct tkey_ref *refs, struct diag_buf *diag);
+static int write_source(const struct gxt_reader *gxt,
+                        const struct tkey_ref *refs, const char *gxt_file,
+                        char *src, size_t *src_size, struct diag_buf *diag);
+static const char * check_value(const char *text, size_t len);
+static bool is_key_char(char c);
+static int compare_tdat_order(const void *a, const void *b);
+
+int decompile(const char *gxt_file, const char *out_file,
+              struct diag_buf *diag)
+{
+    struct gxt_reader gxt;
+    int result = open_gxt(gxt_file, &gxt, diag);
+    if (result != DECOMPILE_SUCCESS)
+    {
+        return result;
+    }
+
+    struct tkey_ref *refs = (struct tkey_ref *)
+        malloc((gxt.num_keys + 1) * sizeof(struct tkey_ref));
+    char *src = NULL;
+    size_t src_size = 0;
+
+    if (refs == NULL)
+    {
+        result = DECOMPILE_OUT_OF_MEMORY;
+    }
+    if (result == DECOMPILE_SUCCESS)
+    {
+        result = read_keys(&gxt, gxt_file, refs, diag);
+    }
+    if (result == DECOMPILE_SUCCESS)
+    {
+        /* The text is at most 4 bytes per char, so it is sized up front */
+        size_t max_size = gxt.num_keys * ENTRY_OVERHEAD
+                        + sizeof(SRC_TRAILER);
+        for (size_t i = 0; i < gxt.num_keys; i++)
+        {
+            max_size += refs[i].len * 4;
+        }
+
+        src = (char *) malloc(max_size);
+        if (src == NULL)
+        {
+            result = DECOMPILE_OUT_OF_MEMORY;
+        }
+    }
+    if (result == DECOMPILE_SUCCESS)
+    {
+        result = write_source(&gxt, refs, gxt_file, src, &src_size, diag);
+    }
+
+    free(refs);
+    gxt_close(&gxt);
+
+    if (result != DECOMPILE_SUCCESS)
+    {
+        free(src);
+        return result;
+    }
+
+    FILE *dest = fopen(out_file, "wb");
+    if (dest == NULL)
+    {
+        error(diag, E_FILE_UNWRITABLE, out_file);
+        free(src);
+        return DECOMPILE_FILE_UNWRITABLE;
+    }
+
+    bool written = fwrite(src, src_size, 1, dest) == 1;
+    written = (fclose(dest) == 0) && written;
+
+    free(src);
+
+    if (!written)
+    {
+        error(diag, E_FILE_UNWRITABLE, out_file);
+        return DECOMPILE_FILE_UNWRITABLE;
+    }
+
+    return DECOMPILE_SUCCESS;
+}
+
+int open_gxt(const char *gxt_file, struct gxt_reader *reader,
+             struct diag_buf *diag)
+{
+    switch (gxt_open(gxt_file, reader))
+    {
+        case GXT_OPEN_SUCCESS:
+            return DECOMPILE_SUCCESS;
+        case GXT_OPEN_UNREADABLE:
+            error(diag, E_FILE_UNREADABLE, gxt_file);
+            return DECOMPILE_FILE_UNREADABLE;
+        case GXT_OPEN_UNSUPPORTED:
+            error_f(diag, E_UNSUPPORTED_GXT, gxt_file, -1, -1,
+                    reader->problem);
+            return DECOMPILE_INVALID_GXT;
+        default:
+            error_f(diag, E_INVALID_GXT, gxt_file, -1, -1, reader->problem);
+            return DECOMPILE_INVALID_GXT;
+    }
+}
+
+const char * describe_bad_string(const struct gxt_reader *reader,
+                                 const struct gxt_key *key)
+{
+    if (key->offset % sizeof(gxt_char) != 0
+        || key->offset / sizeof(gxt_char) >= reader->tdat_len)
+    {
+        return "key points outside of TDAT";
+    }
+
+    return "string is not terminated";
+}
+
+/**
+ * Reads TKEY, checks that each key can be written as source and points to a
+ * whole string, and sorts the keys into the order of their strings.
+ *
+ * @return DECOMPILE_SUCCESS if every key was read,
+ *         DECOMPILE_INVALID_GXT if a key is malformed,
+ *         DECOMPILE_UNWRITABLE_STRING if a key name can't be written as
+ *         source (either of which is reported)
+ */
+static int read_keys(const struct gxt_reader *gxt, const char *gxt_file,
+                     struct tkey_ref *refs, struct diag_buf *diag)
+{
+    for (size_t i = 0; i < gxt->num_keys; i++)
+    {
+        struct tkey_ref *ref = &refs[i];
+        ref->key = gxt->keys[i];
+        ref->index = i;
+
+        const char *name = ref->key.name;
+        size_t name_len = 0;
+        while (name_len < GXT_KEY_MAX_LEN && name[name_len] != '\0')
+        {
+            if (!is_key_char(name[name_len]))
+            {
+                error_f(diag, E_UNWRITABLE_STRING, gxt_file, -1, -1, name,
+                        "has a name containing a bracket or control char");
+                return DECOMPILE_UNWRITABLE_STRING;
+            }
+            name_len++;
+        }
+        if (name_len == GXT_KEY_MAX_LEN)
+        {
+            error_f(diag, E_INVALID_GXT, gxt_file, -1, -1,
+                    "key name is not terminated");
+            return DECOMPILE_INVALID_GXT;
+        }
+
+        /* Find the end of the string; it must lie within TDAT */
+        if (gxt_get_string(gxt, &ref->key, &ref->len) == NULL)
+        {
+            error_f(diag, E_INVALID_GXT, gxt_file, -1, -1,
+                    describe_bad_string(gxt, &ref->key));
+            return DECOMPILE_INVALID_GXT;
+        }
+    }
+
+    qsort(refs, gxt->num_keys, sizeof(struct tkey_ref), compare_tdat_order);
+
+    return DECOMPILE_SUCCESS;
+}
+
+/**
+ * Decodes every string and writes it out as a source entry.
+ *
+ * @param src      where to write the source; must be big enough for every
+ *                 string at 4 bytes per char, plus ENTRY_OVERHEAD bytes per
+ *                 key and the trailer
+ * @param src_size a pointer to where the size of the source should be stored
+ *
+ * @return DECOMPILE_SUCCESS if every string was written,
+ *         DECOMPILE_UNDECODABLE_GLYPH if a string contains a glyph that is
+ *         not in the charset,
+ *         DECOMPILE_UNWRITABLE_STRING if a string would be read back
+ *         differently (either of which is reported)
+ */
+static int write_source(const struct gxt_reader *gxt,
+                        const struct tkey_ref *refs, const char *gxt_file,
+                        char *src, size_t *src_size, struct diag_buf *diag)
+{
+    const struct charset *cs = charset_for_game(GXT_GAME_GTA3, NULL);
+    size_t n = 0;
+
+    for (size_t i = 0; i < gxt->num_keys; i++)
+    {
+        const struct tkey_ref *ref = &refs[i];
+        const char *glyphs = (const char *) gxt->tdat + ref->key.offset;
+
+        src[n++] = '[';
+        size_t name_len = strlen(ref->key.name);
+        memcpy(src + n, ref->key.name, name_len);
+        n += name_len;
+        src[n++] = ']';
+        src[n++] = '\n';
+
+        size_t text_len;
+        size_t done = charset_decode(cs, glyphs, ref->len, src + n, &text_len);
+        if (done < ref->len)
+        {
+            const unsigned char *g =
+                (const unsigned char *) glyphs + done * sizeof(gxt_char);
+            error_f(diag, E_UNDECODABLE_GLYPH, gxt_file, -1, -1,
+                    ref->key.name, (unsigned int) (g[0] | (g[1] << 8)),
+                    cs->name);
+            return DECOMPILE_UNDECODABLE_GLYPH;
+        }
+
+        const char *problem = check_value(src + n, text_len);
+        if (problem != NULL)
+        {
+            error_f(diag, E_UNWRITABLE_STRING, gxt_file, -1, -1,
+                    ref->key.name, problem);
+            return DECOMPILE_UNWRITABLE_STRING;
+        }
+
+        n += text_len;
+        src[n++] = '\n';
+        src[n++] = '\n';
+    }
+
+    memcpy(src + n, SRC_TRAILER, sizeof(SRC_TRAILER) - 1);
+    n += sizeof(SRC_TRAILER) - 1;
+
+    *src_size = n;
+
+    return DECOMPILE_SUCCESS;
+}
+
+/**
+ * Checks that compile() would read a string back as it is.
+ *
+ * @return NULL if the string can be written as source, otherwise a
+ *         description of the problem
+ */
+static const char * check_value(const char *text, size_t len)
+{
+    static const char delims[SCAN_NUM_DELIMS] = { '[', '{', '\n', '\r' };
+
+    if (len == 0)
+    {
+        /* Keys without a value are dropped */
+        return "is empty";
+    }
+    if (text[0] == ' ' || text[0] == '\t')
+    {
+        /* Leading whitespace is skipped */
+        return "starts with whitespace";
+    }
+    if (scan_delims(text, len, delims) < len)
+    {
+        return "contains '[', '{' or a line break";
+    }
+
+    return NULL;
+}
+
+/**
+ * Checks whether a char can appear in a key name in source.
+ */
+static bool is_key_char(char c)
+{
+    return c >= ' ' && c <= '~' && c != '[' && c != ']' && c != '{';
+}
+
+/**
+ * Sort comparator that orders keys by the position of their strings in TDAT,
+ * then by their position in TKEY.
+ */
+static int compare_tdat_order(const void *a, const void *b)
+{
+    const struct tkey_ref *x = (const struct tkey_ref *) a;
+    const struct tkey_ref *y = (const struct tkey_ref *) b;
+
+    if (x->key.offset != y->key.offset)
+    {
+        return (x->key.offset < y->key.offset) ? -1 : 1;
+    }
+
+    return (x->index < y->index) ? -1 : (x->index > y->index);
+}
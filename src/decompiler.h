@@ -0,0 +1,80 @@
+/*
+ * Copyright (c) 2017 Wes Hampson <thehambone93@gmail.com>
+ *
+ * Licensed under the MIT License. See LICENSE at top level directory.
+ */
+
+#ifndef _GXTMAKER_DECOMPILER_H_
+#define _GXTMAKER_DECOMPILER_H_
+
+#include "compiler.h"
+#include "errwarn.h"
+#include "gxt.h"
+
+enum decompiler_status
+{
+    DECOMPILE_SUCCESS           = COMPILE_SUCCESS,
+    DECOMPILE_FILE_UNREADABLE   = COMPILE_FILE_UNREADABLE,
+    DECOMPILE_OUT_OF_MEMORY     = COMPILE_OUT_OF_MEMORY,
+    DECOMPILE_FILE_UNWRITABLE   = COMPILE_FILE_UNWRITABLE,
+    DECOMPILE_INVALID_GXT       = 0x90,
+    DECOMPILE_UNDECODABLE_GLYPH = 0x91,
+    DECOMPILE_UNWRITABLE_STRING = 0x92,
+    DECOMPILE_KEY_NOT_FOUND     = 0x93
+};
+
+/*
+ * Translates a GXT file back into GXT source.
+ *
+ * The source is written as UTF-8, with the strings in the order they are
+ * stored in TDAT. Compiling it gives back the same keys and strings, and for
+ * files laid out the way compile() lays them out, the same bytes. A "[DUMMY]"
+ * entry is added at the end, as the last entry of a source file is never
+ * compiled.
+ *
+ * Only GTA3-style files (a single TKEY and TDAT) can be decompiled; GTA SA
+ * files store hashes of the key names rather than the names themselves.
+ * Strings that compile() would read differently, such as those that start
+ * with a space or contain '[', are reported as errors.
+ *
+ * This function is reentrant; separate files may be decompiled concurrently
+ * on different threads as long as each has its own diagnostic buffer.
+ *
+ * @param gxt_file the path to the GXT file
+ * @param out_file the path to the source file to write
+ * @param diag     the buffer to write diagnostics to
+ *                 (use NULL to print them to the standard error stream)
+ *
+ * @return 0 if decompilation was successful, nonzero if unsuccessful
+ */
+int decompile(const char *gxt_file, const char *out_file,
+              struct diag_buf *diag);
+
+/**
+ * Opens a GTA3-style GXT file for reading with gxt_open(), reporting why if
+ * it can't be.
+ *
+ * @param gxt_file the path to the GXT file
+ * @param reader   the reader to be filled in
+ * @param diag     the buffer to write diagnostics to
+ *                 (use NULL to print them to the standard error stream)
+ *
+ * @return DECOMPILE_SUCCESS if the file was opened (close it with
+ *         gxt_close()), DECOMPILE_FILE_UNREADABLE or DECOMPILE_INVALID_GXT
+ *         if it wasn't
+ */
+int open_gxt(const char *gxt_file, struct gxt_reader *reader,
+             struct diag_buf *diag);
+
+/**
+ * Describes why gxt_get_string() couldn't get the string a key points to.
+ *
+ * @param reader the GXT file the key is from
+ * @param key    the key
+ *
+ * @return a description of the problem, for E_INVALID_GXT
+ */
+const char * describe_bad_string(const struct gxt_reader *reader,
+                                 const struct gxt_key *key);
+
+#endif /* _GXTMAKER_DECOMPILER_H_ */
@@ -0,0 +1,228 @@
+/*
+ * Copyright (c) 2017 Wes Hampson <thehambone93@gmail.com>
+ *
+ * Licensed under the MIT License. See LICENSE at top level directory.
+ */
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "decompiler.h"
+#include "diff.h"
+#include "errwarn.h"
+#include "gxt.h"
+#include "lookup.h"
+
+/* Initial size of the buffer strings are decoded into */
+#define DIFF_BUF_SIZE 4096
+
+/**
+ * One of the two files being compared, and how far through its TKEY the
+ * comparison has got.
+ */
+struct diff_side
+{
+    const char *file;
+    struct gxt_reader gxt;
+    size_t next;            /* Index of the next key to look at. */
+    uint64_t order;         /* gxt_key_order() of that key. */
+};
+
+static int check_sorted(const struct diff_side *side, struct diag_buf *diag);
+static bool advance(struct diff_side *side);
+static bool is_same_string(const struct diff_side *old_side,
+                           const struct diff_side *new_side);
+static int print_entry(char sign, const struct diff_side *side,
+                       char **buf, size_t *buf_size, FILE *stream,
+                       struct diag_buf *diag);
+
+int diff_gxt(const char *old_file, const char *new_file, FILE *stream,
+             struct diag_buf *diag)
+{
+    struct diff_side old_side = { old_file };
+    struct diff_side new_side = { new_file };
+
+    int status = open_gxt(old_file, &old_side.gxt, diag);
+    if (status != DECOMPILE_SUCCESS)
+    {
+        return status;
+    }
+    status = open_gxt(new_file, &new_side.gxt, diag);
+    if (status != DECOMPILE_SUCCESS)
+    {
+        gxt_close(&old_side.gxt);
+        return status;
+    }
+
+    /* The walk below relies on both TKEYs being sorted, so check that before
+       anything is printed */
+    int old_result = check_sorted(&old_side, diag);
+    int new_result = check_sorted(&new_side, diag);
+    status = (old_result != DECOMPILE_SUCCESS) ? old_result : new_result;
+
+    size_t buf_size = DIFF_BUF_SIZE;
+    char *buf = (status == DECOMPILE_SUCCESS) ? (char *) malloc(buf_size)
+                                              : NULL;
+    if (status == DECOMPILE_SUCCESS && buf == NULL)
+    {
+        status = DECOMPILE_OUT_OF_MEMORY;
+    }
+    if (status != DECOMPILE_SUCCESS)
+    {
+        gxt_close(&old_side.gxt);
+        gxt_close(&new_side.gxt);
+        return status;
+    }
+
+    /* Both TKEYs are sorted by name, so a key is in both files exactly when
+       the two walks reach it at the same time */
+    size_t num_added = 0;
+    size_t num_removed = 0;
+    size_t num_changed = 0;
+    old_side.next = (size_t) -1;
+    new_side.next = (size_t) -1;
+    bool has_old = advance(&old_side);
+    bool has_new = advance(&new_side);
+
+    while ((has_old || has_new) && status != DECOMPILE_OUT_OF_MEMORY)
+    {
+        int result = DECOMPILE_SUCCESS;
+
+        if (has_old && (!has_new || old_side.order < new_side.order))
+        {
+            result = print_entry('-', &old_side, &buf, &buf_size, stream,
+                                 diag);
+            num_removed++;
+            has_old = advance(&old_side);
+        }
+        else if (has_new && (!has_old || new_side.order < old_side.order))
+        {
+            result = print_entry('+', &new_side, &buf, &buf_size, stream,
+                                 diag);
+            num_added++;
+            has_new = advance(&new_side);
+        }
+        else
+        {
+            if (!is_same_string(&old_side, &new_side))
+            {
+                result = print_entry('-', &old_side, &buf, &buf_size, stream,
+                                     diag);
+                if (result != DECOMPILE_OUT_OF_MEMORY)
+                {
+                    int new_result = print_entry('+', &new_side, &buf,
+                                                 &buf_size, stream, diag);
+                    if (result == DECOMPILE_SUCCESS)
+                    {
+                        result = new_result;
+                    }
+                }
+                num_changed++;
+            }
+            has_old = advance(&old_side);
+            has_new = advance(&new_side);
+        }
+
+        if (status == DECOMPILE_SUCCESS || result == DECOMPILE_OUT_OF_MEMORY)
+        {
+            status = result;
+        }
+    }
+
+    if (status != DECOMPILE_OUT_OF_MEMORY)
+    {
+        note(diag, N_KEYS_DIFFERED, new_file, num_added, num_removed,
+             num_changed, old_file);
+    }
+
+    free(buf);
+    gxt_close(&old_side.gxt);
+    gxt_close(&new_side.gxt);
+
+    return status;
+}
+
+/**
+ * Checks that a file's keys are in strictly increasing order, as the merge
+ * walk needs (see gxt_open()). A file whose keys are out of order (or
+ * repeated) is reported.
+ *
+ * @return DECOMPILE_SUCCESS, or DECOMPILE_INVALID_GXT if the keys are not
+ *         sorted
+ */
+static int check_sorted(const struct diff_side *side, struct diag_buf *diag)
+{
+    if (!side->gxt.is_sorted)
+    {
+        error_f(diag, E_INVALID_GXT, side->file, -1, -1,
+                "keys are not sorted");
+        return DECOMPILE_INVALID_GXT;
+    }
+
+    return DECOMPILE_SUCCESS;
+}
+
+/**
+ * Moves on to the next key of a file.
+ *
+ * @return true if there is another key, false if the file has run out
+ */
+static bool advance(struct diff_side *side)
+{
+    size_t i = side->next + 1;
+    if (i >= side->gxt.num_keys)
+    {
+        side->next = side->gxt.num_keys;
+        return false;
+    }
+
+    side->next = i;
+    side->order = gxt_key_order(side->gxt.keys[i].name);
+
+    return true;
+}
+
+/**
+ * Checks whether the current keys of two files have the same string. A key
+ * that doesn't point to a string never has the same string as another, so
+ * that the problem is reported when it is printed.
+ */
+static bool is_same_string(const struct diff_side *old_side,
+                           const struct diff_side *new_side)
+{
+    size_t old_len, new_len;
+    const gxt_char *old_str = gxt_get_string(&old_side->gxt,
+        &old_side->gxt.keys[old_side->next], &old_len);
+    const gxt_char *new_str = gxt_get_string(&new_side->gxt,
+        &new_side->gxt.keys[new_side->next], &new_len);
+
+    /* Finding the ends of the strings is vectorized (see scan_delims16()),
+       and so is comparing strings of the same length */
+    return old_str != NULL && new_str != NULL && old_len == new_len
+        && memcmp(old_str, new_str, old_len * sizeof(gxt_char)) == 0;
+}
+
+/**
+ * Prints a file's current key and its string, after a '-' or '+'. The line
+ * is still ended if the string can't be printed.
+ *
+ * @return DECOMPILE_SUCCESS, or the status of print_key_string()
+ */
+static int print_entry(char sign, const struct diff_side *side,
+                       char **buf, size_t *buf_size, FILE *stream,
+                       struct diag_buf *diag)
+{
+    const struct gxt_key *key = &side->gxt.keys[side->next];
+    fprintf(stream, "%c[%.8s] ", sign, key->name);
+
+    int result = print_key_string(&side->gxt, side->file, key, buf, buf_size,
+                                  stream, diag);
+    if (result != DECOMPILE_SUCCESS)
+    {
+        fputc('\n', stream);
+    }
+
+    return result;
+}
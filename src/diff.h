@@ -0,0 +1,43 @@
+/*
+ * Copyright (c) 2017 Wes Hampson <thehambone93@gmail.com>
+ *
+ * Licensed under the MIT License. See LICENSE at top level directory.
+ */
+
+#ifndef _GXTMAKER_DIFF_H_
+#define _GXTMAKER_DIFF_H_
+
+#include <stdio.h>
+
+#include "decompiler.h"
+#include "errwarn.h"
+
+/*
+ * Prints the differences between the strings of two GXT files.
+ *
+ * Each key that is only in the old file is printed as "-[KEY] string", and
+ * each key that is only in the new file as "+[KEY] string". A key whose
+ * string changed gets both lines. Strings are decoded as UTF-8, and keys are
+ * listed in TKEY order. A count of the keys added, removed and changed is
+ * reported as a note.
+ *
+ * Both files are memory-mapped and their TKEYs, which are sorted by name,
+ * are walked side by side in a single pass, so each key is only looked at
+ * once. Only the strings of keys that differ are decoded. A file whose keys
+ * are out of order is reported before anything is printed.
+ *
+ * Only GTA3-style files (a single TKEY and TDAT) can be read.
+ *
+ * @param old_file the path to the old GXT file
+ * @param new_file the path to the new GXT file
+ * @param stream   the stream to print the differences to
+ * @param diag     the buffer to write diagnostics to
+ *                 (use NULL to print them to the standard error stream)
+ *
+ * @return 0 if the files were compared (whether or not they differ),
+ *         otherwise a decompiler_status
+ */
+int diff_gxt(const char *old_file, const char *new_file, FILE *stream,
+             struct diag_buf *diag);
+
+#endif /* _GXTMAKER_DIFF_H_ */
@@ -0,0 +1,601 @@
+/*
+ * Copyright (c) 2017 Wes Hampson <thehambone93@gmail.com>
+ *
+ * Licensed under the MIT License. See LICENSE at top level directory.
+ */
+
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "charset.h"
+#include "dump.h"
+#include "errwarn.h"
+#include "gxt.h"
+#include "io.h"
+#include "scan.h"
+
+#define DUMP_BUF_SIZE       (256 * 1024)
+#define DUMP_MAX_NOTE       256     /* Longest text put() adds at once. */
+#define DUMP_STR_CHUNK      1024    /* Glyphs decoded at a time. */
+#define DUMP_HEX_CHUNK_ROWS 1024    /* Rows hex dumped at a time. */
+
+#define BLOCK_HEADER_SIZE   sizeof(struct gxt_block_header)
+
+/* The two hex digits of every ASCII byte value, as \x escapes show them */
+static const char hex_pairs[] =
+    "000102030405060708090A0B0C0D0E0F101112131415161718191A1B1C1D1E1F"
+    "202122232425262728292A2B2C2D2E2F303132333435363738393A3B3C3D3E3F"
+    "404142434445464748494A4B4C4D4E4F505152535455565758595A5B5C5D5E5F"
+    "606162636465666768696A6B6C6D6E6F707172737475767778797A7B7C7D7E7F";
+
+/**
+ * A GXT file being dumped, and the buffer the dump is formatted into.
+ */
+struct dumper
+{
+    const char *data;       /* The file contents. */
+    size_t size;            /* The file size in bytes. */
+    bool show_data;         /* Hex dump TDATs too. */
+    const struct charset *cs;
+    size_t char_size;       /* Bytes per TDAT char. */
+    bool hashed_keys;       /* Keys are struct gxt_key_saiv. */
+    size_t end;             /* End of the furthest block dumped. */
+    int num_flagged;        /* Problems flagged with "!!". */
+    char *buf;              /* Formatted text not yet written out. */
+    size_t len;             /* Size of the text in buf. */
+    FILE *stream;
+};
+
+static void dump_file(struct dumper *d);
+static void dump_tables(struct dumper *d, size_t pos);
+static void dump_table(struct dumper *d, const struct gxt_tabl_entry *table);
+static void dump_blocks(struct dumper *d, size_t pos);
+static void dump_key(struct dumper *d, size_t pos, const char *tdat,
+                     size_t tdat_size);
+static void dump_string(struct dumper *d, const char *glyphs, size_t len);
+static void dump_hex(struct dumper *d, size_t pos, size_t size);
+static bool has_sig(const struct dumper *d, size_t pos, const char *sig);
+static void row(struct dumper *d, size_t pos, size_t size);
+static void end_row(struct dumper *d);
+static void put(struct dumper *d, const char *fmt, ...);
+static void flag(struct dumper *d, const char *fmt, ...);
+static void vput(struct dumper *d, const char *fmt, va_list args);
+static void reserve(struct dumper *d, size_t n);
+static void flush(struct dumper *d);
+
+int dump_gxt(const char *gxt_file, bool show_data, FILE *stream,
+             struct diag_buf *diag)
+{
+    struct mapped_file gxt;
+    if (!map_file(gxt_file, &gxt))
+    {
+        error(diag, E_FILE_UNREADABLE, gxt_file);
+        return DECOMPILE_FILE_UNREADABLE;
+    }
+
+    struct dumper d;
+    memset(&d, 0, sizeof(struct dumper));
+    d.data = gxt.data;
+    d.size = gxt.size;
+    d.show_data = show_data;
+    d.cs = charset_for_game(GXT_GAME_GTA3, NULL);
+    d.char_size = sizeof(gxt_char);
+    d.stream = stream;
+    d.buf = (char *) malloc(DUMP_BUF_SIZE);
+    if (d.buf == NULL)
+    {
+        unmap_file(&gxt);
+        return DECOMPILE_OUT_OF_MEMORY;
+    }
+
+    put(&d, "%s: %zu bytes\n", gxt_file, gxt.size);
+    dump_file(&d);
+    flush(&d);
+    fflush(stream);
+
+    free(d.buf);
+    unmap_file(&gxt);
+
+    if (d.num_flagged > 0)
+    {
+        char problem[64];
+        snprintf(problem, sizeof(problem), "%d problem%s flagged with '!!'",
+                 d.num_flagged, (d.num_flagged == 1) ? "" : "s");
+        error_f(diag, E_INVALID_GXT, gxt_file, -1, -1, problem);
+        return DECOMPILE_INVALID_GXT;
+    }
+
+    return DECOMPILE_SUCCESS;
+}
+
+/**
+ * Works out which kind of GXT file is being dumped and dumps its blocks,
+ * followed by anything after them.
+ */
+static void dump_file(struct dumper *d)
+{
+    struct gxt_sa_header header;
+    if (d->size >= sizeof(header))
+    {
+        memcpy(&header, d->data, sizeof(header));
+    }
+
+    if (d->size >= sizeof(header) && header.version == GXT_SA_VERSION
+        && (header.char_bits == 8 || header.char_bits == 16))
+    {
+        row(d, 0, sizeof(header));
+        put(d, "GTA SA header: version %u, %u-bit chars",
+            header.version, header.char_bits);
+        end_row(d);
+
+        d->cs = charset_for_game(GXT_GAME_SA, NULL);
+        d->char_size = header.char_bits / 8;
+        d->hashed_keys = true;
+        d->end = sizeof(header);
+    }
+
+    if (has_sig(d, d->end, "TABL"))
+    {
+        if (!d->hashed_keys)
+        {
+            d->cs = charset_for_game(GXT_GAME_VC, NULL);
+        }
+        dump_tables(d, d->end);
+    }
+    else if (has_sig(d, d->end, "TKEY"))
+    {
+        dump_blocks(d, d->end);
+    }
+    else
+    {
+        row(d, d->end, 0);
+        flag(d, "no TABL or TKEY block");
+        end_row(d);
+    }
+
+    if (d->end < d->size)
+    {
+        row(d, d->end, 0);
+        put(d, "unknown data: %zu bytes", d->size - d->end);
+        end_row(d);
+        dump_hex(d, d->end, d->size - d->end);
+    }
+}
+
+/**
+ * Dumps a TABL block, then each of the tables it lists.
+ */
+static void dump_tables(struct dumper *d, size_t pos)
+{
+    struct gxt_block_header tabl;
+    memcpy(&tabl, d->data + pos, BLOCK_HEADER_SIZE);
+
+    const size_t entry_size = sizeof(struct gxt_tabl_entry);
+    size_t num_tables = tabl.size / entry_size;
+
+    row(d, pos, BLOCK_HEADER_SIZE);
+    put(d, "TABL: %u bytes, %zu table%s", tabl.size, num_tables,
+        (num_tables == 1) ? "" : "s");
+    pos += BLOCK_HEADER_SIZE;
+    d->end = pos;
+
+    if (tabl.size % entry_size != 0 || tabl.size > d->size - pos)
+    {
+        flag(d, "bad TABL block size");
+        end_row(d);
+        return;
+    }
+    end_row(d);
+
+    for (size_t i = 0; i < num_tables; i++)
+    {
+        struct gxt_tabl_entry table;
+        memcpy(&table, d->data + pos + i * entry_size, entry_size);
+
+        row(d, pos + i * entry_size, entry_size);
+        put(d, "table %-8.8s at %08x", table.name, table.offset);
+        end_row(d);
+    }
+    d->end = pos + tabl.size;
+
+    for (size_t i = 0; i < num_tables; i++)
+    {
+        struct gxt_tabl_entry table;
+        memcpy(&table, d->data + pos + i * entry_size, entry_size);
+
+        dump_table(d, &table);
+    }
+}
+
+/**
+ * Dumps a table listed in TABL. Tables other than MAIN repeat their name
+ * before their TKEY block.
+ */
+static void dump_table(struct dumper *d, const struct gxt_tabl_entry *table)
+{
+    size_t pos = table->offset;
+
+    put(d, "\n");
+    if (strncmp(table->name, GXT_MAIN_TABLE, sizeof(table->name)) != 0)
+    {
+        if (pos > d->size || d->size - pos < sizeof(table->name))
+        {
+            row(d, pos, 0);
+            flag(d, "table %.8s is outside of the file", table->name);
+            end_row(d);
+            return;
+        }
+
+        row(d, pos, sizeof(table->name));
+        put(d, "table %.8s", d->data + pos);
+        if (strncmp(d->data + pos, table->name, sizeof(table->name)) != 0)
+        {
+            flag(d, "name differs from TABL entry (%.8s)", table->name);
+        }
+        end_row(d);
+        pos += sizeof(table->name);
+    }
+
+    if (!has_sig(d, pos, "TKEY"))
+    {
+        row(d, pos, 0);
+        flag(d, "no TKEY block for table %.8s", table->name);
+        end_row(d);
+        return;
+    }
+
+    dump_blocks(d, pos);
+}
+
+/**
+ * Dumps a TKEY block, each of its keys and the TDAT block that follows it.
+ */
+static void dump_blocks(struct dumper *d, size_t pos)
+{
+    const size_t key_size = d->hashed_keys ? sizeof(struct gxt_key_saiv)
+                                           : sizeof(struct gxt_key);
+
+    struct gxt_block_header tkey;
+    memcpy(&tkey, d->data + pos, BLOCK_HEADER_SIZE);
+    size_t keys_pos = pos + BLOCK_HEADER_SIZE;
+    size_t num_keys = tkey.size / key_size;
+
+    row(d, pos, BLOCK_HEADER_SIZE);
+    put(d, "TKEY: %u bytes, %zu key%s", tkey.size, num_keys,
+        (num_keys == 1) ? "" : "s");
+    if (tkey.size % key_size != 0 || tkey.size > d->size - keys_pos)
+    {
+        flag(d, "bad TKEY block size");
+        end_row(d);
+        if (keys_pos > d->end)
+        {
+            d->end = keys_pos;
+        }
+        return;
+    }
+    end_row(d);
+
+    /* The keys' strings are in the TDAT block that comes next */
+    size_t tdat_pos = keys_pos + tkey.size;
+    struct gxt_block_header tdat = { { 0 }, 0 };
+    bool has_tdat = has_sig(d, tdat_pos, "TDAT");
+    if (has_tdat)
+    {
+        memcpy(&tdat, d->data + tdat_pos, BLOCK_HEADER_SIZE);
+    }
+    bool tdat_fits = has_tdat
+        && tdat.size <= d->size - tdat_pos - BLOCK_HEADER_SIZE;
+    const char *tdat_data = tdat_fits
+        ? d->data + tdat_pos + BLOCK_HEADER_SIZE
+        : NULL;
+
+    for (size_t i = 0; i < num_keys; i++)
+    {
+        dump_key(d, keys_pos + i * key_size, tdat_data, tdat.size);
+    }
+
+    size_t end = tdat_pos;
+    row(d, tdat_pos, has_tdat ? BLOCK_HEADER_SIZE : 0);
+    if (!has_tdat)
+    {
+        flag(d, "no TDAT block");
+    }
+    else
+    {
+        put(d, "TDAT: %u bytes", tdat.size);
+        end += BLOCK_HEADER_SIZE;
+        if (!tdat_fits)
+        {
+            flag(d, "bad TDAT block size");
+        }
+        else
+        {
+            end += tdat.size;
+        }
+    }
+    end_row(d);
+
+    if (tdat_fits && d->show_data)
+    {
+        dump_hex(d, tdat_pos + BLOCK_HEADER_SIZE, tdat.size);
+    }
+
+    if (end > d->end)
+    {
+        d->end = end;
+    }
+}
+
+/**
+ * Dumps a TKEY entry: the key's name (or hash), the offset of its string and
+ * the string.
+ *
+ * @param tdat      the contents of TDAT, or NULL if there is no TDAT
+ * @param tdat_size the size of TDAT in bytes
+ */
+static void dump_key(struct dumper *d, size_t pos, const char *tdat,
+                     size_t tdat_size)
+{
+    uint32_t offset;
+
+    if (d->hashed_keys)
+    {
+        struct gxt_key_saiv key;
+        memcpy(&key, d->data + pos, sizeof(key));
+        offset = key.offset;
+
+        row(d, pos, sizeof(key));
+        put(d, "%08X", key.name_crc);
+    }
+    else
+    {
+        struct gxt_key key;
+        memcpy(&key, d->data + pos, sizeof(key));
+        offset = key.offset;
+
+        /* Names are shown as they are stored, unprintables and all */
+        char name[GXT_KEY_MAX_LEN + 1];
+        size_t n = 0;
+        while (n < GXT_KEY_MAX_LEN && key.name[n] != '\0')
+        {
+            unsigned char c = (unsigned char) key.name[n];
+            name[n++] = (c >= 0x20 && c < 0x7F) ? (char) c : '.';
+        }
+        name[n] = '\0';
+
+        row(d, pos, sizeof(key));
+        put(d, "%-8s", name);
+        if (n == GXT_KEY_MAX_LEN)
+        {
+            flag(d, "name isn't terminated");
+        }
+    }
+    put(d, " -> %08x  ", offset);
+
+    if (tdat == NULL)
+    {
+        end_row(d);
+        return;
+    }
+
+    size_t tdat_len = tdat_size / d->char_size;
+    size_t start = offset / d->char_size;
+    if (offset % d->char_size != 0)
+    {
+        flag(d, "offset isn't aligned to a char");
+    }
+    else if (start >= tdat_len)
+    {
+        flag(d, "offset is outside of TDAT (%zu bytes)", tdat_size);
+    }
+    else
+    {
+        static const uint16_t nul[SCAN_NUM_DELIMS] = { 0, 0, 0, 0 };
+        const char *glyphs = tdat + offset;
+        const char *end;
+        size_t len;
+
+        if (d->char_size == sizeof(gxt_char))
+        {
+            len = scan_delims16(glyphs, tdat_len - start, nul);
+        }
+        else
+        {
+            end = (const char *) memchr(glyphs, 0, tdat_len - start);
+            len = (end != NULL) ? (size_t) (end - glyphs) : tdat_len - start;
+        }
+
+        if (len == tdat_len - start)
+        {
+            flag(d, "string isn't terminated");
+        }
+        else
+        {
+            dump_string(d, glyphs, len);
+        }
+    }
+
+    end_row(d);
+}
+
+/**
+ * Dumps a string in double quotes, decoded as UTF-8 and escaped.
+ *
+ * @param glyphs the string's glyph codes (d->char_size bytes each)
+ * @param len    the length of the string in glyphs
+ */
+static void dump_string(struct dumper *d, const char *glyphs, size_t len)
+{
+    char wide[DUMP_STR_CHUNK * sizeof(gxt_char)];
+    char text[DUMP_STR_CHUNK * 4];
+
+    put(d, "\"");
+
+    size_t i = 0;
+    while (i < len)
+    {
+        /* Narrow chars are widened so that the charset can decode them */
+        size_t n = (len - i < DUMP_STR_CHUNK) ? len - i : DUMP_STR_CHUNK;
+        const char *chunk = glyphs + i * d->char_size;
+        if (d->char_size != sizeof(gxt_char))
+        {
+            for (size_t j = 0; j < n; j++)
+            {
+                wide[j * 2] = chunk[j];
+                wide[j * 2 + 1] = 0;
+            }
+            chunk = wide;
+        }
+
+        size_t text_len;
+        size_t done = charset_decode(d->cs, chunk, n, text, &text_len);
+
+        /* Each byte is escaped as at most 4 chars */
+        reserve(d, text_len * 4);
+        char *p = d->buf + d->len;
+        for (size_t j = 0; j < text_len; j++)
+        {
+            unsigned char c = (unsigned char) text[j];
+            if (c == '"' || c == '\\')
+            {
+                *p++ = '\\';
+                *p++ = (char) c;
+            }
+            else if (c == '\n')
+            {
+                *p++ = '\\';
+                *p++ = 'n';
+            }
+            else if (c < 0x20 || c == 0x7F)
+            {
+                *p++ = '\\';
+                *p++ = 'x';
+                memcpy(p, hex_pairs + c * 2, 2);
+                p += 2;
+            }
+            else
+            {
+                *p++ = (char) c;
+            }
+        }
+        d->len = p - d->buf;
+
+        if (done < n)
+        {
+            const unsigned char *g =
+                (const unsigned char *) chunk + done * sizeof(gxt_char);
+            put(d, "\\g%04X", (unsigned int) (g[0] | (g[1] << 8)));
+            done++;
+        }
+
+        i += done;
+    }
+
+    put(d, "\"");
+}
+
+/**
+ * Dumps part of the file as a plain hex dump.
+ */
+static void dump_hex(struct dumper *d, size_t pos, size_t size)
+{
+    const size_t chunk_size = DUMP_HEX_CHUNK_ROWS * HEX_ROW_BYTES;
+
+    while (size > 0)
+    {
+        size_t n = (size < chunk_size) ? size : chunk_size;
+        reserve(d, DUMP_HEX_CHUNK_ROWS * (HEX_ROW_SIZE + 1));
+        d->len += hex_format(d->buf + d->len, d->data + pos, n,
+                             (uint32_t) pos);
+        pos += n;
+        size -= n;
+    }
+}
+
+/**
+ * Checks whether a block with the given signature starts at a position, with
+ * room for its header.
+ */
+static bool has_sig(const struct dumper *d, size_t pos, const char *sig)
+{
+    return pos <= d->size && d->size - pos >= BLOCK_HEADER_SIZE
+        && memcmp(d->data + pos, sig, 4) == 0;
+}
+
+/**
+ * Starts a row: the position, and up to HEX_ROW_BYTES bytes from there in
+ * hex. What the bytes are follows with put() and flag().
+ */
+static void row(struct dumper *d, size_t pos, size_t size)
+{
+    /* Rows without bytes can be for positions past the end of the file */
+    const char *bytes = (size > 0) ? d->data + pos : NULL;
+
+    reserve(d, HEX_ROW_SIZE);
+    d->len += hex_format_row(d->buf + d->len, bytes, size, (uint32_t) pos,
+                             false);
+}
+
+static void end_row(struct dumper *d)
+{
+    put(d, "\n");
+}
+
+/**
+ * Adds formatted text to the dump.
+ */
+static void put(struct dumper *d, const char *fmt, ...)
+{
+    va_list args;
+    va_start(args, fmt);
+    vput(d, fmt, args);
+    va_end(args);
+}
+
+/**
+ * Adds a problem to the dump, marked with "!!".
+ */
+static void flag(struct dumper *d, const char *fmt, ...)
+{
+    d->num_flagged++;
+    put(d, "  !! ");
+
+    va_list args;
+    va_start(args, fmt);
+    vput(d, fmt, args);
+    va_end(args);
+}
+
+static void vput(struct dumper *d, const char *fmt, va_list args)
+{
+    reserve(d, DUMP_MAX_NOTE);
+    int n = vsnprintf(d->buf + d->len, DUMP_MAX_NOTE, fmt, args);
+    if (n > 0)
+    {
+        d->len += (n < DUMP_MAX_NOTE) ? (size_t) n : DUMP_MAX_NOTE - 1;
+    }
+}
+
+/**
+ * Makes room for n more chars in the buffer, writing out what is there if
+ * need be.
+ */
+static void reserve(struct dumper *d, size_t n)
+{
+    if (d->len + n > DUMP_BUF_SIZE)
+    {
+        flush(d);
+    }
+}
+
+static void flush(struct dumper *d)
+{
+    if (d->len > 0)
+    {
+        fwrite(d->buf, d->len, 1, d->stream);
+        d->len = 0;
+    }
+}
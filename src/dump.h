@@ -0,0 +1,48 @@
+/*
+ * Copyright (c) 2017 Wes Hampson <thehambone93@gmail.com>
+ *
+ * Licensed under the MIT License. See LICENSE at top level directory.
+ */
+
+#ifndef _GXTMAKER_DUMP_H_
+#define _GXTMAKER_DUMP_H_
+
+#include <stdbool.h>
+#include <stdio.h>
+
+#include "decompiler.h"
+#include "errwarn.h"
+
+/*
+ * Prints an annotated dump of a GXT file.
+ *
+ * Each part of the file gets a row: its offset, its raw bytes in hex, and
+ * what they mean. The SA version header, the TABL entries and each table's
+ * TKEY and TDAT headers are described, and each key is shown with the
+ * offset of its string and the string itself, decoded as UTF-8. In strings,
+ * '"', '\' and control chars are escaped C-style, and glyphs with no
+ * character in the charset are shown as \gXXXX. Keys whose strings lie
+ * outside of TDAT, aren't aligned to a char or aren't terminated are flagged
+ * with "!!", as are blocks that don't fit in the file. Anything that isn't
+ * part of a known block is shown as a plain hex dump.
+ *
+ * GTA3 files (a lone TKEY and TDAT), VC files (TABL, 16-bit chars) and GTA
+ * SA files (version header and TABL, hashed keys) are understood.
+ *
+ * The dump is formatted into a large buffer and written out a chunk at a
+ * time.
+ *
+ * @param gxt_file  the path to the GXT file
+ * @param show_data true to also hex dump the contents of each TDAT
+ * @param stream    the stream to print the dump to
+ * @param diag      the buffer to write diagnostics to
+ *                  (use NULL to print them to the standard error stream)
+ *
+ * @return 0 if the file was dumped and nothing was flagged,
+ *         DECOMPILE_INVALID_GXT if something was flagged (which is
+ *         reported), otherwise another decompiler_status
+ */
+int dump_gxt(const char *gxt_file, bool show_data, FILE *stream,
+             struct diag_buf *diag);
+
+#endif /* _GXTMAKER_DUMP_H_ */
@@ -7,11 +7,14 @@
 #include <stdarg.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "errwarn.h"
 #include "gxtmaker.h"
 
-#define NUM_ERRORS 3
+#define NUM_ERRORS 27
+#define NUM_NOTES 5
+#define MAX_MSG_LEN 1024
 
 struct error
 {
@@ -25,11 +28,60 @@ struct error errors_list[] =
 {
     /* Don't forget to update NUM_ERRORS when adding/removing entries! */
     /* Keep order same as err_ids enum; IDs need to be in ascending order for
-       binary search (see show_error()) */
+       binary search (see show_message()) */
 
     { E_MISSING_INPUT_FILE, "no input file" },
     { E_FILE_NOT_FOUND, "file not found '%s'" },
-    { E_FILE_UNREADABLE, "unable to read file '%s'" }
+    { E_FILE_UNREADABLE, "unable to read file '%s'" },
+    { E_DUPLICATE_KEY, "duplicate key '%.8s' (first defined at %d:%d)" },
+    { E_GXT_KEY_TOO_LONG, "gxt key exceeds maximum length of %d characters" },
+    { E_FILE_UNWRITABLE, "unable to write file '%s'" },
+    { E_UNKNOWN_OPTION, "unrecognized option '%s'" },
+    { E_MISSING_ARGUMENT, "missing argument to '%s'" },
+    { E_INVALID_ARGUMENT, "invalid argument '%s' to '%s'" },
+    { E_UNENCODABLE_CHAR, "character U+%04lX has no glyph in charset '%s'" },
+    { E_MALFORMED_TEXT, "malformed character" },
+    { E_KEY_HASH_COLLISION,
+      "key '%.8s' has the same hash as key '%.8s' (0x%08X, defined at %d:%d)" },
+    { E_INVALID_GXT, "not a valid GXT file (%s)" },
+    { E_UNSUPPORTED_GXT, "unsupported GXT file (%s)" },
+    { E_UNDECODABLE_GLYPH,
+      "string '%.8s' contains glyph 0x%02X, which has no character in "
+      "charset '%s'" },
+    { E_UNWRITABLE_STRING,
+      "string '%.8s' %s, so it can't be written as source" },
+    { E_UNWATCHABLE_DIR, "unable to watch directory '%s'" },
+    { E_UNEXPECTED_INPUT_FILE,
+      "unexpected input file '%s' (sources are taken from '%s')" },
+    { E_UNKNOWN_TOKEN, "unknown formatting token '~%s~'" },
+    { E_UNBOUND_CONTROL,
+      "control name '~%s~' can only follow a key binding token, such as "
+      "'~k~'" },
+    { E_UNKNOWN_CONTROL, "unknown control name '~%s~' in key binding" },
+    { E_MISSING_CONTROL,
+      "key binding token '~%s~' must be followed by a control name, such "
+      "as '~PED_FIREWEAPON~'" },
+    { E_UNTERMINATED_TOKEN, "formatting token '~%s' has no closing '~'" },
+    { E_KEY_NOT_FOUND, "key '%s' not found" },
+    { E_TABLES_UNSUPPORTED, "tables can't be declared in %s files" },
+    { E_MISSING_TABLE_NAME, "missing table name" },
+    { E_DUPLICATE_OUTPUT,
+      "'%s' and '%s' would both be written to '%s'" }
+};
+
+struct error notes_list[] =
+{
+    /* Don't forget to update NUM_NOTES when adding/removing entries! */
+    /* Keep order same as note_ids enum */
+
+    { N_TDAT_SHARED, "sharing strings saved %zu of %zu TDAT bytes (%.1f%%)" },
+    { N_WATCHING, "watching for changes to sources (Ctrl+C to stop)" },
+    { N_RECOMPILED, "compiled to '%s' in %.2f ms" },
+    { N_KEYS_DIFFERED,
+      "%zu keys added, %zu removed and %zu changed since '%s'" },
+    { N_CHARSET_FALLBACK,
+      "there is no '%s' charset yet, so characters outside ASCII were given "
+      "their '%s' glyph codes" }
 };
 
 /**
@@ -44,71 +96,243 @@ static int compar_error(const void *key, const void *elem)
 }
 
 /**
- * Prints the specified error message to the console.
+ * Appends a message to a diagnostic buffer.
+ */
+static void diag_buf_append(struct diag_buf *diag, const char *msg, size_t len)
+{
+    if (diag->cap - diag->len < len)
+    {
+        size_t new_cap = (diag->cap == 0) ? MAX_MSG_LEN : diag->cap;
+        while (new_cap - diag->len < len)
+        {
+            new_cap *= 2;
+        }
+
+        char *new_data = (diag->arena != NULL)
+            ? (char *) arena_realloc(diag->arena, diag->data, diag->cap, new_cap)
+            : (char *) realloc(diag->data, new_cap);
+        if (new_data == NULL)
+        {
+            /* Better to lose the message than to crash over it */
+            return;
+        }
+
+        diag->data = new_data;
+        diag->cap = new_cap;
+    }
+
+    memcpy(diag->data + diag->len, msg, len);
+    diag->len += len;
+}
+
+/**
+ * Sends a complete message (ending in a newline) wherever a diagnostic buffer
+ * says it should go.
+ */
+static void deliver(struct diag_buf *diag, char *msg, size_t len)
+{
+    if (diag == NULL)
+    {
+        fputs(msg, stderr);
+    }
+    else if (diag->fn != NULL)
+    {
+        msg[len - 1] = '\0';
+        diag->fn(diag->fn_ctx, msg);
+    }
+    else
+    {
+        diag_buf_append(diag, msg, len);
+    }
+}
+
+/**
+ * Prints the specified message.
+ *
+ * The whole message is formatted before it is written, so messages written
+ * to stderr from different threads don't get mixed up with each other.
  *
- * @param e_id      the ID of the error message to show
- * @param file_name the name of the file in which the error occurred
+ * @param diag      the buffer to write the message to
+ *                  (use NULL to print to the standard error stream)
+ * @param list      the list of messages to find the message in
+ * @param list_size the number of messages in the list
+ * @param kind      the kind of message (e.g. "error")
+ * @param id        the ID of the message to show
+ * @param file_name the name of the file the message is about
  *                  (use NULL for no file)
- * @param line_num  the line number on which the error occurred
+ * @param line_num  the line number the message is about
  *                  (use non-positive number for no line)
- * @param col_num   the column number on which the error occurred
+ * @param col_num   the column number the message is about
  *                  (use non-positive number for no column)
  * @param msg_args  a variable argument list containing arguments for any
  *                  special formatting in the printed message
  *
- * @return true if the error specified by e_id exists and was displayed,
+ * @return true if the message specified by id exists and was displayed,
  *         false otherwise
  */
-static bool show_error(int e_id, const char *file_name,
-                       int line_num, int col_num, va_list msg_args)
+static bool show_message(struct diag_buf *diag, const struct error *list,
+                         size_t list_size, const char *kind, int id,
+                         const char *file_name, int line_num, int col_num,
+                         va_list msg_args)
 {
-    /* Find error by ID. */
+    /* Find message by ID. */
     struct error *e = (struct error *)
-        bsearch(&e_id, errors_list, NUM_ERRORS, ERROR_SIZE, compar_error);
+        bsearch(&id, list, list_size, ERROR_SIZE, compar_error);
 
     if (e == NULL)
     {
         return false;
     }
 
-    /* Print message context (can be either the program as a whole or part of a
-       file being compiled) */
+    char msg[MAX_MSG_LEN];
+    int len;
+
+    /* Print message context (can be either the program as a whole, a file
+       being compiled or part of a file being compiled) */
     if (file_name != NULL && line_num > 0 && col_num > 0)
     {
-        fprintf(stderr, "%s:%d:%d: error: ", file_name, line_num, col_num);
+        len = snprintf(msg, sizeof(msg), "%s:%d:%d: %s: ",
+                       file_name, line_num, col_num, kind);
+    }
+    else if (file_name != NULL)
+    {
+        len = snprintf(msg, sizeof(msg), "%s: %s: ", file_name, kind);
     }
     else
     {
-        fprintf(stderr, "%s: error: ", GXTMAKER_APP_NAME);
+        len = snprintf(msg, sizeof(msg), "%s: %s: ", GXTMAKER_APP_NAME, kind);
     }
 
     /* Print message with formatted arguments (if applicable) */
-    vfprintf(stderr, e->msg, msg_args);
-    fprintf(stderr, "\n");
+    if (len >= 0 && (size_t) len < sizeof(msg))
+    {
+        vsnprintf(msg + len, sizeof(msg) - len, e->msg, msg_args);
+    }
+
+    /* Make room for the newline if the message was truncated */
+    len = (int) strlen(msg);
+    if ((size_t) len == sizeof(msg) - 1)
+    {
+        len--;
+    }
+    msg[len++] = '\n';
+    msg[len] = '\0';
+
+    deliver(diag, msg, (size_t) len);
 
     return true;
 }
 
-bool error(int e_id, ...)
+bool error(struct diag_buf *diag, int e_id, ...)
 {
     va_list msg_args;
     va_start(msg_args, e_id);
 
-    bool shown = show_error(e_id, NULL, -1, -1, msg_args);
+    bool shown = show_message(diag, errors_list, NUM_ERRORS, "error", e_id,
+                              NULL, -1, -1, msg_args);
 
     va_end(msg_args);
 
     return shown;
 }
 
-bool error_f(int e_id, const char *file_name, int line_num, int col_num, ...)
+bool error_f(struct diag_buf *diag, int e_id, const char *file_name,
+             int line_num, int col_num, ...)
 {
     va_list msg_args;
     va_start(msg_args, col_num);
 
-    bool shown = show_error(e_id, file_name, line_num, col_num, msg_args);
+    bool shown = show_message(diag, errors_list, NUM_ERRORS, "error", e_id,
+                              file_name, line_num, col_num, msg_args);
+
+    va_end(msg_args);
+
+    return shown;
+}
+
+bool note(struct diag_buf *diag, int n_id, const char *file_name, ...)
+{
+    va_list msg_args;
+    va_start(msg_args, file_name);
+
+    bool shown = show_message(diag, notes_list, NUM_NOTES, "note", n_id,
+                              file_name, -1, -1, msg_args);
 
     va_end(msg_args);
 
     return shown;
 }
+
+void diag_buf_add(struct diag_buf *diag, const char *msg)
+{
+    char line[MAX_MSG_LEN];
+    size_t len = strlen(msg);
+    if (len > sizeof(line) - 2)
+    {
+        len = sizeof(line) - 2;
+    }
+
+    memcpy(line, msg, len);
+    line[len++] = '\n';
+    line[len] = '\0';
+
+    deliver(diag, line, len);
+}
+
+void diag_buf_flush(struct diag_buf *diag, FILE *stream)
+{
+    if (diag->len > 0)
+    {
+        fwrite(diag->data, 1, diag->len, stream);
+        fflush(stream);
+    }
+
+    diag->len = 0;
+}
+
+void diag_buf_move(struct diag_buf *dest, struct diag_buf *src)
+{
+    if (dest == NULL)
+    {
+        diag_buf_flush(src, stderr);
+        return;
+    }
+
+    if (dest->fn != NULL)
+    {
+        /* Every buffered message is a line no longer than MAX_MSG_LEN */
+        char line[MAX_MSG_LEN + 1];
+        size_t start = 0;
+        for (size_t i = 0; i < src->len; i++)
+        {
+            if (src->data[i] == '\n')
+            {
+                size_t len = i + 1 - start;
+                memcpy(line, src->data + start, len);
+                line[len] = '\0';
+                deliver(dest, line, len);
+                start = i + 1;
+            }
+        }
+    }
+    else if (src->len > 0)
+    {
+        diag_buf_append(dest, src->data, src->len);
+    }
+    src->len = 0;
+}
+
+void diag_buf_free(struct diag_buf *diag)
+{
+    if (diag->arena != NULL)
+    {
+        arena_free(diag->arena, diag->data, diag->cap);
+    }
+    else
+    {
+        free(diag->data);
+    }
+    diag->data = NULL;
+    diag->len = 0;
+    diag->cap = 0;
+}
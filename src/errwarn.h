@@ -8,38 +8,155 @@
 #define _GXTMAKER_ERRWARN_H_
 
 #include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "arena.h"
 
 enum error_ids
 {
     E_MISSING_INPUT_FILE,
     E_FILE_NOT_FOUND,       /* Requires 1 string argument */
-    E_FILE_UNREADABLE       /* Requires 1 string argument */
+    E_FILE_UNREADABLE,      /* Requires 1 string argument */
+    E_DUPLICATE_KEY,        /* Requires 1 string and 2 int arguments */
+    E_GXT_KEY_TOO_LONG,     /* Requires 1 int argument */
+    E_FILE_UNWRITABLE,      /* Requires 1 string argument */
+    E_UNKNOWN_OPTION,       /* Requires 1 string argument */
+    E_MISSING_ARGUMENT,     /* Requires 1 string argument */
+    E_INVALID_ARGUMENT,     /* Requires 2 string arguments */
+    E_UNENCODABLE_CHAR,     /* Requires 1 long and 1 string argument */
+    E_MALFORMED_TEXT,
+    E_KEY_HASH_COLLISION,   /* Requires 2 string, 1 unsigned and 2 int
+                               arguments */
+    E_INVALID_GXT,          /* Requires 1 string argument */
+    E_UNSUPPORTED_GXT,      /* Requires 1 string argument */
+    E_UNDECODABLE_GLYPH,    /* Requires 1 string, 1 unsigned and 1 string
+                               argument */
+    E_UNWRITABLE_STRING,    /* Requires 2 string arguments */
+    E_UNWATCHABLE_DIR,      /* Requires 1 string argument */
+    E_UNEXPECTED_INPUT_FILE, /* Requires 2 string arguments */
+    E_UNKNOWN_TOKEN,        /* Requires 1 string argument */
+    E_UNBOUND_CONTROL,      /* Requires 1 string argument */
+    E_UNKNOWN_CONTROL,      /* Requires 1 string argument */
+    E_MISSING_CONTROL,      /* Requires 1 string argument */
+    E_UNTERMINATED_TOKEN,   /* Requires 1 string argument */
+    E_KEY_NOT_FOUND,        /* Requires 1 string argument */
+    E_TABLES_UNSUPPORTED,   /* Requires 1 string argument */
+    E_MISSING_TABLE_NAME,
+    E_DUPLICATE_OUTPUT      /* Requires 3 string arguments */
+};
+
+/**
+ * A function that receives diagnostic messages.
+ *
+ * @param ctx the context pointer the function was registered with
+ * @param msg the message, as it would be printed but without the trailing
+ *            newline (e.g. "english.txt:12:3: error: ...")
+ */
+typedef void (*diag_fn)(void *ctx, const char *msg);
+
+/**
+ * A buffer that collects diagnostic messages instead of printing them.
+ *
+ * Compiling several files at once gives each file its own buffer, so that
+ * messages from different files are not interleaved. Initialize with
+ * DIAG_BUF_INIT and release with diag_buf_free(). A buffer whose arena is set
+ * keeps its messages in that arena rather than on the heap. A buffer whose fn
+ * is set keeps nothing, and passes each message straight to fn instead.
+ */
+struct diag_buf
+{
+    char *data;
+    size_t len;
+    size_t cap;
+    arena *arena;
+    diag_fn fn;
+    void *fn_ctx;
 };
 
+#define DIAG_BUF_INIT { NULL, 0, 0, NULL, NULL, NULL }
+
 /*enum warn_ids
 {
 
 };*/
 
+enum note_ids
+{
+    N_TDAT_SHARED,          /* Requires 2 size_t and 1 double argument */
+    N_WATCHING,
+    N_RECOMPILED,           /* Requires 1 string and 1 double argument */
+    N_KEYS_DIFFERED,        /* Requires 3 size_t and 1 string argument */
+    N_CHARSET_FALLBACK      /* Requires 2 string arguments */
+};
+
 /**
- * Prints an error message to the standard error stream in the context of the
- * entire program.
+ * Prints an error message in the context of the entire program.
  *
+ * @param diag the buffer to write the message to
+ *             (use NULL to print to the standard error stream)
  * @param e_id the ID of the error to be printed (see err_ids enum)
  * @param ...  error message format arguments (if applicable)
  */
-bool error(int e_id, ...);
+bool error(struct diag_buf *diag, int e_id, ...);
 
 /**
- * Prints an error message to the standard error stream in the context of a
- * specific file being processed.
+ * Prints an error message in the context of a specific file being processed.
  *
+ * @param diag      the buffer to write the message to
+ *                  (use NULL to print to the standard error stream)
  * @param e_id      the ID of the error to be printed (see err_ids enum)
  * @param file_name the name of the file in which the error occurred
  * @param line_num  the line number on which the error occurred
  * @param col_num   the column number on which the error occurred
  * @param ...       error message format arguments (if applicable)
  */
-bool error_f(int e_id, const char *file_name, int line_num, int col_num, ...);
+bool error_f(struct diag_buf *diag, int e_id, const char *file_name,
+             int line_num, int col_num, ...);
+
+/**
+ * Prints an informational message about a file being processed.
+ *
+ * @param diag      the buffer to write the message to
+ *                  (use NULL to print to the standard error stream)
+ * @param n_id      the ID of the note to be printed (see note_ids enum)
+ * @param file_name the name of the file the note is about
+ * @param ...       message format arguments (if applicable)
+ */
+bool note(struct diag_buf *diag, int n_id, const char *file_name, ...);
+
+/**
+ * Adds an already formatted message to a diagnostic buffer.
+ *
+ * @param diag the buffer to add the message to
+ *             (use NULL to print it to the standard error stream)
+ * @param msg  the message, without a trailing newline
+ */
+void diag_buf_add(struct diag_buf *diag, const char *msg);
+
+/**
+ * Writes all buffered messages to a stream and empties the buffer.
+ *
+ * @param diag   the buffer to flush
+ * @param stream the stream to write to
+ */
+void diag_buf_flush(struct diag_buf *diag, FILE *stream);
+
+/**
+ * Moves all messages from one diagnostic buffer to the end of another and
+ * empties the source buffer.
+ *
+ * @param dest the buffer to move messages to
+ *             (use NULL to print them to the standard error stream)
+ * @param src  the buffer to move messages from
+ */
+void diag_buf_move(struct diag_buf *dest, struct diag_buf *src);
+
+/**
+ * Releases the memory held by a diagnostic buffer.
+ *
+ * @param diag the buffer to free
+ */
+void diag_buf_free(struct diag_buf *diag);
 
 #endif /* _GXTMAKER_ERRWARN_H_ */
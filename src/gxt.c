@@ -4,7 +4,17 @@
  * Licensed under the MIT License. See LICENSE at top level directory.
  */
 
+#include <ctype.h>
+#include <string.h>
+
+#include "crc32.h"
 #include "gxt.h"
+#include "io.h"
+#include "scan.h"
+
+static const char * check_blocks(struct gxt_reader *reader,
+                                 enum gxt_open_status *status);
+static bool is_tkey_sorted(const struct gxt_reader *reader);
 
 size_t gxt_strlen(const gxt_char *str)
 {
@@ -18,3 +28,240 @@ size_t gxt_strlen(const gxt_char *str)
 
     return len;
 }
+
+uint32_t gxt_key_hash(const char *name)
+{
+    char upper[GXT_KEY_MAX_LEN];
+    size_t len = 0;
+
+    while (len < GXT_KEY_MAX_LEN && name[len] != '\0')
+    {
+        upper[len] = (char) toupper((unsigned char) name[len]);
+        len++;
+    }
+
+    return crc32_update(0xFFFFFFFF, upper, len);
+}
+
+bool gxt_parse_game(const char *name, enum gxt_game *game)
+{
+    if (strcmp(name, "gta3") == 0)
+    {
+        *game = GXT_GAME_GTA3;
+        return true;
+    }
+    else if (strcmp(name, "vc") == 0)
+    {
+        *game = GXT_GAME_VC;
+        return true;
+    }
+    else if (strcmp(name, "sa") == 0)
+    {
+        *game = GXT_GAME_SA;
+        return true;
+    }
+
+    return false;
+}
+
+const char * gxt_game_name(enum gxt_game game)
+{
+    switch (game)
+    {
+        case GXT_GAME_VC:
+            return "vc";
+        case GXT_GAME_SA:
+            return "sa";
+        default:
+            return "gta3";
+    }
+}
+
+enum gxt_open_status gxt_open(const char *path, struct gxt_reader *reader)
+{
+    memset(reader, 0, sizeof(struct gxt_reader));
+    if (!map_file(path, &reader->file))
+    {
+        return GXT_OPEN_UNREADABLE;
+    }
+
+    enum gxt_open_status status = GXT_OPEN_INVALID;
+    reader->problem = check_blocks(reader, &status);
+    if (reader->problem != NULL)
+    {
+        unmap_file(&reader->file);
+        return status;
+    }
+
+    reader->is_sorted = is_tkey_sorted(reader);
+
+    return GXT_OPEN_SUCCESS;
+}
+
+void gxt_close(struct gxt_reader *reader)
+{
+    unmap_file(&reader->file);
+    reader->keys = NULL;
+    reader->num_keys = 0;
+    reader->is_sorted = false;
+    reader->tdat = NULL;
+    reader->tdat_len = 0;
+}
+
+const struct gxt_key * gxt_find_key(const struct gxt_reader *reader,
+                                    const char *name)
+{
+    char padded[GXT_KEY_MAX_LEN] = { 0 };
+    size_t len = strlen(name);
+    if (len >= GXT_KEY_MAX_LEN)
+    {
+        return NULL;
+    }
+    memcpy(padded, name, len);
+
+    uint64_t target = gxt_key_order(padded);
+    if (!reader->is_sorted)
+    {
+        for (size_t i = 0; i < reader->num_keys; i++)
+        {
+            if (gxt_key_order(reader->keys[i].name) == target)
+            {
+                return &reader->keys[i];
+            }
+        }
+        return NULL;
+    }
+
+    size_t lo = 0;
+    size_t hi = reader->num_keys;
+
+    while (lo < hi)
+    {
+        size_t mid = lo + (hi - lo) / 2;
+        uint64_t k = gxt_key_order(reader->keys[mid].name);
+        if (k < target)
+        {
+            lo = mid + 1;
+        }
+        else if (k > target)
+        {
+            hi = mid;
+        }
+        else
+        {
+            return &reader->keys[mid];
+        }
+    }
+
+    return NULL;
+}
+
+const gxt_char * gxt_get_string(const struct gxt_reader *reader,
+                                const struct gxt_key *key, size_t *len)
+{
+    static const uint16_t nul[SCAN_NUM_DELIMS] = { 0, 0, 0, 0 };
+
+    size_t start = key->offset / sizeof(gxt_char);
+    if (key->offset % sizeof(gxt_char) != 0 || start >= reader->tdat_len)
+    {
+        return NULL;
+    }
+
+    const gxt_char *str = reader->tdat + start;
+    size_t max_len = reader->tdat_len - start;
+    *len = scan_delims16((const char *) str, max_len, nul);
+    if (*len == max_len)
+    {
+        return NULL;
+    }
+
+    return str;
+}
+
+/**
+ * Finds the TKEY and TDAT blocks of a GXT file and checks that they fit in
+ * the file.
+ *
+ * @param status a pointer to where the status should be stored if there is
+ *               a problem
+ *
+ * @return NULL if both blocks were found, otherwise a description of the
+ *         problem
+ */
+static const char * check_blocks(struct gxt_reader *reader,
+                                 enum gxt_open_status *status)
+{
+    const size_t header_size = sizeof(struct gxt_block_header);
+    const struct mapped_file *gxt = &reader->file;
+    struct gxt_block_header tkey;
+    struct gxt_block_header tdat;
+
+    if (gxt->size < header_size)
+    {
+        return "missing TKEY block";
+    }
+
+    memcpy(&tkey, gxt->data, header_size);
+    if (memcmp(tkey.sig, "TABL", sizeof(tkey.sig)) == 0)
+    {
+        *status = GXT_OPEN_UNSUPPORTED;
+        return "more than one table";
+    }
+    else if (tkey.sig[0] == GXT_SA_VERSION && tkey.sig[1] == 0)
+    {
+        *status = GXT_OPEN_UNSUPPORTED;
+        return "GTA SA key names are stored as hashes";
+    }
+    else if (memcmp(tkey.sig, "TKEY", sizeof(tkey.sig)) != 0)
+    {
+        return "missing TKEY block";
+    }
+    else if (tkey.size % sizeof(struct gxt_key) != 0
+             || tkey.size > gxt->size - header_size)
+    {
+        return "bad TKEY block size";
+    }
+    else if (gxt->size - header_size - tkey.size < header_size)
+    {
+        return "missing TDAT block";
+    }
+
+    memcpy(&tdat, gxt->data + header_size + tkey.size, header_size);
+    if (memcmp(tdat.sig, "TDAT", sizeof(tdat.sig)) != 0)
+    {
+        return "missing TDAT block";
+    }
+    else if (tdat.size % sizeof(gxt_char) != 0
+             || tdat.size > gxt->size - 2 * header_size - tkey.size)
+    {
+        return "bad TDAT block size";
+    }
+
+    /* The blocks start at multiples of 4 bytes from the start of the file,
+       so they can be used where they are */
+    reader->keys = (const struct gxt_key *) (gxt->data + header_size);
+    reader->num_keys = tkey.size / sizeof(struct gxt_key);
+    reader->tdat = (const gxt_char *)
+        (gxt->data + 2 * header_size + tkey.size);
+    reader->tdat_len = tdat.size / sizeof(gxt_char);
+
+    return NULL;
+}
+
+/**
+ * Checks that every key of TKEY comes after the one before it, which a binary
+ * search needs.
+ */
+static bool is_tkey_sorted(const struct gxt_reader *reader)
+{
+    for (size_t i = 1; i < reader->num_keys; i++)
+    {
+        if (gxt_key_order(reader->keys[i].name)
+            <= gxt_key_order(reader->keys[i - 1].name))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
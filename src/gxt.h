@@ -7,11 +7,29 @@
 #ifndef _GXTMAKER_GXT_H_
 #define _GXTMAKER_GXT_H_
 
+#include <stdbool.h>
 #include <stdint.h>
 #include <stdlib.h>
 
+#include "io.h"
+
 #define GXT_KEY_MAX_LEN 8
 
+#define GXT_SA_VERSION      4
+#define GXT_SA_CHAR_BITS    8
+#define GXT_MAIN_TABLE      "MAIN"
+
+/**
+ * Games whose GXT formats can be written.
+ */
+enum gxt_game
+{
+    GXT_GAME_GTA3,          /* GTA3: TKEY/TDAT, 16-bit chars. */
+    GXT_GAME_VC,            /* VC: TABL, TKEY/TDAT per table, 16-bit
+                               chars. */
+    GXT_GAME_SA             /* SA: TABL, hashed TKEY, 8-bit chars. */
+};
+
 /**
  * GXT TKEY entry structure for GTA2, GTA3, VC, LCS, and VCS.
  */
@@ -38,39 +56,156 @@ struct gxt_key_saiv
     uint32_t name_crc;      /* CRC32 sum of TDAT entry name */
 };
 
+/**
+ * GTA SA file header, which comes before the TABL block.
+ */
+struct gxt_sa_header
+{
+    uint16_t version;       /* GXT_SA_VERSION */
+    uint16_t char_bits;     /* Bits per TDAT char. */
+};
+
+/**
+ * TABL block entry, naming a table and giving the file position of its
+ * TKEY block (or for tables other than MAIN, of the copy of its name that
+ * comes before its TKEY block).
+ */
+struct gxt_tabl_entry
+{
+    char name[8];
+    uint32_t offset;
+};
+
 typedef uint16_t gxt_char;
 
+/**
+ * Outcomes of gxt_open().
+ */
+enum gxt_open_status
+{
+    GXT_OPEN_SUCCESS,
+    GXT_OPEN_UNREADABLE,    /* The file could not be read. */
+    GXT_OPEN_INVALID,       /* Not a GXT file; see problem. */
+    GXT_OPEN_UNSUPPORTED    /* A kind of GXT file that can't be read; see
+                               problem. */
+};
+
+/**
+ * A GTA3-style GXT file (a single TKEY and TDAT) opened for reading.
+ *
+ * The file is memory-mapped, and keys and tdat point straight into it, so
+ * opening a file costs the same however many keys it has. Only the block
+ * headers are checked when the file is opened; each string is checked as it
+ * is fetched by gxt_get_string().
+ */
+struct gxt_reader
+{
+    struct mapped_file file;
+    const struct gxt_key *keys; /* TKEY, normally sorted by name. */
+    size_t num_keys;
+    bool is_sorted;             /* Every key comes after the one before. */
+    const gxt_char *tdat;       /* TDAT. */
+    size_t tdat_len;            /* Length of TDAT in chars. */
+    const char *problem;        /* Why the file couldn't be opened. */
+};
+
 size_t gxt_strlen(const gxt_char *str);
 
-///**
-// * UTF-8 -> GTA3 character map.
-// * Use high bits for column, low bits for row.
-// */
-//const unsigned char gta3_charset[16][16] = 
-//{
-//    /* TODO: see what non-printable chars map to in-game */
-//    /* Lower 0x7F seems to match ASCII/UTF-8. */
-//    /* Don't worry about symbols changing between fonts. This is controlled by the game, not GXT */
-//    /* Mostly worry about foreign chars, things that persist across all fonts */
-//
-//    /* TODO: fill in */
-//    /*  x0    x1    x2    x3    x4    x5    x6    x7    x8    x9    xA    xB    xC    xD    xE    xF */
-//    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 }, /* 0x */
-//    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 }, /* 1x */
-//    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 }, /* 2x */
-//    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 }, /* 3x */
-//    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 }, /* 4x */
-//    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 }, /* 5x */
-//    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 }, /* 6x */
-//    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 }, /* 7x */
-//    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 }, /* 8x */
-//    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 }, /* 9x */
-//    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 }, /* Ax */
-//    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 }, /* Bx */
-//    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 }, /* Cx */
-//    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 }, /* Dx */
-//    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 }, /* Ex */
-//    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 }  /* Fx */
-//};
+/**
+ * Packs a NUL-padded key name into an integer whose ordering matches the
+ * ordering of the names, so that names can be sorted and searched with
+ * 8-byte compares.
+ *
+ * @param name the key name, padded with NULs to GXT_KEY_MAX_LEN chars
+ *
+ * @return the packed name
+ */
+static inline uint64_t gxt_key_order(const char name[GXT_KEY_MAX_LEN])
+{
+    uint64_t k = 0;
+    for (int i = 0; i < GXT_KEY_MAX_LEN; i++)
+    {
+        k = (k << 8) | (unsigned char) name[i];
+    }
+
+    return k;
+}
+
+/**
+ * Hashes a key name the way GTA SA does when looking up a key: a CRC32 of
+ * the upper-cased name, with an initial value of 0xFFFFFFFF and no final
+ * inversion.
+ *
+ * @param name the key name (NUL-terminated or GXT_KEY_MAX_LEN chars long)
+ *
+ * @return the hash stored in struct gxt_key_saiv
+ */
+uint32_t gxt_key_hash(const char *name);
+
+/**
+ * Looks up a game by name ("gta3", "vc" or "sa").
+ *
+ * @param name the name of the game
+ * @param game a pointer to where the game should be stored
+ *
+ * @return true if the name is valid, false otherwise
+ */
+bool gxt_parse_game(const char *name, enum gxt_game *game);
+
+/**
+ * Gets the name of a game, as accepted by gxt_parse_game().
+ *
+ * @param game the game
+ *
+ * @return the name of the game
+ */
+const char * gxt_game_name(enum gxt_game game);
+
+/**
+ * Opens a GTA3-style GXT file for reading and checks that its TKEY and TDAT
+ * blocks fit in the file. Whether TKEY is sorted is worked out as well.
+ *
+ * @param path   the path to the GXT file
+ * @param reader the reader to be filled in; if the file is a GXT file that
+ *               can't be read, reader->problem describes why
+ *
+ * @return GXT_OPEN_SUCCESS if the file was opened (close it with
+ *         gxt_close()), otherwise why it wasn't
+ */
+enum gxt_open_status gxt_open(const char *path, struct gxt_reader *reader);
+
+/**
+ * Closes a GXT file opened with gxt_open().
+ *
+ * @param reader the reader to close
+ */
+void gxt_close(struct gxt_reader *reader);
+
+/**
+ * Looks up a key by name with a binary search of TKEY. A TKEY that isn't
+ * sorted by name (or has a key more than once) is searched from the start
+ * instead, which finds the first key with the name.
+ *
+ * @param reader the GXT file to look in
+ * @param name   the key name (case-sensitive)
+ *
+ * @return the key, or NULL if there is no key with that name
+ */
+const struct gxt_key * gxt_find_key(const struct gxt_reader *reader,
+                                    const char *name);
+
+/**
+ * Gets the string a key points to.
+ *
+ * @param reader the GXT file the key is from
+ * @param key    the key
+ * @param len    a pointer to where the length of the string in chars should
+ *               be stored
+ *
+ * @return the string, or NULL if the key points outside of TDAT, between
+ *         chars or to a string that isn't terminated
+ */
+const gxt_char * gxt_get_string(const struct gxt_reader *reader,
+                                const struct gxt_key *key, size_t *len);
 
 #endif /* _GXTMAKER_GXT_H_ */
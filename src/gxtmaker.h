@@ -16,8 +16,38 @@
 #define GXTMAKER_APP_MOTTO "GTA Text Compiler"
 
 #define GXTMAKER_HELP_MESSAGE \
-"Usage: " GXTMAKER_APP_NAME " [options] file\n\
+"Usage: " GXTMAKER_APP_NAME " [options] file...\n\
+       " GXTMAKER_APP_NAME " [options] --watch DIR\n\
+       " GXTMAKER_APP_NAME " decompile [-o DIR] [-j N] file...\n\
+       " GXTMAKER_APP_NAME " dump [--hex] file...\n\
+       " GXTMAKER_APP_NAME " get file key...\n\
+       " GXTMAKER_APP_NAME " diff old new\n\
+\nEach file is compiled to <name>.gxt in the output directory. With\n\
+--watch, every <name>.txt in DIR is compiled, and compiled again each time\n\
+it is saved, until interrupted. With decompile, each GXT file is turned\n\
+back into UTF-8 source, <name>.txt. With dump, the blocks, keys and\n\
+strings of each GXT file are listed on stdout (--hex adds TDAT's bytes),\n\
+with problems such as keys that point outside of TDAT marked with '!!'.\n\
+With get, the string of each key is printed on a line of its own.\n\
+With diff, each key only in old is printed as -[KEY] string, each key only\n\
+in new as +[KEY] string, and each key whose string changed as both.\n\
+\nIn sources for vc and sa, a line [@NAME] puts the keys that follow in\n\
+mission table NAME; keys before any such line go in MAIN.\n\
 \nOptions:\n\
+    -j N        process up to N files at once (default: number of CPUs)\n\
+    -o DIR      write output files to DIR (default: current directory)\n\
+    --game GAME write files for GAME: gta3 (default), vc or sa; only gta3\n\
+                has a charset so far, so characters outside ASCII are\n\
+                given their gta3 glyph codes for vc and sa (with a note)\n\
+    --cache     keep a cache next to each compiled file and only re-encode\n\
+                entries that changed since the last build\n\
+    --dedupe    store equal strings (and strings that end another string)\n\
+                only once, and report the bytes saved\n\
+    --stats[=FMT] print how long each phase of each compile took and how\n\
+                much it allocated, as a table (default) or json\n\
+    --input-encoding ENC\n\
+                read sources as ENC: auto (default), latin1, utf-8,\n\
+                utf-16le or utf-16be\n\
     --help      show this help menu and exit\n\
     --version   display program version information and exit"
 
@@ -0,0 +1,50 @@
+/*
+ * Copyright (c) 2017 Wes Hampson <thehambone93@gmail.com>
+ *
+ * Licensed under the MIT License. See LICENSE at top level directory.
+ */
+
+#include <string.h>
+
+#include "hash.h"
+
+#define HASH_MULT   0xC6A4A7935BD1E995ULL
+#define HASH_SHIFT  47
+
+uint64_t hash64(const void *data, size_t len, uint64_t seed)
+{
+    const unsigned char *p = (const unsigned char *) data;
+    uint64_t h = seed ^ (len * HASH_MULT);
+
+    for (; len >= 8; len -= 8, p += 8)
+    {
+        uint64_t k;
+        memcpy(&k, p, sizeof(k));   /* Unaligned load */
+
+        k *= HASH_MULT;
+        k ^= k >> HASH_SHIFT;
+        k *= HASH_MULT;
+
+        h ^= k;
+        h *= HASH_MULT;
+    }
+
+    /* Mix in the remaining 0-7 bytes */
+    if (len > 0)
+    {
+        uint64_t k = 0;
+        for (size_t i = 0; i < len; i++)
+        {
+            k |= (uint64_t) p[i] << (i * 8);
+        }
+
+        h ^= k;
+        h *= HASH_MULT;
+    }
+
+    h ^= h >> HASH_SHIFT;
+    h *= HASH_MULT;
+    h ^= h >> HASH_SHIFT;
+
+    return h;
+}
@@ -0,0 +1,28 @@
+/*
+ * Copyright (c) 2017 Wes Hampson <thehambone93@gmail.com>
+ *
+ * Licensed under the MIT License. See LICENSE at top level directory.
+ */
+
+#ifndef _GXTMAKER_HASH_H_
+#define _GXTMAKER_HASH_H_
+
+#include <stdint.h>
+#include <stdlib.h>
+
+/**
+ * Computes a fast, non-cryptographic 64-bit hash of a buffer.
+ *
+ * The buffer is consumed 8 bytes at a time (MurmurHash64A mixing), so hashing
+ * runs at several GB/s. Results are only meant to be compared with results
+ * computed on the same kind of machine (byte order matters).
+ *
+ * @param data the data to hash
+ * @param len  the size of the data in bytes
+ * @param seed a value to perturb the hash with
+ *
+ * @return the hash value
+ */
+uint64_t hash64(const void *data, size_t len, uint64_t seed);
+
+#endif /* _GXTMAKER_HASH_H_ */
@@ -4,70 +4,361 @@
  * Licensed under the MIT License. See LICENSE at top level directory.
  */
 
+#if !defined(_WIN32)
+#define _POSIX_C_SOURCE 200809L
+#endif
+
 #include <stdio.h>
+#include <string.h>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <stdatomic.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#include <sys/stat.h>
 
 #include "io.h"
+#include "mem.h"
+
+/* Rows hex_dump() formats before writing them out */
+#define HEX_DUMP_CHUNK_ROWS 256
 
-#define NUM_BYTES_PER_LINE 16
-#define NUM_CHARS_PER_BYTE 3
+#define READ_BUF_INITIAL_SIZE (64 * 1024)
 
 #define MIN(a, b) ((a < b) ? (a) : (b))
 
+/* Longest suffix write_file_atomic() adds to a path: ".<pid>-<n>.tmp", both
+   numbers unsigned 32-bit */
+#define TMP_SUFFIX_MAX_LEN (1 + 10 + 1 + 10 + 4)
+
+/* The two hex digits of every byte value */
+static const char hex_pairs[] =
+    "000102030405060708090a0b0c0d0e0f101112131415161718191a1b1c1d1e1f"
+    "202122232425262728292a2b2c2d2e2f303132333435363738393a3b3c3d3e3f"
+    "404142434445464748494a4b4c4d4e4f505152535455565758595a5b5c5d5e5f"
+    "606162636465666768696a6b6c6d6e6f707172737475767778797a7b7c7d7e7f"
+    "808182838485868788898a8b8c8d8e8f909192939495969798999a9b9c9d9e9f"
+    "a0a1a2a3a4a5a6a7a8a9aaabacadaeafb0b1b2b3b4b5b6b7b8b9babbbcbdbebf"
+    "c0c1c2c3c4c5c6c7c8c9cacbcccdcecfd0d1d2d3d4d5d6d7d8d9dadbdcdddedf"
+    "e0e1e2e3e4e5e6e7e8e9eaebecedeeeff0f1f2f3f4f5f6f7f8f9fafbfcfdfeff";
+
+#if defined(_WIN32)
+static bool read_file(const char *path, struct mapped_file *mf);
+#else
+static bool read_fd(int fd, struct mapped_file *mf);
+#endif
+
+/* Temporary files written so far, so that each gets a name of its own */
+#if defined(_WIN32)
+static volatile LONG num_tmp_files;
+#else
+static atomic_uint num_tmp_files;
+#endif
+
 void hex_dump(const void *buf, size_t size)
 {
-    const char *b = (char *) buf;
+    /* Rows are formatted a chunk at a time and written in one go */
+    char out[HEX_DUMP_CHUNK_ROWS * (HEX_ROW_SIZE + 1)];
+    const char *b = (const char *) buf;
+    size_t off = 0;
 
-    char c;
-    int i;
-    int row_len;
-    int pad_len;
-    unsigned int off = 0;
+    while (off < size)
+    {
+        size_t n = MIN(HEX_DUMP_CHUNK_ROWS * HEX_ROW_BYTES, size - off);
+        fwrite(out, hex_format(out, b + off, n, (uint32_t) off), 1, stdout);
+        off += n;
+    }
+}
 
-    do
+size_t hex_format(char *dest, const void *buf, size_t size, uint32_t offset)
+{
+    const char *b = (const char *) buf;
+    char *p = dest;
+
+    for (size_t off = 0; off < size; off += HEX_ROW_BYTES)
     {
-        /* Print current offset in buffer */
-        printf("%08x  ", off);
+        p += hex_format_row(p, b + off, MIN(HEX_ROW_BYTES, size - off),
+                            offset + (uint32_t) off, true);
+        *p++ = '\n';
+    }
 
-        /* Print a line of bytes in hexadecimal */
-        row_len = MIN(NUM_BYTES_PER_LINE, size - off);
-        for (i = 0; i < row_len; i++)
+    return p - dest;
+}
+
+size_t hex_format_row(char *dest, const void *buf, size_t size,
+                      uint32_t offset, bool ascii)
+{
+    const unsigned char *b = (const unsigned char *) buf;
+    char *p = dest;
+
+    /* Offset, big-endian */
+    for (int shift = 24; shift >= 0; shift -= 8)
+    {
+        memcpy(p, hex_pairs + ((offset >> shift) & 0xFF) * 2, 2);
+        p += 2;
+    }
+    *p++ = ' ';
+    *p++ = ' ';
+
+    /* Bytes in hexadecimal, padded out to a full row */
+    for (size_t i = 0; i < HEX_ROW_BYTES; i++)
+    {
+        if (i < size)
         {
-            printf("%02x", b[off + i] & 0xFF);
-            if (i != row_len - 1)
-            {
-                printf(" ");
-            }
+            memcpy(p, hex_pairs + b[i] * 2, 2);
         }
+        else
+        {
+            p[0] = ' ';
+            p[1] = ' ';
+        }
+        p[2] = ' ';
+        p += 3;
+    }
+    *p++ = ' ';
 
-        /* Print padding spaces */
-        pad_len = (NUM_BYTES_PER_LINE - row_len) * NUM_CHARS_PER_BYTE;
-        for (i = 0; i < pad_len; i++)
+    /* Bytes as ASCII, with non-printing characters replaced by '.' */
+    if (ascii)
+    {
+        for (size_t i = 0; i < size; i++)
         {
-            printf(" ");
+            *p++ = (b[i] >= 0x20 && b[i] < 0x7F) ? (char) b[i] : '.';
         }
-        printf("  ");
+    }
+
+    return p - dest;
+}
+
+#if defined(_WIN32)
 
-        /* Print bytes in ASCII representation */
-        /* Replace non-printing characters with '.' */
-        for (i = 0; i < row_len; i++)
+bool map_file(const char *path, struct mapped_file *mf)
+{
+    return read_file(path, mf);
+}
+
+/**
+ * Reads an entire file into a heap buffer using stdio.
+ */
+static bool read_file(const char *path, struct mapped_file *mf)
+{
+    FILE *f = fopen(path, "rb");
+    if (f == NULL)
+    {
+        return false;
+    }
+
+    char *buf = NULL;
+    size_t size = 0;
+    size_t cap = 0;
+    size_t n;
+
+    do
+    {
+        if (size == cap)
         {
-            c = b[off + i];
-            if (c < 0x20 || c > 0x7F)
+            cap = (cap == 0) ? READ_BUF_INITIAL_SIZE : cap * 2;
+            char *new_buf = (char *) mem_realloc(buf, cap);
+            if (new_buf == NULL)
             {
-                printf(".");
+                free(buf);
+                fclose(f);
+                return false;
             }
-            else
+            buf = new_buf;
+        }
+
+        n = fread(buf + size, 1, cap - size, f);
+        size += n;
+    }
+    while (n > 0);
+
+    bool ok = !ferror(f);
+    fclose(f);
+    if (!ok)
+    {
+        free(buf);
+        return false;
+    }
+
+    mf->data = buf;
+    mf->size = size;
+    mf->is_mapped = false;
+
+    return true;
+}
+
+#else
+
+bool map_file(const char *path, struct mapped_file *mf)
+{
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+    {
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0)
+    {
+        close(fd);
+        return false;
+    }
+
+    /* Only regular, non-empty files can be mapped; everything else
+       (pipes, character devices, empty files) goes through read(). */
+    if (S_ISREG(st.st_mode) && st.st_size > 0)
+    {
+        void *p = mmap(NULL, (size_t) st.st_size, PROT_READ, MAP_PRIVATE,
+                       fd, 0);
+        if (p != MAP_FAILED)
+        {
+            posix_madvise(p, (size_t) st.st_size, POSIX_MADV_SEQUENTIAL);
+            close(fd);
+
+            mf->data = (const char *) p;
+            mf->size = (size_t) st.st_size;
+            mf->is_mapped = true;
+
+            return true;
+        }
+    }
+
+    bool ok = read_fd(fd, mf);
+    close(fd);
+
+    return ok;
+}
+
+/**
+ * Reads everything from a file descriptor into a heap buffer.
+ */
+static bool read_fd(int fd, struct mapped_file *mf)
+{
+    char *buf = NULL;
+    size_t size = 0;
+    size_t cap = 0;
+    ssize_t n;
+
+    for (;;)
+    {
+        if (size == cap)
+        {
+            cap = (cap == 0) ? READ_BUF_INITIAL_SIZE : cap * 2;
+            char *new_buf = (char *) mem_realloc(buf, cap);
+            if (new_buf == NULL)
             {
-                printf("%c", c);
+                free(buf);
+                return false;
             }
+            buf = new_buf;
         }
 
-        /* Increase offset and print newline */
-        off += row_len;
-        if (off < size)
+        n = read(fd, buf + size, cap - size);
+        if (n == 0)
         {
-            printf("\n");
+            break;
         }
+        else if (n < 0)
+        {
+            free(buf);
+            return false;
+        }
+
+        size += (size_t) n;
+    }
+
+    mf->data = buf;
+    mf->size = size;
+    mf->is_mapped = false;
+
+    return true;
+}
+
+#endif /* _WIN32 */
+
+void unmap_file(struct mapped_file *mf)
+{
+#if !defined(_WIN32)
+    if (mf->is_mapped)
+    {
+        munmap((void *) mf->data, mf->size);
+    }
+    else
+#endif
+    {
+        free((void *) mf->data);
     }
-    while (off < size);
+
+    mf->data = NULL;
+    mf->size = 0;
+    mf->is_mapped = false;
+}
+
+bool stat_file(const char *path, uint64_t *size, int64_t *mtime)
+{
+    struct stat st;
+    if (stat(path, &st) != 0)
+    {
+        return false;
+    }
+
+    *size = (uint64_t) st.st_size;
+    *mtime = (int64_t) st.st_mtime;
+
+    return true;
+}
+
+bool write_file_atomic(const char *path, const void *data, size_t size)
+{
+    /* The temporary file is named after this process and call, so that two
+       writers of the same file never write to the same temporary file */
+#if defined(_WIN32)
+    unsigned int pid = (unsigned int) GetCurrentProcessId();
+    unsigned int n = (unsigned int) InterlockedIncrement(&num_tmp_files);
+#else
+    unsigned int pid = (unsigned int) getpid();
+    unsigned int n = atomic_fetch_add_explicit(&num_tmp_files, 1,
+                                               memory_order_relaxed);
+#endif
+
+    size_t path_len = strlen(path);
+    char *tmp_path = (char *) mem_malloc(path_len + TMP_SUFFIX_MAX_LEN + 1);
+    if (tmp_path == NULL)
+    {
+        return false;
+    }
+    sprintf(tmp_path, "%s.%u-%u.tmp", path, pid, n);
+
+    FILE *f = fopen(tmp_path, "wb");
+    if (f == NULL)
+    {
+        free(tmp_path);
+        return false;
+    }
+
+    bool ok = size == 0 || fwrite(data, size, 1, f) == 1;
+    ok = (fclose(f) == 0) && ok;
+
+#if defined(_WIN32)
+    /* rename() won't replace an existing file on Windows */
+    if (ok)
+    {
+        remove(path);
+    }
+#endif
+
+    ok = ok && rename(tmp_path, path) == 0;
+    if (!ok)
+    {
+        remove(tmp_path);
+    }
+
+    free(tmp_path);
+
+    return ok;
 }
@@ -7,14 +7,122 @@
 #ifndef _GXTMAKER_IO_H_
 #define _GXTMAKER_IO_H_
 
+#include <stdbool.h>
+#include <stdint.h>
 #include <stdlib.h>
 
 /**
- * Dumps the contents of a buffer to stdout byte-by-byte.
+ * A read-only view of an entire file's contents.
+ *
+ * Where possible the file is memory-mapped, so the view is backed directly by
+ * the page cache and no copy is made. Otherwise the file is read into a heap
+ * buffer. Either way, the data remains valid until unmap_file() is called.
+ */
+struct mapped_file
+{
+    const char *data;       /* File contents (NULL if the file is empty). */
+    size_t size;            /* File size in bytes. */
+    bool is_mapped;         /* true if memory-mapped, false if heap copy. */
+};
+
+/* Bytes shown on each row of a hex dump */
+#define HEX_ROW_BYTES 16
+
+/* Most chars in a row of a hex dump with an ASCII column, not counting the
+   newline: an 8-digit offset, the bytes in hex, then the bytes as ASCII */
+#define HEX_ROW_SIZE (8 + 2 + HEX_ROW_BYTES * 3 + 1 + HEX_ROW_BYTES)
+
+/**
+ * Prints a hex dump of a buffer to stdout, with the offset of each row and
+ * the row's bytes as ASCII.
  *
  * @param buf  the buffer to print
  * @param size the size in bytes of the buffer
  */
 void hex_dump(const void *buf, size_t size);
 
+/**
+ * Formats a buffer as a hex dump, one row for every HEX_ROW_BYTES bytes, each
+ * row ending in a newline.
+ *
+ * @param dest   where to store the text; must have room for HEX_ROW_SIZE + 1
+ *               chars per row
+ * @param buf    the buffer to format
+ * @param size   the size in bytes of the buffer
+ * @param offset the offset to show for the first byte
+ *
+ * @return the number of chars stored
+ */
+size_t hex_format(char *dest, const void *buf, size_t size, uint32_t offset);
+
+/**
+ * Formats a single row of a hex dump, without a newline. The hex column is
+ * always padded to its full width, so that whatever is written after it
+ * lines up from row to row.
+ *
+ * @param dest   where to store the text; must have room for HEX_ROW_SIZE
+ *               chars
+ * @param buf    the bytes to format
+ * @param size   the number of bytes (at most HEX_ROW_BYTES)
+ * @param offset the offset to show for the row
+ * @param ascii  true to follow the hex column with the bytes as ASCII
+ *
+ * @return the number of chars stored
+ */
+size_t hex_format_row(char *dest, const void *buf, size_t size,
+                      uint32_t offset, bool ascii);
+
+/**
+ * Opens a file and makes its entire contents available in memory.
+ *
+ * The file is memory-mapped and the kernel is advised that it will be read
+ * sequentially. If the file cannot be mapped (e.g. it is a pipe or the
+ * platform has no mmap), it is read into a heap buffer instead.
+ *
+ * @param path the path to the file
+ * @param mf   a pointer to the mapped file to be filled in
+ *
+ * @return true  if the file contents are available
+ *         false if the file could not be opened or read
+ */
+bool map_file(const char *path, struct mapped_file *mf);
+
+/**
+ * Releases a file view created by map_file().
+ *
+ * @param mf the mapped file to release
+ */
+void unmap_file(struct mapped_file *mf);
+
+/**
+ * Gets the size and last modification time of a file.
+ *
+ * @param path  the path to the file
+ * @param size  a pointer to where the file size should be stored
+ * @param mtime a pointer to where the modification time (in seconds since the
+ *              epoch) should be stored
+ *
+ * @return true  if the file information was retrieved
+ *         false if the file does not exist or could not be queried
+ */
+bool stat_file(const char *path, uint64_t *size, int64_t *mtime);
+
+/**
+ * Writes a buffer to a file, replacing the file all at once.
+ *
+ * The data is written to a temporary file next to it, "<path>.<pid>-<n>.tmp",
+ * which is then renamed to path, so anything reading the file sees either its
+ * old contents or the new ones, never a partly written file. Each call uses
+ * a temporary file of its own, so two writers of the same path never mix
+ * their data.
+ *
+ * @param path the path to the file
+ * @param data the data to write
+ * @param size the size of the data in bytes
+ *
+ * @return true  if the file was written
+ *         false if the file could not be written (it is left as it was)
+ */
+bool write_file_atomic(const char *path, const void *data, size_t size);
+
 #endif /* _GXTMAKER_IO_H_ */
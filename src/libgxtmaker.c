@@ -0,0 +1,128 @@
+/*
+ * Copyright (c) 2017 Wes Hampson <thehambone93@gmail.com>
+ *
+ * Licensed under the MIT License. See LICENSE at top level directory.
+ */
+
+#include <string.h>
+
+#include "arena.h"
+#include "libgxtmaker.h"
+
+struct gxtmaker_s   /* typedef'd in libgxtmaker.h as 'gxtmaker' */
+{
+    struct allocator alloc;
+    arena *arena;           /* Memory for each compilation. */
+    struct diag_buf diag;   /* Passes messages to the diagnostics function. */
+};
+
+static void discard_message(void *ctx, const char *msg);
+static void set_options(const gxtmaker *g, const struct compile_options *opts,
+                        struct compile_options *o);
+
+bool gxtmaker_create(gxtmaker **g, const struct allocator *alloc,
+                     diag_fn diag, void *diag_ctx)
+{
+    if (alloc == NULL)
+    {
+        alloc = &mem_heap_allocator;
+    }
+
+    *g = (gxtmaker *) alloc->alloc(alloc->ctx, sizeof(gxtmaker));
+    if (*g == NULL)
+    {
+        return false;
+    }
+
+    memset(*g, 0, sizeof(gxtmaker));
+    (*g)->alloc = *alloc;
+    (*g)->diag.fn = (diag != NULL) ? diag : discard_message;
+    (*g)->diag.fn_ctx = diag_ctx;
+
+    if (!arena_create_with(&(*g)->arena, alloc))
+    {
+        alloc->free(alloc->ctx, *g, sizeof(gxtmaker));
+        *g = NULL;
+        return false;
+    }
+
+    return true;
+}
+
+bool gxtmaker_destroy(gxtmaker **g)
+{
+    if (*g == NULL)
+    {
+        return false;
+    }
+
+    struct allocator alloc = (*g)->alloc;
+
+    arena_destroy(&(*g)->arena);
+    alloc.free(alloc.ctx, *g, sizeof(gxtmaker));
+    *g = NULL;
+
+    return true;
+}
+
+int gxtmaker_compile(gxtmaker *g, const char *name,
+                     const char *src, size_t src_size,
+                     const struct compile_options *opts,
+                     char **out, size_t *out_size)
+{
+    struct compile_options o;
+    set_options(g, opts, &o);
+
+    return compile_buffer(name, src, src_size, out, out_size, &o, &g->diag);
+}
+
+void gxtmaker_free(gxtmaker *g, char *out, size_t out_size)
+{
+    if (out != NULL)
+    {
+        g->alloc.free(g->alloc.ctx, out, out_size);
+    }
+}
+
+int gxtmaker_compile_file(gxtmaker *g, const char *src_file,
+                          const char *out_file,
+                          const struct compile_options *opts)
+{
+    struct compile_options o;
+    set_options(g, opts, &o);
+
+    return compile(src_file, out_file, &o, &g->diag);
+}
+
+int gxtmaker_decompile_file(gxtmaker *g, const char *gxt_file,
+                            const char *out_file)
+{
+    return decompile(gxt_file, out_file, &g->diag);
+}
+
+static void discard_message(void *ctx, const char *msg)
+{
+    (void) ctx;
+    (void) msg;
+}
+
+/**
+ * Makes a copy of the caller's compilation settings that compiles with the
+ * instance's memory.
+ */
+static void set_options(const gxtmaker *g, const struct compile_options *opts,
+                        struct compile_options *o)
+{
+    if (opts != NULL)
+    {
+        *o = *opts;
+    }
+    else
+    {
+        memset(o, 0, sizeof(struct compile_options));
+        o->num_threads = 1;
+    }
+
+    o->arena = g->arena;
+    o->allocator = NULL;
+}
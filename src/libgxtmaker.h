@@ -0,0 +1,123 @@
+/*
+ * Copyright (c) 2017 Wes Hampson <thehambone93@gmail.com>
+ *
+ * Licensed under the MIT License. See LICENSE at top level directory.
+ */
+
+/**
+ * Declarations for libgxtmaker, the interface for programs that compile GXT
+ * files themselves instead of running gxtmaker.
+ *
+ * Work is done through a gxtmaker instance, which has its own memory, taken
+ * from the allocation functions it was created with, and its own diagnostics
+ * function. Memory is reused from one compilation to the next. An instance
+ * may only be used by one thread at a time, but any number of instances may
+ * be used at once on different threads.
+ *
+ * Nothing is printed; every diagnostic goes to the instance's diagnostics
+ * function.
+ */
+
+#ifndef _GXTMAKER_LIBGXTMAKER_H_
+#define _GXTMAKER_LIBGXTMAKER_H_
+
+#include <stdbool.h>
+#include <stdlib.h>
+
+#include "compiler.h"
+#include "decompiler.h"
+#include "errwarn.h"
+#include "mem.h"
+
+typedef struct gxtmaker_s gxtmaker;
+
+/**
+ * Creates a gxtmaker instance.
+ *
+ * gxtmaker_destroy() should be called when the instance is no longer needed.
+ *
+ * @param g        a pointer to the instance to be created
+ * @param alloc    the allocation functions to get memory from (copied into
+ *                 the instance; use NULL for the heap). They must be safe to
+ *                 call from any thread if files are compiled with more than
+ *                 one thread.
+ * @param diag     the function to pass diagnostics to
+ *                 (use NULL to discard them)
+ * @param diag_ctx the context pointer to pass to diag
+ *
+ * @return true  if the instance was created
+ *         false if the instance could not be created
+ */
+bool gxtmaker_create(gxtmaker **g, const struct allocator *alloc,
+                     diag_fn diag, void *diag_ctx);
+
+/**
+ * Releases all memory held by a gxtmaker instance and deletes it.
+ *
+ * @param g a pointer to the instance to be deleted
+ *
+ * @return true  if the instance was deleted
+ *         false if the instance was never initialized
+ */
+bool gxtmaker_destroy(gxtmaker **g);
+
+/**
+ * Compiles GXT source held in memory into a GXT file held in memory (see
+ * compile_buffer()).
+ *
+ * @param g        the instance to compile with
+ * @param name     the name of the source (for diagnostics)
+ * @param src      the source contents
+ * @param src_size the size of the source in bytes
+ * @param opts     the compilation settings (use NULL for defaults);
+ *                 use_cache, arena and allocator are ignored
+ * @param out      a pointer to where the compiled file should be stored
+ *                 (to be released with gxtmaker_free())
+ * @param out_size a pointer to where the size of the compiled file should be
+ *                 stored
+ *
+ * @return 0 if compilation was successful, otherwise a compiler_status
+ */
+int gxtmaker_compile(gxtmaker *g, const char *name,
+                     const char *src, size_t src_size,
+                     const struct compile_options *opts,
+                     char **out, size_t *out_size);
+
+/**
+ * Releases a compiled file returned by gxtmaker_compile().
+ *
+ * @param g        the instance that compiled the file
+ * @param out      the compiled file (may be NULL)
+ * @param out_size the size of the compiled file
+ */
+void gxtmaker_free(gxtmaker *g, char *out, size_t out_size);
+
+/**
+ * Compiles a GXT source file into a GXT file (see compile()).
+ *
+ * @param g        the instance to compile with
+ * @param src_file the path to the source file
+ * @param out_file the path to the compiled file
+ * @param opts     the compilation settings (use NULL for defaults);
+ *                 arena and allocator are ignored
+ *
+ * @return 0 if compilation was successful, otherwise a compiler_status
+ */
+int gxtmaker_compile_file(gxtmaker *g, const char *src_file,
+                          const char *out_file,
+                          const struct compile_options *opts);
+
+/**
+ * Decompiles a GXT file into GXT source (see decompile()). Memory for
+ * decompiling comes from the heap.
+ *
+ * @param g        the instance to report diagnostics through
+ * @param gxt_file the path to the GXT file
+ * @param out_file the path to the source file to write
+ *
+ * @return 0 if decompilation was successful, otherwise a decompiler_status
+ */
+int gxtmaker_decompile_file(gxtmaker *g, const char *gxt_file,
+                            const char *out_file);
+
+#endif /* _GXTMAKER_LIBGXTMAKER_H_ */
@@ -0,0 +1,115 @@
+/*
+ * Copyright (c) 2017 Wes Hampson <thehambone93@gmail.com>
+ *
+ * Licensed under the MIT License. See LICENSE at top level directory.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "charset.h"
+#include "decompiler.h"
+#include "errwarn.h"
+#include "gxt.h"
+#include "lookup.h"
+
+/* Initial size of the buffer strings are decoded into */
+#define LOOKUP_BUF_SIZE 4096
+
+int lookup_keys(const char *gxt_file, const char * const *keys, int num_keys,
+                FILE *stream, struct diag_buf *diag)
+{
+    struct gxt_reader gxt;
+    int status = open_gxt(gxt_file, &gxt, diag);
+    if (status != DECOMPILE_SUCCESS)
+    {
+        return status;
+    }
+
+    size_t buf_size = LOOKUP_BUF_SIZE;
+    char *buf = (char *) malloc(buf_size);
+    if (buf == NULL)
+    {
+        gxt_close(&gxt);
+        return DECOMPILE_OUT_OF_MEMORY;
+    }
+
+    for (int i = 0; i < num_keys; i++)
+    {
+        int result;
+        const struct gxt_key *key = gxt_find_key(&gxt, keys[i]);
+        if (key == NULL)
+        {
+            error_f(diag, E_KEY_NOT_FOUND, gxt_file, -1, -1, keys[i]);
+            result = DECOMPILE_KEY_NOT_FOUND;
+        }
+        else
+        {
+            result = print_key_string(&gxt, gxt_file, key, &buf, &buf_size,
+                                      stream, diag);
+        }
+
+        if (result != DECOMPILE_SUCCESS)
+        {
+            fputc('\n', stream);
+            if (status == DECOMPILE_SUCCESS)
+            {
+                status = result;
+            }
+        }
+        if (result == DECOMPILE_OUT_OF_MEMORY)
+        {
+            break;
+        }
+    }
+
+    free(buf);
+    gxt_close(&gxt);
+
+    return status;
+}
+
+int print_key_string(const struct gxt_reader *gxt, const char *gxt_file,
+                     const struct gxt_key *key, char **buf, size_t *buf_size,
+                     FILE *stream, struct diag_buf *diag)
+{
+    const struct charset *cs = charset_for_game(GXT_GAME_GTA3, NULL);
+
+    size_t len;
+    const gxt_char *str = gxt_get_string(gxt, key, &len);
+    if (str == NULL)
+    {
+        error_f(diag, E_INVALID_GXT, gxt_file, -1, -1,
+                describe_bad_string(gxt, key));
+        return DECOMPILE_INVALID_GXT;
+    }
+
+    /* The text is at most 4 bytes per char, plus the newline */
+    if (len * 4 + 1 > *buf_size)
+    {
+        size_t new_size = len * 4 + 1;
+        char *new_buf = (char *) realloc(*buf, new_size);
+        if (new_buf == NULL)
+        {
+            return DECOMPILE_OUT_OF_MEMORY;
+        }
+        *buf = new_buf;
+        *buf_size = new_size;
+    }
+
+    size_t text_len;
+    size_t done = charset_decode(cs, (const char *) str, len, *buf,
+                                 &text_len);
+    if (done < len)
+    {
+        const unsigned char *g = (const unsigned char *) (str + done);
+        error_f(diag, E_UNDECODABLE_GLYPH, gxt_file, -1, -1, key->name,
+                (unsigned int) (g[0] | (g[1] << 8)), cs->name);
+        return DECOMPILE_UNDECODABLE_GLYPH;
+    }
+
+    (*buf)[text_len++] = '\n';
+    fwrite(*buf, 1, text_len, stream);
+
+    return DECOMPILE_SUCCESS;
+}
@@ -0,0 +1,65 @@
+/*
+ * Copyright (c) 2017 Wes Hampson <thehambone93@gmail.com>
+ *
+ * Licensed under the MIT License. See LICENSE at top level directory.
+ */
+
+#ifndef _GXTMAKER_LOOKUP_H_
+#define _GXTMAKER_LOOKUP_H_
+
+#include <stdio.h>
+
+#include "decompiler.h"
+#include "errwarn.h"
+#include "gxt.h"
+
+/*
+ * Prints the strings of some of the keys in a GXT file.
+ *
+ * Each string is printed on a line of its own, decoded as UTF-8, in the
+ * order the keys are given. A key that can't be found (or whose string can't
+ * be decoded) is reported and gets an empty line, so the output always has
+ * one line per key. The file is memory-mapped and each key is found with a
+ * binary search of TKEY, so only the parts of the file that are needed are
+ * read.
+ *
+ * Only GTA3-style files (a single TKEY and TDAT) can be read.
+ *
+ * @param gxt_file the path to the GXT file
+ * @param keys     the names of the keys to look up (case-sensitive)
+ * @param num_keys the number of keys
+ * @param stream   the stream to print the strings to
+ * @param diag     the buffer to write diagnostics to
+ *                 (use NULL to print them to the standard error stream)
+ *
+ * @return 0 if every string was printed, DECOMPILE_KEY_NOT_FOUND if a key
+ *         wasn't found, otherwise another decompiler_status
+ */
+int lookup_keys(const char *gxt_file, const char * const *keys, int num_keys,
+                FILE *stream, struct diag_buf *diag);
+
+/**
+ * Decodes the string a key points to and prints it as UTF-8, followed by a
+ * newline.
+ *
+ * @param gxt      the GXT file the key is from
+ * @param gxt_file the path to the GXT file (for diagnostics)
+ * @param key      the key
+ * @param buf      a pointer to the buffer to decode into (allocated with
+ *                 malloc()), which is grown if the string doesn't fit
+ * @param buf_size a pointer to the size of the buffer in bytes
+ * @param stream   the stream to print the string to
+ * @param diag     the buffer to write diagnostics to
+ *                 (use NULL to print them to the standard error stream)
+ *
+ * @return DECOMPILE_SUCCESS if the string was printed,
+ *         DECOMPILE_INVALID_GXT if the key doesn't point to a string,
+ *         DECOMPILE_UNDECODABLE_GLYPH if the string contains a glyph that is
+ *         not in the charset (either of which is reported and nothing is
+ *         printed), DECOMPILE_OUT_OF_MEMORY if the buffer couldn't be grown
+ */
+int print_key_string(const struct gxt_reader *gxt, const char *gxt_file,
+                     const struct gxt_key *key, char **buf, size_t *buf_size,
+                     FILE *stream, struct diag_buf *diag);
+
+#endif /* _GXTMAKER_LOOKUP_H_ */
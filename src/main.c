@@ -4,15 +4,33 @@
  * Licensed under the MIT License. See LICENSE at top level directory.
  */
 
+#include <stdbool.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
+#include "batch.h"
 #include "compiler.h"
+#include "diff.h"
+#include "dump.h"
 #include "errwarn.h"
 #include "gxtmaker.h"
 #include "gxt.h"
+#include "lookup.h"
+#include "mem.h"
+#include "pool.h"
+#include "stats.h"
+#include "watch.h"
 
-#include "list.h"
+#define MAX_JOBS 256
+
+static bool parse_num_jobs(const char *str, int *num_jobs);
+static bool is_compile_option(const char *arg);
+static bool parse_stats_format(const char *str, enum stats_format *format);
+static int dump_files(const char * const *gxt_files, int num_files,
+                      bool show_data);
+static int get_strings(const char * const *args, int num_args);
+static int diff_files(const char * const *args, int num_args);
 
 void show_help_info(void)
 {
@@ -33,23 +51,319 @@ void show_version_info(void)
 
 int main(int argc, char *argv[])
 {
-    if (argc < 2)
+    const char **src_files = (const char **) malloc(argc * sizeof(char *));
+    int num_files = 0;
+    const char *out_dir = ".";
+    const char *watch_dir = NULL;
+    int num_jobs = pool_num_cpus();
+    struct compile_options opts = { 0 };
+    enum stats_format stats_format = STATS_NONE;
+
+    /* "gxtmaker decompile file.gxt..." turns GXT files back into source, and
+       "gxtmaker dump file.gxt..." shows what is in them */
+    bool decompiling = argc > 1 && strcmp(argv[1], "decompile") == 0;
+    bool dumping = argc > 1 && strcmp(argv[1], "dump") == 0;
+    bool dump_data = false;
+
+    if (src_files == NULL)
+    {
+        return GXTMAKER_EXIT_ARGUMENT_ERROR;
+    }
+
+    /* "gxtmaker get file.gxt key..." prints strings from a GXT file; every
+       argument after the file is a key, even if it looks like an option */
+    if (argc > 1 && strcmp(argv[1], "get") == 0)
+    {
+        free(src_files);
+        return get_strings((const char * const *) argv + 2, argc - 2);
+    }
+
+    /* "gxtmaker diff old.gxt new.gxt" shows how the strings changed */
+    if (argc > 1 && strcmp(argv[1], "diff") == 0)
+    {
+        free(src_files);
+        return diff_files((const char * const *) argv + 2, argc - 2);
+    }
+
+    for (int i = (decompiling || dumping) ? 2 : 1; i < argc; i++)
     {
-        error(E_MISSING_INPUT_FILE);
+        const char *arg = argv[i];
+
+        if (dumping && strcmp(arg, "--hex") == 0)
+        {
+            dump_data = true;
+        }
+        else if ((decompiling && is_compile_option(arg))
+                 || (dumping && arg[0] == '-' && arg[1] != '\0'
+                     && strcmp(arg, "--help") != 0
+                     && strcmp(arg, "--version") != 0))
+        {
+            error(NULL, E_UNKNOWN_OPTION, arg);
+            free(src_files);
+            return GXTMAKER_EXIT_ARGUMENT_ERROR;
+        }
+        else if (strcmp(arg, "--version") == 0)
+        {
+            show_version_info();
+            free(src_files);
+            return GXTMAKER_EXIT_SUCCESS;
+        }
+        else if (strcmp(arg, "--help") == 0)
+        {
+            show_help_info();
+            free(src_files);
+            return GXTMAKER_EXIT_SUCCESS;
+        }
+        else if (strcmp(arg, "--cache") == 0)
+        {
+            opts.use_cache = true;
+        }
+        else if (strcmp(arg, "--dedupe") == 0)
+        {
+            opts.dedupe = true;
+        }
+        else if (strncmp(arg, "--stats", 7) == 0
+                 && (arg[7] == '\0' || arg[7] == '='))
+        {
+            if (!parse_stats_format(arg + 7, &stats_format))
+            {
+                error(NULL, E_INVALID_ARGUMENT, arg + 8, "--stats");
+                free(src_files);
+                return GXTMAKER_EXIT_ARGUMENT_ERROR;
+            }
+        }
+        else if (strcmp(arg, "-o") == 0 || strcmp(arg, "-j") == 0
+                 || strcmp(arg, "--input-encoding") == 0
+                 || strcmp(arg, "--game") == 0
+                 || strcmp(arg, "--watch") == 0)
+        {
+            if (i + 1 >= argc)
+            {
+                error(NULL, E_MISSING_ARGUMENT, arg);
+                free(src_files);
+                return GXTMAKER_EXIT_ARGUMENT_ERROR;
+            }
+
+            const char *val = argv[++i];
+            if (arg[1] == 'o')
+            {
+                out_dir = val;
+            }
+            else if (strcmp(arg, "--watch") == 0)
+            {
+                watch_dir = val;
+            }
+            else if (strcmp(arg, "--game") == 0)
+            {
+                if (!gxt_parse_game(val, &opts.game))
+                {
+                    error(NULL, E_INVALID_ARGUMENT, val, arg);
+                    free(src_files);
+                    return GXTMAKER_EXIT_ARGUMENT_ERROR;
+                }
+            }
+            else if (arg[1] == '-')
+            {
+                if (!parse_encoding(val, &opts.input_encoding))
+                {
+                    error(NULL, E_INVALID_ARGUMENT, val, arg);
+                    free(src_files);
+                    return GXTMAKER_EXIT_ARGUMENT_ERROR;
+                }
+            }
+            else if (!parse_num_jobs(val, &num_jobs))
+            {
+                error(NULL, E_INVALID_ARGUMENT, val, arg);
+                free(src_files);
+                return GXTMAKER_EXIT_ARGUMENT_ERROR;
+            }
+        }
+        else if (strncmp(arg, "-j", 2) == 0)
+        {
+            /* Also accept the -jN form */
+            if (!parse_num_jobs(arg + 2, &num_jobs))
+            {
+                error(NULL, E_INVALID_ARGUMENT, arg + 2, "-j");
+                free(src_files);
+                return GXTMAKER_EXIT_ARGUMENT_ERROR;
+            }
+        }
+        else if (arg[0] == '-' && arg[1] != '\0')
+        {
+            error(NULL, E_UNKNOWN_OPTION, arg);
+            free(src_files);
+            return GXTMAKER_EXIT_ARGUMENT_ERROR;
+        }
+        else
+        {
+            src_files[num_files++] = arg;
+        }
+    }
+
+    if (watch_dir != NULL && num_files > 0)
+    {
+        error(NULL, E_UNEXPECTED_INPUT_FILE, src_files[0], watch_dir);
+        free(src_files);
         return GXTMAKER_EXIT_ARGUMENT_ERROR;
     }
-    else if (strcmp(argv[1], "--version") == 0)
+    else if (watch_dir == NULL && num_files == 0)
     {
-        show_version_info();
-        return GXTMAKER_EXIT_SUCCESS;
+        error(NULL, E_MISSING_INPUT_FILE);
+        free(src_files);
+        return GXTMAKER_EXIT_ARGUMENT_ERROR;
     }
-    else if (strcmp(argv[1], "--help") == 0)
+
+    if (stats_format != STATS_NONE)
     {
-        show_help_info();
-        return GXTMAKER_EXIT_SUCCESS;
+        mem_count_allocations(true);
+    }
+
+    if (dumping)
+    {
+        int status = dump_files(src_files, num_files, dump_data);
+        free(src_files);
+        return status;
+    }
+    else if (watch_dir != NULL)
+    {
+        free(src_files);
+        return watch_directory(watch_dir, out_dir, num_jobs, &opts,
+                               stats_format);
+    }
+
+    int status = decompiling
+        ? decompile_batch(src_files, num_files, out_dir, num_jobs)
+        : compile_batch(src_files, num_files, out_dir, num_jobs, &opts,
+                        stats_format);
+
+    free(src_files);
+
+    return status;
+}
+
+/**
+ * Parses the argument to -j, which must be a positive integer.
+ */
+static bool parse_num_jobs(const char *str, int *num_jobs)
+{
+    char *end;
+    long n = strtol(str, &end, 10);
+    if (*str == '\0' || *end != '\0' || n < 1 || n > MAX_JOBS)
+    {
+        return false;
+    }
+
+    *num_jobs = (int) n;
+
+    return true;
+}
+
+/**
+ * Checks whether an option only applies when compiling.
+ */
+static bool is_compile_option(const char *arg)
+{
+    return strcmp(arg, "--cache") == 0 || strcmp(arg, "--dedupe") == 0
+        || strcmp(arg, "--game") == 0
+        || strcmp(arg, "--input-encoding") == 0
+        || strncmp(arg, "--stats", 7) == 0
+        || strcmp(arg, "--watch") == 0;
+}
+
+/**
+ * Parses what follows "--stats": nothing, "=table" or "=json".
+ */
+static bool parse_stats_format(const char *str, enum stats_format *format)
+{
+    if (*str == '\0' || strcmp(str, "=table") == 0)
+    {
+        *format = STATS_TABLE;
+        return true;
+    }
+    else if (strcmp(str, "=json") == 0)
+    {
+        *format = STATS_JSON;
+        return true;
+    }
+
+    return false;
+}
+
+/**
+ * Dumps each GXT file to stdout in turn.
+ *
+ * @return 0 if every file was dumped without problems, otherwise the status
+ *         of the first file that wasn't
+ */
+static int dump_files(const char * const *gxt_files, int num_files,
+                      bool show_data)
+{
+    int status = DECOMPILE_SUCCESS;
+
+    for (int i = 0; i < num_files; i++)
+    {
+        int result = dump_gxt(gxt_files[i], show_data, stdout, NULL);
+        if (status == DECOMPILE_SUCCESS)
+        {
+            status = result;
+        }
+    }
+
+    return status;
+}
+
+/**
+ * Prints the strings of the keys that follow a GXT file's name.
+ *
+ * @return 0 if every string was printed, GXTMAKER_EXIT_ARGUMENT_ERROR if
+ *         the file or keys are missing, otherwise the status of the lookup
+ */
+static int get_strings(const char * const *args, int num_args)
+{
+    if (num_args == 0)
+    {
+        error(NULL, E_MISSING_INPUT_FILE);
+        return GXTMAKER_EXIT_ARGUMENT_ERROR;
+    }
+    else if (num_args == 1)
+    {
+        error(NULL, E_MISSING_ARGUMENT, "get");
+        return GXTMAKER_EXIT_ARGUMENT_ERROR;
+    }
+
+    int status = lookup_keys(args[0], args + 1, num_args - 1, stdout, NULL);
+    fflush(stdout);
+
+    return status;
+}
+
+/**
+ * Prints the differences between the two GXT files given.
+ *
+ * @return 0 if the files were compared, GXTMAKER_EXIT_ARGUMENT_ERROR if
+ *         there aren't exactly two files, otherwise the status of the
+ *         comparison
+ */
+static int diff_files(const char * const *args, int num_args)
+{
+    if (num_args == 0)
+    {
+        error(NULL, E_MISSING_INPUT_FILE);
+        return GXTMAKER_EXIT_ARGUMENT_ERROR;
+    }
+    else if (num_args == 1)
+    {
+        error(NULL, E_MISSING_ARGUMENT, "diff");
+        return GXTMAKER_EXIT_ARGUMENT_ERROR;
+    }
+    else if (num_args > 2)
+    {
+        error(NULL, E_INVALID_ARGUMENT, args[2], "diff");
+        return GXTMAKER_EXIT_ARGUMENT_ERROR;
     }
 
-    int compile_status = compile(argv[1], "./a.gxt");
+    int status = diff_gxt(args[0], args[1], stdout, NULL);
+    fflush(stdout);
 
-    return compile_status;
+    return status;
 }
@@ -0,0 +1,118 @@
+/*
+ * Copyright (c) 2017 Wes Hampson <thehambone93@gmail.com>
+ *
+ * Licensed under the MIT License. See LICENSE at top level directory.
+ */
+
+#include "mem.h"
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <stdatomic.h>
+#endif
+
+/* Counting is switched on before any workers start, so reading the flag
+   needs no synchronization; the counters themselves are shared by every
+   thread */
+static bool counting = false;
+
+#if defined(_WIN32)
+static volatile LONG64 num_allocs;
+static volatile LONG64 num_bytes;
+#else
+static atomic_uint_fast64_t num_allocs;
+static atomic_uint_fast64_t num_bytes;
+#endif
+
+static void count(size_t size);
+static void * heap_alloc(void *ctx, size_t size);
+static void * heap_realloc(void *ctx, void *ptr, size_t old_size,
+                           size_t new_size);
+static void heap_free(void *ctx, void *ptr, size_t size);
+
+const struct allocator mem_heap_allocator =
+{
+    heap_alloc, heap_realloc, heap_free, NULL
+};
+
+void mem_count_allocations(bool enable)
+{
+    counting = enable;
+}
+
+void mem_read_counters(uint64_t *allocs, uint64_t *bytes)
+{
+#if defined(_WIN32)
+    *allocs = (uint64_t) InterlockedOr64(&num_allocs, 0);
+    *bytes = (uint64_t) InterlockedOr64(&num_bytes, 0);
+#else
+    *allocs = atomic_load_explicit(&num_allocs, memory_order_relaxed);
+    *bytes = atomic_load_explicit(&num_bytes, memory_order_relaxed);
+#endif
+}
+
+void * mem_malloc(size_t size)
+{
+    if (counting)
+    {
+        count(size);
+    }
+
+    return malloc(size);
+}
+
+void * mem_calloc(size_t n, size_t size)
+{
+    if (counting)
+    {
+        count(n * size);
+    }
+
+    return calloc(n, size);
+}
+
+void * mem_realloc(void *ptr, size_t size)
+{
+    if (counting)
+    {
+        count(size);
+    }
+
+    return realloc(ptr, size);
+}
+
+static void count(size_t size)
+{
+#if defined(_WIN32)
+    InterlockedIncrement64(&num_allocs);
+    InterlockedExchangeAdd64(&num_bytes, (LONG64) size);
+#else
+    atomic_fetch_add_explicit(&num_allocs, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&num_bytes, size, memory_order_relaxed);
+#endif
+}
+
+static void * heap_alloc(void *ctx, size_t size)
+{
+    (void) ctx;
+
+    return mem_malloc(size);
+}
+
+static void * heap_realloc(void *ctx, void *ptr, size_t old_size,
+                           size_t new_size)
+{
+    (void) ctx;
+    (void) old_size;
+
+    return mem_realloc(ptr, new_size);
+}
+
+static void heap_free(void *ctx, void *ptr, size_t size)
+{
+    (void) ctx;
+    (void) size;
+
+    free(ptr);
+}
@@ -0,0 +1,64 @@
+/*
+ * Copyright (c) 2017 Wes Hampson <thehambone93@gmail.com>
+ *
+ * Licensed under the MIT License. See LICENSE at top level directory.
+ */
+
+/**
+ * Declarations for the heap allocation functions used while compiling.
+ *
+ * These behave exactly like malloc(), calloc() and realloc(), but can also
+ * count the allocations they make so that --stats can report them. Memory
+ * they return is released with free().
+ */
+
+#ifndef _GXTMAKER_MEM_H_
+#define _GXTMAKER_MEM_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+/**
+ * Turns allocation counting on or off. Counting is off by default, and
+ * should only be switched while no other threads are allocating.
+ *
+ * @param enable true to count allocations, false to stop counting
+ */
+void mem_count_allocations(bool enable);
+
+/**
+ * Gets the allocation counters, which cover every thread.
+ *
+ * @param allocs a pointer to where the number of allocations (including
+ *               reallocations) should be stored
+ * @param bytes  a pointer to where the number of bytes requested should be
+ *               stored
+ */
+void mem_read_counters(uint64_t *allocs, uint64_t *bytes);
+
+/**
+ * A set of allocation functions, such as ones supplied by an application that
+ * embeds the compiler. Each function is passed ctx, and free() and realloc()
+ * are also passed the size the memory was allocated with. Functions used by a
+ * compilation that runs on several threads must be safe to call from any of
+ * them.
+ */
+struct allocator
+{
+    void * (*alloc)(void *ctx, size_t size);
+    void * (*realloc)(void *ctx, void *ptr, size_t old_size, size_t new_size);
+    void (*free)(void *ctx, void *ptr, size_t size);
+    void *ctx;
+};
+
+/**
+ * Allocates with mem_malloc() and mem_realloc(), and frees with free().
+ */
+extern const struct allocator mem_heap_allocator;
+
+void * mem_malloc(size_t size);
+void * mem_calloc(size_t n, size_t size);
+void * mem_realloc(void *ptr, size_t size);
+
+#endif /* _GXTMAKER_MEM_H_ */
@@ -0,0 +1,492 @@
+/*
+ * Copyright (c) 2017 Wes Hampson <thehambone93@gmail.com>
+ *
+ * Licensed under the MIT License. See LICENSE at top level directory.
+ */
+
+#if !defined(_WIN32)
+#define _DEFAULT_SOURCE
+#endif
+
+#include <stdlib.h>
+
+#include "mem.h"
+#include "pool.h"
+
+#if defined(_WIN32)
+#include <windows.h>
+
+typedef HANDLE              pool_thread;
+typedef CRITICAL_SECTION    pool_mutex;
+typedef CONDITION_VARIABLE  pool_cond;
+#else
+#include <pthread.h>
+#include <unistd.h>
+
+typedef pthread_t           pool_thread;
+typedef pthread_mutex_t     pool_mutex;
+typedef pthread_cond_t      pool_cond;
+#endif
+
+#define QUEUE_INITIAL_CAPACITY 16
+
+struct pool_task
+{
+    pool_task_fn fn;
+    void *arg;
+};
+
+struct thread_pool_s    /* typedef'd in pool.h as 'thread_pool' */
+{
+    pool_thread *threads;
+    int num_threads;
+
+    pool_mutex lock;
+    pool_cond task_ready;   /* Signaled when a task is queued or on exit. */
+    pool_cond all_done;     /* Signaled when the last active task finishes. */
+
+    struct pool_task *queue;    /* Circular task queue. */
+    size_t queue_head;
+    size_t queue_len;
+    size_t queue_cap;
+
+    size_t num_active;      /* Number of tasks currently running. */
+    bool stopping;
+};
+
+static void mutex_init(pool_mutex *m);
+static void mutex_destroy(pool_mutex *m);
+static void mutex_lock(pool_mutex *m);
+static void mutex_unlock(pool_mutex *m);
+static void cond_init(pool_cond *c);
+static void cond_destroy(pool_cond *c);
+static void cond_wait(pool_cond *c, pool_mutex *m);
+static void cond_signal(pool_cond *c);
+static void cond_broadcast(pool_cond *c);
+static bool thread_start(pool_thread *t, thread_pool *p);
+static void thread_join(pool_thread t);
+
+/**
+ * The range of loop indices not yet claimed by a worker in
+ * pool_parallel_for(). The owner takes indices from the front; thieves take
+ * from the back.
+ */
+struct steal_range
+{
+    pool_mutex lock;
+    size_t next;
+    size_t end;
+};
+
+/**
+ * State shared by all workers taking part in pool_parallel_for().
+ */
+struct steal_ctx
+{
+    pool_index_fn fn;
+    void *arg;
+    struct steal_range *ranges;
+    int num_ranges;
+};
+
+/**
+ * Per-worker argument for pool_parallel_for().
+ */
+struct steal_worker
+{
+    struct steal_ctx *ctx;
+    int id;
+};
+
+static void worker_loop(thread_pool *p);
+static void steal_worker_run(void *arg);
+static bool steal_work(struct steal_ctx *ctx, int thief);
+
+bool pool_create(thread_pool **p, int num_threads)
+{
+    if (p == NULL || num_threads < 1)
+    {
+        return false;
+    }
+
+    *p = (thread_pool *) mem_calloc(1, sizeof(thread_pool));
+    if (*p == NULL)
+    {
+        return false;
+    }
+
+    thread_pool *pool = *p;
+    pool->threads = (pool_thread *) mem_malloc(num_threads * sizeof(pool_thread));
+    if (pool->threads == NULL)
+    {
+        free(pool);
+        *p = NULL;
+        return false;
+    }
+
+    mutex_init(&pool->lock);
+    cond_init(&pool->task_ready);
+    cond_init(&pool->all_done);
+
+    for (int i = 0; i < num_threads; i++)
+    {
+        if (!thread_start(&pool->threads[i], pool))
+        {
+            /* Keep whatever workers did start */
+            break;
+        }
+        pool->num_threads++;
+    }
+
+    if (pool->num_threads == 0)
+    {
+        pool_destroy(p);
+        return false;
+    }
+
+    return true;
+}
+
+bool pool_destroy(thread_pool **p)
+{
+    if (p == NULL || *p == NULL)
+    {
+        return false;
+    }
+
+    thread_pool *pool = *p;
+
+    pool_wait(pool);
+
+    mutex_lock(&pool->lock);
+    pool->stopping = true;
+    cond_broadcast(&pool->task_ready);
+    mutex_unlock(&pool->lock);
+
+    for (int i = 0; i < pool->num_threads; i++)
+    {
+        thread_join(pool->threads[i]);
+    }
+
+    cond_destroy(&pool->all_done);
+    cond_destroy(&pool->task_ready);
+    mutex_destroy(&pool->lock);
+
+    free(pool->queue);
+    free(pool->threads);
+    free(pool);
+    *p = NULL;
+
+    return true;
+}
+
+bool pool_submit(thread_pool *p, pool_task_fn fn, void *arg)
+{
+    if (p == NULL || fn == NULL)
+    {
+        return false;
+    }
+
+    mutex_lock(&p->lock);
+
+    /* Grow queue, unwrapping it into the new space */
+    if (p->queue_len == p->queue_cap)
+    {
+        size_t new_cap = (p->queue_cap == 0) ? QUEUE_INITIAL_CAPACITY
+                                             : p->queue_cap * 2;
+        struct pool_task *new_queue =
+            (struct pool_task *) mem_malloc(new_cap * sizeof(struct pool_task));
+        if (new_queue == NULL)
+        {
+            mutex_unlock(&p->lock);
+            return false;
+        }
+
+        for (size_t i = 0; i < p->queue_len; i++)
+        {
+            new_queue[i] = p->queue[(p->queue_head + i) % p->queue_cap];
+        }
+
+        free(p->queue);
+        p->queue = new_queue;
+        p->queue_head = 0;
+        p->queue_cap = new_cap;
+    }
+
+    size_t tail = (p->queue_head + p->queue_len) % p->queue_cap;
+    p->queue[tail].fn = fn;
+    p->queue[tail].arg = arg;
+    p->queue_len++;
+
+    cond_signal(&p->task_ready);
+    mutex_unlock(&p->lock);
+
+    return true;
+}
+
+void pool_wait(thread_pool *p)
+{
+    mutex_lock(&p->lock);
+    while (p->queue_len > 0 || p->num_active > 0)
+    {
+        cond_wait(&p->all_done, &p->lock);
+    }
+    mutex_unlock(&p->lock);
+}
+
+bool pool_parallel_for(thread_pool *p, pool_index_fn fn, void *arg, size_t n)
+{
+    if (p == NULL || fn == NULL)
+    {
+        return false;
+    }
+
+    int num_workers = p->num_threads;
+    if ((size_t) num_workers > n)
+    {
+        num_workers = (int) n;
+    }
+    if (num_workers == 0)
+    {
+        return true;
+    }
+
+    struct steal_ctx ctx;
+    struct steal_worker *workers = (struct steal_worker *)
+        mem_malloc(num_workers * sizeof(struct steal_worker));
+    ctx.ranges = (struct steal_range *)
+        mem_malloc(num_workers * sizeof(struct steal_range));
+    if (workers == NULL || ctx.ranges == NULL)
+    {
+        free(workers);
+        free(ctx.ranges);
+        return false;
+    }
+
+    ctx.fn = fn;
+    ctx.arg = arg;
+    ctx.num_ranges = num_workers;
+
+    /* Split [0, n) into contiguous, nearly equal ranges */
+    for (int i = 0; i < num_workers; i++)
+    {
+        mutex_init(&ctx.ranges[i].lock);
+        ctx.ranges[i].next = n * i / num_workers;
+        ctx.ranges[i].end = n * (i + 1) / num_workers;
+        workers[i].ctx = &ctx;
+        workers[i].id = i;
+    }
+
+    int submitted = 0;
+    for (int i = 0; i < num_workers; i++)
+    {
+        if (!pool_submit(p, steal_worker_run, &workers[i]))
+        {
+            break;
+        }
+        submitted++;
+    }
+
+    if (submitted == 0)
+    {
+        /* Run everything on this thread; stealing picks up every range */
+        steal_worker_run(&workers[0]);
+    }
+
+    pool_wait(p);
+
+    for (int i = 0; i < num_workers; i++)
+    {
+        mutex_destroy(&ctx.ranges[i].lock);
+    }
+    free(ctx.ranges);
+    free(workers);
+
+    return true;
+}
+
+int pool_num_cpus(void)
+{
+#if defined(_WIN32)
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    int n = (int) info.dwNumberOfProcessors;
+#else
+    int n = (int) sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+
+    return (n > 0) ? n : 1;
+}
+
+/**
+ * Runs queued tasks until the pool is stopped.
+ */
+static void worker_loop(thread_pool *p)
+{
+    mutex_lock(&p->lock);
+
+    for (;;)
+    {
+        while (p->queue_len == 0 && !p->stopping)
+        {
+            cond_wait(&p->task_ready, &p->lock);
+        }
+
+        if (p->queue_len == 0)
+        {
+            /* Stopping and nothing left to do */
+            break;
+        }
+
+        struct pool_task task = p->queue[p->queue_head];
+        p->queue_head = (p->queue_head + 1) % p->queue_cap;
+        p->queue_len--;
+        p->num_active++;
+
+        mutex_unlock(&p->lock);
+        task.fn(task.arg);
+        mutex_lock(&p->lock);
+
+        p->num_active--;
+        if (p->queue_len == 0 && p->num_active == 0)
+        {
+            cond_broadcast(&p->all_done);
+        }
+    }
+
+    mutex_unlock(&p->lock);
+}
+
+/**
+ * Runs loop indices from a worker's own range, then from other workers'
+ * ranges, until no indices are left anywhere.
+ */
+static void steal_worker_run(void *arg)
+{
+    struct steal_worker *w = (struct steal_worker *) arg;
+    struct steal_ctx *ctx = w->ctx;
+    struct steal_range *own = &ctx->ranges[w->id];
+
+    for (;;)
+    {
+        mutex_lock(&own->lock);
+        bool have_index = own->next < own->end;
+        size_t index = own->next;
+        if (have_index)
+        {
+            own->next++;
+        }
+        mutex_unlock(&own->lock);
+
+        if (have_index)
+        {
+            ctx->fn(ctx->arg, index);
+        }
+        else if (!steal_work(ctx, w->id))
+        {
+            break;
+        }
+    }
+}
+
+/**
+ * Moves the back half of another worker's remaining range into the thief's
+ * (empty) range.
+ *
+ * @return true if any work was stolen, false if every range is empty
+ */
+static bool steal_work(struct steal_ctx *ctx, int thief)
+{
+    for (int i = 1; i < ctx->num_ranges; i++)
+    {
+        struct steal_range *victim =
+            &ctx->ranges[(thief + i) % ctx->num_ranges];
+
+        mutex_lock(&victim->lock);
+        size_t remaining = victim->end - victim->next;
+        if (remaining == 0)
+        {
+            mutex_unlock(&victim->lock);
+            continue;
+        }
+
+        /* Leave the victim the front half (it is working from there) */
+        size_t mid = victim->next + remaining / 2;
+        size_t end = victim->end;
+        victim->end = mid;
+        mutex_unlock(&victim->lock);
+
+        struct steal_range *own = &ctx->ranges[thief];
+        mutex_lock(&own->lock);
+        own->next = mid;
+        own->end = end;
+        mutex_unlock(&own->lock);
+
+        return true;
+    }
+
+    return false;
+}
+
+#if defined(_WIN32)
+
+static DWORD WINAPI thread_main(LPVOID arg)
+{
+    worker_loop((thread_pool *) arg);
+    return 0;
+}
+
+static void mutex_init(pool_mutex *m) { InitializeCriticalSection(m); }
+static void mutex_destroy(pool_mutex *m) { DeleteCriticalSection(m); }
+static void mutex_lock(pool_mutex *m) { EnterCriticalSection(m); }
+static void mutex_unlock(pool_mutex *m) { LeaveCriticalSection(m); }
+static void cond_init(pool_cond *c) { InitializeConditionVariable(c); }
+static void cond_destroy(pool_cond *c) { (void) c; }
+static void cond_wait(pool_cond *c, pool_mutex *m)
+{
+    SleepConditionVariableCS(c, m, INFINITE);
+}
+static void cond_signal(pool_cond *c) { WakeConditionVariable(c); }
+static void cond_broadcast(pool_cond *c) { WakeAllConditionVariable(c); }
+
+static bool thread_start(pool_thread *t, thread_pool *p)
+{
+    *t = CreateThread(NULL, 0, thread_main, p, 0, NULL);
+    return *t != NULL;
+}
+
+static void thread_join(pool_thread t)
+{
+    WaitForSingleObject(t, INFINITE);
+    CloseHandle(t);
+}
+
+#else
+
+static void * thread_main(void *arg)
+{
+    worker_loop((thread_pool *) arg);
+    return NULL;
+}
+
+static void mutex_init(pool_mutex *m) { pthread_mutex_init(m, NULL); }
+static void mutex_destroy(pool_mutex *m) { pthread_mutex_destroy(m); }
+static void mutex_lock(pool_mutex *m) { pthread_mutex_lock(m); }
+static void mutex_unlock(pool_mutex *m) { pthread_mutex_unlock(m); }
+static void cond_init(pool_cond *c) { pthread_cond_init(c, NULL); }
+static void cond_destroy(pool_cond *c) { pthread_cond_destroy(c); }
+static void cond_wait(pool_cond *c, pool_mutex *m) { pthread_cond_wait(c, m); }
+static void cond_signal(pool_cond *c) { pthread_cond_signal(c); }
+static void cond_broadcast(pool_cond *c) { pthread_cond_broadcast(c); }
+
+static bool thread_start(pool_thread *t, thread_pool *p)
+{
+    return pthread_create(t, NULL, thread_main, p) == 0;
+}
+
+static void thread_join(pool_thread t)
+{
+    pthread_join(t, NULL);
+}
+
+#endif /* _WIN32 */
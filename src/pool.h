@@ -0,0 +1,109 @@
+/*
+ * Copyright (c) 2017 Wes Hampson <thehambone93@gmail.com>
+ *
+ * Licensed under the MIT License. See LICENSE at top level directory.
+ */
+
+/**
+ * Declarations for a fixed-size pool of worker threads.
+ *
+ * Tasks submitted to the pool are run in submission order by whichever worker
+ * becomes free first. Tasks may run concurrently, so anything a task touches
+ * must either belong to that task alone or be safe to share.
+ */
+
+#ifndef _GXTMAKER_POOL_H_
+#define _GXTMAKER_POOL_H_
+
+#include <stdbool.h>
+#include <stdlib.h>
+
+typedef struct thread_pool_s thread_pool;
+
+/**
+ * A function to be run by a worker thread.
+ *
+ * @param arg the argument passed to pool_submit()
+ */
+typedef void (*pool_task_fn)(void *arg);
+
+/**
+ * A function to be run by a worker thread for one index of a parallel loop.
+ *
+ * @param arg   the argument passed to pool_parallel_for()
+ * @param index the loop index
+ */
+typedef void (*pool_index_fn)(void *arg, size_t index);
+
+/**
+ * Creates a thread pool and starts its workers.
+ *
+ * pool_destroy() should be called when the pool is no longer needed.
+ *
+ * @param p           a pointer to the pool to be created
+ * @param num_threads the number of worker threads to start (at least 1)
+ *
+ * @return true  if the pool was created and all workers were started
+ *         false if the pool could not be created
+ */
+bool pool_create(thread_pool **p, int num_threads);
+
+/**
+ * Waits for all outstanding tasks to finish, then stops the workers and
+ * deletes the pool.
+ *
+ * @param p a pointer to the pool to be deleted
+ *
+ * @return true  if the pool was deleted
+ *         false if the pool was never initialized
+ */
+bool pool_destroy(thread_pool **p);
+
+/**
+ * Queues a task to be run by the next available worker.
+ *
+ * @param p    the pool to run the task on
+ * @param fn   the function to run
+ * @param arg  the argument to pass to the function
+ *
+ * @return true  if the task was queued
+ *         false if the task could not be queued
+ *               (e.g. due to lack of available memory)
+ */
+bool pool_submit(thread_pool *p, pool_task_fn fn, void *arg);
+
+/**
+ * Blocks until every task submitted so far has finished.
+ *
+ * @param p the pool to wait on
+ */
+void pool_wait(thread_pool *p);
+
+/**
+ * Runs a function once for every index in [0, n) and waits for all of the
+ * calls to finish.
+ *
+ * The index range is divided evenly between the workers. A worker that runs
+ * out of indices steals the back half of the remaining range of another
+ * worker, so uneven amounts of work per index still keep every worker busy.
+ * Each worker runs its own indices in ascending order.
+ *
+ * @param p   the pool to run on (must have no other tasks queued)
+ * @param fn  the function to run
+ * @param arg the argument to pass to the function
+ * @param n   the number of indices
+ *
+ * @return true  if every index was run
+ *         false if the work could not be scheduled
+ *               (e.g. due to lack of available memory)
+ */
+bool pool_parallel_for(thread_pool *p, pool_index_fn fn, void *arg, size_t n);
+
+/**
+ * Gets the number of processors available for running worker threads.
+ *
+ * @return the number of online processors (at least 1)
+ */
+int pool_num_cpus(void);
+
+#endif /* _GXTMAKER_POOL_H_ */
@@ -0,0 +1,394 @@
+/*
+ * Copyright (c) 2017 Wes Hampson <thehambone93@gmail.com>
+ *
+ * Licensed under the MIT License. See LICENSE at top level directory.
+ */
+
+#include <string.h>
+
+#include "scan.h"
+
+#if !defined(GXTMAKER_SCALAR_SCAN)
+#if defined(__SSE2__) || defined(_M_X64) \
+    || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SCAN_HAVE_SSE2
+#include <emmintrin.h>
+#endif
+
+/* AVX2 code is built with a per-function target attribute and only run if the
+   CPU supports it, so the rest of the program stays baseline x86-64. */
+#if defined(SCAN_HAVE_SSE2) && defined(__x86_64__) \
+    && (defined(__GNUC__) || defined(__clang__))
+#define SCAN_HAVE_AVX2
+#include <immintrin.h>
+#endif
+#endif /* GXTMAKER_SCALAR_SCAN */
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+/* Byte-wide match counters must be drained before they can overflow */
+#define MAX_COUNT_ITERATIONS 255
+
+#if defined(SCAN_HAVE_SSE2)
+static size_t scan_delims_sse2(const char *buf, size_t len,
+                               const char delims[SCAN_NUM_DELIMS]);
+static size_t scan_count_sse2(const char *buf, size_t len, char c);
+static size_t scan_delims16_sse2(const char *buf, size_t len,
+                                 const uint16_t delims[SCAN_NUM_DELIMS]);
+static size_t scan_count16_sse2(const char *buf, size_t len, uint16_t c);
+#endif
+#if defined(SCAN_HAVE_AVX2)
+static size_t scan_delims_avx2(const char *buf, size_t len,
+                               const char delims[SCAN_NUM_DELIMS]);
+static size_t scan_count_avx2(const char *buf, size_t len, char c);
+static size_t scan_delims16_avx2(const char *buf, size_t len,
+                                 const uint16_t delims[SCAN_NUM_DELIMS]);
+#endif
+
+static uint16_t load_unit(const char *p);
+
+size_t scan_delims(const char *buf, size_t len,
+                   const char delims[SCAN_NUM_DELIMS])
+{
+#if defined(SCAN_HAVE_AVX2)
+    if (__builtin_cpu_supports("avx2"))
+    {
+        return scan_delims_avx2(buf, len, delims);
+    }
+#endif
+#if defined(SCAN_HAVE_SSE2)
+    return scan_delims_sse2(buf, len, delims);
+#else
+    return scan_delims_scalar(buf, len, delims);
+#endif
+}
+
+size_t scan_delims_scalar(const char *buf, size_t len,
+                          const char delims[SCAN_NUM_DELIMS])
+{
+    for (size_t i = 0; i < len; i++)
+    {
+        char c = buf[i];
+        if (c == delims[0] || c == delims[1]
+            || c == delims[2] || c == delims[3])
+        {
+            return i;
+        }
+    }
+
+    return len;
+}
+
+size_t scan_count(const char *buf, size_t len, char c)
+{
+#if defined(SCAN_HAVE_AVX2)
+    if (__builtin_cpu_supports("avx2"))
+    {
+        return scan_count_avx2(buf, len, c);
+    }
+#endif
+#if defined(SCAN_HAVE_SSE2)
+    return scan_count_sse2(buf, len, c);
+#else
+    return scan_count_scalar(buf, len, c);
+#endif
+}
+
+size_t scan_count_scalar(const char *buf, size_t len, char c)
+{
+    size_t count = 0;
+    for (size_t i = 0; i < len; i++)
+    {
+        count += (buf[i] == c);
+    }
+
+    return count;
+}
+
+size_t scan_delims16(const char *buf, size_t len,
+                     const uint16_t delims[SCAN_NUM_DELIMS])
+{
+#if defined(SCAN_HAVE_AVX2)
+    if (__builtin_cpu_supports("avx2"))
+    {
+        return scan_delims16_avx2(buf, len, delims);
+    }
+#endif
+#if defined(SCAN_HAVE_SSE2)
+    return scan_delims16_sse2(buf, len, delims);
+#else
+    return scan_delims16_scalar(buf, len, delims);
+#endif
+}
+
+size_t scan_delims16_scalar(const char *buf, size_t len,
+                            const uint16_t delims[SCAN_NUM_DELIMS])
+{
+    for (size_t i = 0; i < len; i++)
+    {
+        uint16_t c = load_unit(buf + i * 2);
+        if (c == delims[0] || c == delims[1]
+            || c == delims[2] || c == delims[3])
+        {
+            return i;
+        }
+    }
+
+    return len;
+}
+
+size_t scan_count16(const char *buf, size_t len, uint16_t c)
+{
+#if defined(SCAN_HAVE_SSE2)
+    return scan_count16_sse2(buf, len, c);
+#else
+    return scan_count16_scalar(buf, len, c);
+#endif
+}
+
+size_t scan_count16_scalar(const char *buf, size_t len, uint16_t c)
+{
+    size_t count = 0;
+    for (size_t i = 0; i < len; i++)
+    {
+        count += (load_unit(buf + i * 2) == c);
+    }
+
+    return count;
+}
+
+/**
+ * Reads a 16-bit unit from a possibly unaligned position.
+ */
+static uint16_t load_unit(const char *p)
+{
+    uint16_t c;
+    memcpy(&c, p, sizeof(c));
+
+    return c;
+}
+
+#if defined(SCAN_HAVE_SSE2)
+
+/**
+ * Gets the index of the lowest set bit in a non-zero mask.
+ */
+static unsigned int first_set_bit(unsigned int mask)
+{
+#if defined(_MSC_VER)
+    unsigned long idx;
+    _BitScanForward(&idx, mask);
+    return (unsigned int) idx;
+#else
+    return (unsigned int) __builtin_ctz(mask);
+#endif
+}
+
+static size_t scan_delims_sse2(const char *buf, size_t len,
+                               const char delims[SCAN_NUM_DELIMS])
+{
+    const __m128i d0 = _mm_set1_epi8(delims[0]);
+    const __m128i d1 = _mm_set1_epi8(delims[1]);
+    const __m128i d2 = _mm_set1_epi8(delims[2]);
+    const __m128i d3 = _mm_set1_epi8(delims[3]);
+
+    size_t i = 0;
+    for (; i + 16 <= len; i += 16)
+    {
+        __m128i v = _mm_loadu_si128((const __m128i *) (buf + i));
+        __m128i m = _mm_or_si128(
+            _mm_or_si128(_mm_cmpeq_epi8(v, d0), _mm_cmpeq_epi8(v, d1)),
+            _mm_or_si128(_mm_cmpeq_epi8(v, d2), _mm_cmpeq_epi8(v, d3)));
+
+        unsigned int mask = (unsigned int) _mm_movemask_epi8(m);
+        if (mask != 0)
+        {
+            return i + first_set_bit(mask);
+        }
+    }
+
+    return i + scan_delims_scalar(buf + i, len - i, delims);
+}
+
+static size_t scan_count_sse2(const char *buf, size_t len, char c)
+{
+    const __m128i needle = _mm_set1_epi8(c);
+    const __m128i zero = _mm_setzero_si128();
+
+    size_t count = 0;
+    size_t i = 0;
+
+    while (i + 16 <= len)
+    {
+        /* Each match subtracts -1 from its byte lane; lanes are summed with
+           psadbw before any of them can wrap */
+        __m128i acc = _mm_setzero_si128();
+        for (int n = 0; n < MAX_COUNT_ITERATIONS && i + 16 <= len; n++, i += 16)
+        {
+            __m128i v = _mm_loadu_si128((const __m128i *) (buf + i));
+            acc = _mm_sub_epi8(acc, _mm_cmpeq_epi8(v, needle));
+        }
+
+        __m128i sums = _mm_sad_epu8(acc, zero);
+        count += (size_t) _mm_cvtsi128_si32(sums)
+               + (size_t) _mm_cvtsi128_si32(_mm_srli_si128(sums, 8));
+    }
+
+    return count + scan_count_scalar(buf + i, len - i, c);
+}
+
+static size_t scan_delims16_sse2(const char *buf, size_t len,
+                                 const uint16_t delims[SCAN_NUM_DELIMS])
+{
+    const __m128i d0 = _mm_set1_epi16((short) delims[0]);
+    const __m128i d1 = _mm_set1_epi16((short) delims[1]);
+    const __m128i d2 = _mm_set1_epi16((short) delims[2]);
+    const __m128i d3 = _mm_set1_epi16((short) delims[3]);
+
+    size_t i = 0;
+    for (; i + 8 <= len; i += 8)
+    {
+        __m128i v = _mm_loadu_si128((const __m128i *) (buf + i * 2));
+        __m128i m = _mm_or_si128(
+            _mm_or_si128(_mm_cmpeq_epi16(v, d0), _mm_cmpeq_epi16(v, d1)),
+            _mm_or_si128(_mm_cmpeq_epi16(v, d2), _mm_cmpeq_epi16(v, d3)));
+
+        /* Each matching unit sets two adjacent mask bits */
+        unsigned int mask = (unsigned int) _mm_movemask_epi8(m);
+        if (mask != 0)
+        {
+            return i + first_set_bit(mask) / 2;
+        }
+    }
+
+    return i + scan_delims16_scalar(buf + i * 2, len - i, delims);
+}
+
+static size_t scan_count16_sse2(const char *buf, size_t len, uint16_t c)
+{
+    const __m128i needle = _mm_set1_epi16((short) c);
+    const __m128i zero = _mm_setzero_si128();
+
+    size_t count = 0;
+    size_t i = 0;
+
+    while (i + 8 <= len)
+    {
+        /* As in scan_count_sse2(), but a match counts once in each of the
+           unit's two bytes */
+        __m128i acc = _mm_setzero_si128();
+        for (int n = 0; n < MAX_COUNT_ITERATIONS && i + 8 <= len; n++, i += 8)
+        {
+            __m128i v = _mm_loadu_si128((const __m128i *) (buf + i * 2));
+            acc = _mm_sub_epi8(acc, _mm_cmpeq_epi16(v, needle));
+        }
+
+        __m128i sums = _mm_sad_epu8(acc, zero);
+        count += ((size_t) _mm_cvtsi128_si32(sums)
+                + (size_t) _mm_cvtsi128_si32(_mm_srli_si128(sums, 8))) / 2;
+    }
+
+    return count + scan_count16_scalar(buf + i * 2, len - i, c);
+}
+
+#endif /* SCAN_HAVE_SSE2 */
+
+#if defined(SCAN_HAVE_AVX2)
+
+__attribute__((target("avx2")))
+static size_t scan_delims_avx2(const char *buf, size_t len,
+                               const char delims[SCAN_NUM_DELIMS])
+{
+    const __m256i d0 = _mm256_set1_epi8(delims[0]);
+    const __m256i d1 = _mm256_set1_epi8(delims[1]);
+    const __m256i d2 = _mm256_set1_epi8(delims[2]);
+    const __m256i d3 = _mm256_set1_epi8(delims[3]);
+
+    size_t i = 0;
+    for (; i + 32 <= len; i += 32)
+    {
+        __m256i v = _mm256_loadu_si256((const __m256i *) (buf + i));
+        __m256i m = _mm256_or_si256(
+            _mm256_or_si256(_mm256_cmpeq_epi8(v, d0),
+                            _mm256_cmpeq_epi8(v, d1)),
+            _mm256_or_si256(_mm256_cmpeq_epi8(v, d2),
+                            _mm256_cmpeq_epi8(v, d3)));
+
+        unsigned int mask = (unsigned int) _mm256_movemask_epi8(m);
+        if (mask != 0)
+        {
+            return i + first_set_bit(mask);
+        }
+    }
+
+    /* The tail is handled by non-VEX SSE code, which runs very slowly while
+       the upper halves of the YMM registers are dirty */
+    _mm256_zeroupper();
+
+    return i + scan_delims_sse2(buf + i, len - i, delims);
+}
+
+__attribute__((target("avx2")))
+static size_t scan_count_avx2(const char *buf, size_t len, char c)
+{
+    const __m256i needle = _mm256_set1_epi8(c);
+    const __m256i zero = _mm256_setzero_si256();
+
+    size_t count = 0;
+    size_t i = 0;
+
+    while (i + 32 <= len)
+    {
+        __m256i acc = _mm256_setzero_si256();
+        for (int n = 0; n < MAX_COUNT_ITERATIONS && i + 32 <= len; n++, i += 32)
+        {
+            __m256i v = _mm256_loadu_si256((const __m256i *) (buf + i));
+            acc = _mm256_sub_epi8(acc, _mm256_cmpeq_epi8(v, needle));
+        }
+
+        __m256i sums = _mm256_sad_epu8(acc, zero);
+        count += (size_t) _mm256_extract_epi64(sums, 0)
+               + (size_t) _mm256_extract_epi64(sums, 1)
+               + (size_t) _mm256_extract_epi64(sums, 2)
+               + (size_t) _mm256_extract_epi64(sums, 3);
+    }
+
+    _mm256_zeroupper();
+
+    return count + scan_count_sse2(buf + i, len - i, c);
+}
+
+__attribute__((target("avx2")))
+static size_t scan_delims16_avx2(const char *buf, size_t len,
+                                 const uint16_t delims[SCAN_NUM_DELIMS])
+{
+    const __m256i d0 = _mm256_set1_epi16((short) delims[0]);
+    const __m256i d1 = _mm256_set1_epi16((short) delims[1]);
+    const __m256i d2 = _mm256_set1_epi16((short) delims[2]);
+    const __m256i d3 = _mm256_set1_epi16((short) delims[3]);
+
+    size_t i = 0;
+    for (; i + 16 <= len; i += 16)
+    {
+        __m256i v = _mm256_loadu_si256((const __m256i *) (buf + i * 2));
+        __m256i m = _mm256_or_si256(
+            _mm256_or_si256(_mm256_cmpeq_epi16(v, d0),
+                            _mm256_cmpeq_epi16(v, d1)),
+            _mm256_or_si256(_mm256_cmpeq_epi16(v, d2),
+                            _mm256_cmpeq_epi16(v, d3)));
+
+        unsigned int mask = (unsigned int) _mm256_movemask_epi8(m);
+        if (mask != 0)
+        {
+            return i + first_set_bit(mask) / 2;
+        }
+    }
+
+    _mm256_zeroupper();
+
+    return i + scan_delims16_sse2(buf + i * 2, len - i, delims);
+}
+
+#endif /* SCAN_HAVE_AVX2 */
@@ -0,0 +1,96 @@
+/*
+ * Copyright (c) 2017 Wes Hampson <thehambone93@gmail.com>
+ *
+ * Licensed under the MIT License. See LICENSE at top level directory.
+ */
+
+#ifndef _GXTMAKER_SCAN_H_
+#define _GXTMAKER_SCAN_H_
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#define SCAN_NUM_DELIMS 4
+
+/**
+ * Finds the first byte in a buffer that matches any of a set of delimiters.
+ *
+ * Uses the widest vector instructions available on the running CPU (AVX2 or
+ * SSE2 on x86), falling back to scan_delims_scalar() elsewhere. Defining
+ * GXTMAKER_SCALAR_SCAN at build time forces the scalar path.
+ *
+ * @param buf    the buffer to search
+ * @param len    the size of the buffer in bytes
+ * @param delims the delimiters to search for; repeat a delimiter to search
+ *               for fewer than SCAN_NUM_DELIMS distinct bytes
+ *
+ * @return the index of the first delimiter, or len if there is none
+ */
+size_t scan_delims(const char *buf, size_t len,
+                   const char delims[SCAN_NUM_DELIMS]);
+
+/**
+ * Byte-at-a-time reference implementation of scan_delims().
+ */
+size_t scan_delims_scalar(const char *buf, size_t len,
+                          const char delims[SCAN_NUM_DELIMS]);
+
+/**
+ * Counts the occurrences of a byte in a buffer.
+ *
+ * Uses the same instruction set selection as scan_delims().
+ *
+ * @param buf the buffer to search
+ * @param len the size of the buffer in bytes
+ * @param c   the byte to count
+ *
+ * @return the number of times c occurs in the buffer
+ */
+size_t scan_count(const char *buf, size_t len, char c);
+
+/**
+ * Byte-at-a-time reference implementation of scan_count().
+ */
+size_t scan_count_scalar(const char *buf, size_t len, char c);
+
+/**
+ * Finds the first 16-bit unit in a buffer that matches any of a set of
+ * delimiters.
+ *
+ * Units are compared as they are stored, so text in the other byte order
+ * can be searched by byte-swapping the delimiters. Uses the same instruction
+ * set selection as scan_delims().
+ *
+ * @param buf    the buffer to search; need not be aligned
+ * @param len    the size of the buffer in units
+ * @param delims the delimiters to search for; repeat a delimiter to search
+ *               for fewer than SCAN_NUM_DELIMS distinct units
+ *
+ * @return the index of the first delimiter in units, or len if there is none
+ */
+size_t scan_delims16(const char *buf, size_t len,
+                     const uint16_t delims[SCAN_NUM_DELIMS]);
+
+/**
+ * Unit-at-a-time reference implementation of scan_delims16().
+ */
+size_t scan_delims16_scalar(const char *buf, size_t len,
+                            const uint16_t delims[SCAN_NUM_DELIMS]);
+
+/**
+ * Counts the occurrences of a 16-bit unit in a buffer.
+ *
+ * @param buf the buffer to search; need not be aligned
+ * @param len the size of the buffer in units
+ * @param c   the unit to count, as stored
+ *
+ * @return the number of times c occurs in the buffer
+ */
+size_t scan_count16(const char *buf, size_t len, uint16_t c);
+
+/**
+ * Unit-at-a-time reference implementation of scan_count16().
+ */
+size_t scan_count16_scalar(const char *buf, size_t len, uint16_t c);
+
+#endif /* _GXTMAKER_SCAN_H_ */
@@ -0,0 +1,151 @@
+/*
+ * Copyright (c) 2017 Wes Hampson <thehambone93@gmail.com>
+ *
+ * Licensed under the MIT License. See LICENSE at top level directory.
+ */
+
+#if !defined(_WIN32)
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#include <stdio.h>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+#include "mem.h"
+#include "stats.h"
+
+static const char *phase_names[NUM_PHASES] =
+{
+    "read", "lex", "tkey", "tdat", "write"
+};
+
+static void print_json_string(const char *str, FILE *stream);
+
+void stats_begin(struct compile_stats *stats)
+{
+    if (stats == NULL)
+    {
+        return;
+    }
+
+    mem_read_counters(&stats->start_allocs, &stats->start_bytes);
+    stats->start_time = stats_now();
+}
+
+void stats_end(struct compile_stats *stats, enum compile_phase phase)
+{
+    if (stats == NULL)
+    {
+        return;
+    }
+
+    double end_time = stats_now();
+    uint64_t allocs;
+    uint64_t bytes;
+    mem_read_counters(&allocs, &bytes);
+
+    struct phase_stats *p = &stats->phases[phase];
+    p->seconds += end_time - stats->start_time;
+    p->allocs += allocs - stats->start_allocs;
+    p->alloc_bytes += bytes - stats->start_bytes;
+}
+
+void stats_print(const struct compile_stats *stats, const char *src_file,
+                 enum stats_format format, FILE *stream)
+{
+    struct phase_stats total = { 0 };
+    for (int i = 0; i < NUM_PHASES; i++)
+    {
+        total.seconds += stats->phases[i].seconds;
+        total.allocs += stats->phases[i].allocs;
+        total.alloc_bytes += stats->phases[i].alloc_bytes;
+    }
+
+    if (format == STATS_JSON)
+    {
+        fputs("{\"file\":", stream);
+        print_json_string(src_file, stream);
+        fprintf(stream, ",\"src_bytes\":%llu,\"keys\":%llu,\"out_bytes\":%llu,"
+                "\"phases\":{",
+                (unsigned long long) stats->src_size,
+                (unsigned long long) stats->num_keys,
+                (unsigned long long) stats->out_size);
+        for (int i = 0; i < NUM_PHASES; i++)
+        {
+            const struct phase_stats *p = &stats->phases[i];
+            fprintf(stream, "%s\"%s\":{\"ms\":%.3f,\"allocs\":%llu,"
+                    "\"alloc_bytes\":%llu}",
+                    (i > 0) ? "," : "", phase_names[i], p->seconds * 1000,
+                    (unsigned long long) p->allocs,
+                    (unsigned long long) p->alloc_bytes);
+        }
+        fprintf(stream, "},\"total_ms\":%.3f,\"allocs\":%llu,"
+                "\"alloc_bytes\":%llu}\n",
+                total.seconds * 1000, (unsigned long long) total.allocs,
+                (unsigned long long) total.alloc_bytes);
+        return;
+    }
+
+    fprintf(stream, "%s: %llu bytes, %llu keys, %llu bytes written\n",
+            src_file, (unsigned long long) stats->src_size,
+            (unsigned long long) stats->num_keys,
+            (unsigned long long) stats->out_size);
+    fprintf(stream, "  %-6s %10s %10s %12s\n", "phase", "ms", "allocs",
+            "bytes");
+    for (int i = 0; i <= NUM_PHASES; i++)
+    {
+        const struct phase_stats *p =
+            (i < NUM_PHASES) ? &stats->phases[i] : &total;
+        fprintf(stream, "  %-6s %10.3f %10llu %12llu\n",
+                (i < NUM_PHASES) ? phase_names[i] : "total",
+                p->seconds * 1000, (unsigned long long) p->allocs,
+                (unsigned long long) p->alloc_bytes);
+    }
+}
+
+double stats_now(void)
+{
+#if defined(_WIN32)
+    LARGE_INTEGER count;
+    LARGE_INTEGER freq;
+    QueryPerformanceCounter(&count);
+    QueryPerformanceFrequency(&freq);
+
+    return (double) count.QuadPart / freq.QuadPart;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+#endif
+}
+
+/**
+ * Prints a string as a JSON string literal.
+ */
+static void print_json_string(const char *str, FILE *stream)
+{
+    fputc('"', stream);
+    for (const unsigned char *s = (const unsigned char *) str; *s != '\0'; s++)
+    {
+        if (*s == '"' || *s == '\\')
+        {
+            fputc('\\', stream);
+            fputc(*s, stream);
+        }
+        else if (*s < 0x20)
+        {
+            fprintf(stream, "\\u%04x", *s);
+        }
+        else
+        {
+            fputc(*s, stream);
+        }
+    }
+    fputc('"', stream);
+}
@@ -0,0 +1,101 @@
+/*
+ * Copyright (c) 2017 Wes Hampson <thehambone93@gmail.com>
+ *
+ * Licensed under the MIT License. See LICENSE at top level directory.
+ */
+
+/**
+ * Declarations for compile statistics: how long each phase of a compile took
+ * and how much it allocated.
+ */
+
+#ifndef _GXTMAKER_STATS_H_
+#define _GXTMAKER_STATS_H_
+
+#include <stdint.h>
+#include <stdio.h>
+
+/**
+ * The phases of a compile, in the order they run.
+ */
+enum compile_phase
+{
+    PHASE_READ,             /* Map the source and check the cache. */
+    PHASE_LEX,              /* Lex the source and encode its strings. */
+    PHASE_TKEY,             /* Sort the keys and check for duplicates. */
+    PHASE_TDAT,             /* Share strings and lay out the output. */
+    PHASE_WRITE,            /* Write the output and the cache. */
+    NUM_PHASES
+};
+
+/**
+ * Output formats for compile statistics.
+ */
+enum stats_format
+{
+    STATS_NONE,
+    STATS_TABLE,            /* A few lines of text per file. */
+    STATS_JSON              /* One JSON object per line, one per file. */
+};
+
+struct phase_stats
+{
+    double seconds;
+    uint64_t allocs;        /* Allocations made (including reallocations). */
+    uint64_t alloc_bytes;   /* Bytes requested by those allocations. */
+};
+
+/**
+ * Statistics for the compile of one file.
+ *
+ * Allocations are counted process-wide (see mem.h), so they only belong to
+ * one file if files are compiled one at a time.
+ */
+struct compile_stats
+{
+    struct phase_stats phases[NUM_PHASES];
+    uint64_t src_size;      /* Source size in bytes. */
+    uint64_t num_keys;      /* Keys written. */
+    uint64_t out_size;      /* Output size in bytes. */
+
+    /* Counters at the start of the current phase */
+    double start_time;
+    uint64_t start_allocs;
+    uint64_t start_bytes;
+};
+
+/**
+ * Starts timing a phase. Does nothing if stats is NULL.
+ *
+ * @param stats the statistics to record the phase in
+ */
+void stats_begin(struct compile_stats *stats);
+
+/**
+ * Stops timing a phase and adds its time and allocations to the phase's
+ * totals. Does nothing if stats is NULL.
+ *
+ * @param stats the statistics to record the phase in
+ * @param phase the phase that has just finished
+ */
+void stats_end(struct compile_stats *stats, enum compile_phase phase);
+
+/**
+ * Prints the statistics for a file.
+ *
+ * @param stats    the statistics to print
+ * @param src_file the file the statistics are about
+ * @param format   how to print them
+ * @param stream   the stream to print them to
+ */
+void stats_print(const struct compile_stats *stats, const char *src_file,
+                 enum stats_format format, FILE *stream);
+
+/**
+ * Reads the time from a monotonic clock.
+ *
+ * @return the time in seconds since an unspecified point
+ */
+double stats_now(void);
+
+#endif /* _GXTMAKER_STATS_H_ */
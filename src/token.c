@@ -0,0 +1,53 @@
+/*
+ * Copyright (c) 2017 Wes Hampson <thehambone93@gmail.com>
+ *
+ * Licensed under the MIT License. See LICENSE at top level directory.
+ */
+
+#include <string.h>
+
+#include "token.h"
+
+const struct token_set * token_set_find(const char *name)
+{
+    for (int i = 0; i < token_set_count; i++)
+    {
+        if (strcmp(token_set_list[i].name, name) == 0)
+        {
+            return &token_set_list[i];
+        }
+    }
+
+    return NULL;
+}
+
+const struct token_def * token_find(const struct token_set *set,
+                                    const char *name, size_t len)
+{
+    uint32_t bucket = token_hash(name, len, 0) % set->num_buckets;
+    uint32_t slot = token_hash(name, len, set->seeds[bucket])
+        & (set->num_slots - 1);
+
+    /* Every name in the set hashes to its own slot, so anything else found
+       there is a different name */
+    const struct token_def *def = &set->table[slot];
+    if (def->name == NULL || strncmp(def->name, name, len) != 0
+        || def->name[len] != '\0')
+    {
+        return NULL;
+    }
+
+    return def;
+}
+
+uint32_t token_hash(const char *name, size_t len, uint32_t seed)
+{
+    /* FNV-1a, with the seed mixed into the offset basis */
+    uint32_t h = 2166136261u ^ seed;
+    for (size_t i = 0; i < len; i++)
+    {
+        h = (h ^ (unsigned char) name[i]) * 16777619u;
+    }
+
+    return h ^ (h >> 16);
+}
@@ -0,0 +1,90 @@
+/*
+ * Copyright (c) 2017 Wes Hampson <thehambone93@gmail.com>
+ *
+ * Licensed under the MIT License. See LICENSE at top level directory.
+ */
+
+/**
+ * Declarations for formatting tokens, the ~x~ sequences in GXT strings that
+ * a game replaces with colours, line breaks, button names and so on.
+ */
+
+#ifndef _GXTMAKER_TOKEN_H_
+#define _GXTMAKER_TOKEN_H_
+
+#include <stdint.h>
+#include <stdlib.h>
+
+/* Longest token name that is ever looked up */
+#define TOKEN_MAX_LEN 63
+
+/**
+ * What a token is allowed to be used for.
+ */
+enum token_kind
+{
+    TOKEN_FORMAT,           /* Used on its own, e.g. ~g~. */
+    TOKEN_KEY,              /* Must be followed by a control, e.g. ~k~. */
+    TOKEN_CONTROL           /* Only used after TOKEN_KEY. */
+};
+
+struct token_def
+{
+    const char *name;       /* NULL for an empty slot. */
+    enum token_kind kind;
+};
+
+/**
+ * The tokens a game understands, as a perfect hash table (see token_find()).
+ *
+ * The token sets are generated at build time from the definition files in
+ * tokens/, one per game.
+ */
+struct token_set
+{
+    const char *name;
+    uint64_t fingerprint;           /* Changes whenever the set changes. */
+    const struct token_def *table;  /* num_slots entries. */
+    const uint16_t *seeds;          /* num_buckets entries. */
+    uint32_t num_slots;             /* Always a power of two. */
+    uint32_t num_buckets;
+};
+
+extern const struct token_set token_set_list[];
+extern const int token_set_count;
+
+/**
+ * Finds a token set by name.
+ *
+ * @param name the name of the token set, which is that of the game it is for
+ *             (e.g. "gta3")
+ *
+ * @return the token set, or NULL if there is no token set with that name
+ */
+const struct token_set * token_set_find(const char *name);
+
+/**
+ * Looks up a token by name.
+ *
+ * @param set  the token set to look in
+ * @param name the token name, without the '~'s (need not be terminated)
+ * @param len  the length of the name
+ *
+ * @return the token, or NULL if the set has no token with that name
+ */
+const struct token_def * token_find(const struct token_set *set,
+                                    const char *name, size_t len);
+
+/**
+ * Hashes a token name for the token set tables. Must match the hash in
+ * cmake/GenerateTokens.cmake.
+ *
+ * @param name the token name
+ * @param len  the length of the name
+ * @param seed the seed for the name's bucket (0 to find the bucket)
+ *
+ * @return the hash
+ */
+uint32_t token_hash(const char *name, size_t len, uint32_t seed);
+
+#endif /* _GXTMAKER_TOKEN_H_ */
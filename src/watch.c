@@ -0,0 +1,387 @@
+/*
+ * Copyright (c) 2017 Wes Hampson <thehambone93@gmail.com>
+ *
+ * Licensed under the MIT License. See LICENSE at top level directory.
+ */
+
+#if !defined(_WIN32)
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__linux__)
+#include <dirent.h>
+#include <errno.h>
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+#include "array.h"
+#include "batch.h"
+#include "errwarn.h"
+#include "libgxtmaker.h"
+#include "watch.h"
+
+#define EVENT_BUF_SIZE 4096
+
+/**
+ * A source that has changed and is waiting to be compiled.
+ */
+struct pending_source
+{
+    char *name;             /* File name within the source directory. */
+};
+
+ARRAY_DECLARE(pending_list, struct pending_source)
+
+/**
+ * Where sources come from and go to, and how they are compiled.
+ */
+struct watcher
+{
+    const char *src_dir;
+    const char *out_dir;
+    struct compile_options opts;
+    enum stats_format stats_format;
+    struct compile_stats stats;
+    gxtmaker *g;            /* Kept for the whole watch, so its memory is
+                               reused from one compile to the next. */
+};
+
+#if defined(__linux__)
+static int run_watch(struct watcher *w);
+static bool compile_all(struct watcher *w);
+static bool read_events(int fd, struct pending_list *pending, bool *rescan);
+static bool add_pending(struct pending_list *pending, const char *name);
+static void clear_pending(struct pending_list *pending);
+static void recompile(struct watcher *w, const char *name);
+static bool is_source_name(const char *name);
+static char * join_path(const char *dir, const char *name);
+static void print_message(void *ctx, const char *msg);
+#endif
+
+int watch_directory(const char *src_dir, const char *out_dir, int num_jobs,
+                    const struct compile_options *opts,
+                    enum stats_format stats_format)
+{
+#if defined(__linux__)
+    struct watcher w;
+    memset(&w, 0, sizeof(struct watcher));
+    w.src_dir = src_dir;
+    w.out_dir = out_dir;
+    w.opts = *opts;
+    w.opts.num_threads = num_jobs;
+    w.opts.stats = (stats_format != STATS_NONE) ? &w.stats : NULL;
+    w.stats_format = stats_format;
+
+    if (!gxtmaker_create(&w.g, NULL, print_message, NULL))
+    {
+        return COMPILE_OUT_OF_MEMORY;
+    }
+
+    int status = run_watch(&w);
+    gxtmaker_destroy(&w.g);
+
+    return status;
+#else
+    /* There's no way to be told about changes here */
+    (void) out_dir;
+    (void) num_jobs;
+    (void) opts;
+    (void) stats_format;
+
+    error(NULL, E_UNWATCHABLE_DIR, src_dir);
+    return COMPILE_FILE_UNREADABLE;
+#endif
+}
+
+#if defined(__linux__)
+
+/**
+ * Watches the source directory until it can no longer be watched.
+ *
+ * Changed sources are collected until no more changes have come in for
+ * WATCH_DEBOUNCE_MS, then each is compiled once.
+ */
+static int run_watch(struct watcher *w)
+{
+    /* Start watching before the first compile, so that nothing saved while
+       it runs is missed */
+    int fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (fd < 0
+        || inotify_add_watch(fd, w->src_dir,
+                             IN_CLOSE_WRITE | IN_MOVED_TO | IN_DELETE_SELF
+                             | IN_MOVE_SELF | IN_ONLYDIR) < 0
+        || !compile_all(w))
+    {
+        error(NULL, E_UNWATCHABLE_DIR, w->src_dir);
+        if (fd >= 0)
+        {
+            close(fd);
+        }
+        return COMPILE_FILE_UNREADABLE;
+    }
+
+    note(NULL, N_WATCHING, w->src_dir);
+
+    struct pending_list pending;
+    pending_list_init(&pending);
+    bool rescan = false;
+    int status = COMPILE_SUCCESS;
+
+    for (;;)
+    {
+        struct pollfd pfd = { fd, POLLIN, 0 };
+        int timeout = (pending.len > 0 || rescan) ? WATCH_DEBOUNCE_MS : -1;
+        int n = poll(&pfd, 1, timeout);
+        if (n < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        else if (n < 0)
+        {
+            error(NULL, E_UNWATCHABLE_DIR, w->src_dir);
+            status = COMPILE_FILE_UNREADABLE;
+            break;
+        }
+        else if (n > 0)
+        {
+            if (!read_events(fd, &pending, &rescan))
+            {
+                error(NULL, E_UNWATCHABLE_DIR, w->src_dir);
+                status = COMPILE_FILE_UNREADABLE;
+                break;
+            }
+            continue;
+        }
+
+        /* Things have settled down */
+        if (rescan)
+        {
+            compile_all(w);
+        }
+        else
+        {
+            ARRAY_FOR_EACH(struct pending_source, src, &pending)
+            {
+                recompile(w, src->name);
+            }
+        }
+        clear_pending(&pending);
+        rescan = false;
+    }
+
+    clear_pending(&pending);
+    pending_list_free(&pending);
+    close(fd);
+
+    return status;
+}
+
+/**
+ * Compiles every source in the source directory.
+ *
+ * @return false if the directory could not be read
+ */
+static bool compile_all(struct watcher *w)
+{
+    DIR *dir = opendir(w->src_dir);
+    if (dir == NULL)
+    {
+        return false;
+    }
+
+    struct dirent *ent;
+    while ((ent = readdir(dir)) != NULL)
+    {
+        if (is_source_name(ent->d_name))
+        {
+            recompile(w, ent->d_name);
+        }
+    }
+
+    closedir(dir);
+
+    return true;
+}
+
+/**
+ * Reads every waiting inotify event, adding changed sources to the pending
+ * list. If events were lost, or memory ran out, rescan is set so that
+ * everything gets compiled.
+ *
+ * @return false if the directory has gone away or can't be read from
+ */
+static bool read_events(int fd, struct pending_list *pending, bool *rescan)
+{
+    _Alignas(struct inotify_event) char buf[EVENT_BUF_SIZE];
+
+    for (;;)
+    {
+        ssize_t len = read(fd, buf, sizeof(buf));
+        if (len < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+        {
+            return true;
+        }
+        else if (len <= 0)
+        {
+            return len < 0 && errno == EINTR;
+        }
+
+        const char *p = buf;
+        while (p < buf + len)
+        {
+            const struct inotify_event *ev = (const struct inotify_event *) p;
+            p += sizeof(struct inotify_event) + ev->len;
+
+            if (ev->mask & (IN_DELETE_SELF | IN_MOVE_SELF | IN_IGNORED))
+            {
+                return false;
+            }
+            else if (ev->mask & IN_Q_OVERFLOW)
+            {
+                *rescan = true;
+            }
+            else if (ev->len > 0 && is_source_name(ev->name)
+                     && !add_pending(pending, ev->name))
+            {
+                *rescan = true;
+            }
+        }
+    }
+}
+
+/**
+ * Adds a source to the pending list, unless it is already on it.
+ *
+ * @return false if memory could not be allocated
+ */
+static bool add_pending(struct pending_list *pending, const char *name)
+{
+    ARRAY_FOR_EACH(struct pending_source, src, pending)
+    {
+        if (strcmp(src->name, name) == 0)
+        {
+            return true;
+        }
+    }
+
+    size_t len = strlen(name);
+    char *copy = (char *) malloc(len + 1);
+    if (copy == NULL)
+    {
+        return false;
+    }
+    memcpy(copy, name, len + 1);
+
+    struct pending_source src = { copy };
+    if (!pending_list_push(pending, src))
+    {
+        free(copy);
+        return false;
+    }
+
+    return true;
+}
+
+static void clear_pending(struct pending_list *pending)
+{
+    ARRAY_FOR_EACH(struct pending_source, src, pending)
+    {
+        free(src->name);
+    }
+    pending->len = 0;
+}
+
+/**
+ * Compiles a source in the source directory and reports how long it took.
+ * Failures are reported through the gxtmaker diagnostics function.
+ */
+static void recompile(struct watcher *w, const char *name)
+{
+    char *src_path = join_path(w->src_dir, name);
+    char *out_path = (src_path != NULL)
+        ? make_out_path(src_path, w->out_dir, GXT_FILE_EXT)
+        : NULL;
+    if (out_path == NULL)
+    {
+        free(src_path);
+        return;
+    }
+
+    memset(&w->stats, 0, sizeof(struct compile_stats));
+
+    double start = stats_now();
+    int status = gxtmaker_compile_file(w->g, src_path, out_path, &w->opts);
+    double ms = (stats_now() - start) * 1000.0;
+
+    if (status == COMPILE_SUCCESS)
+    {
+        note(NULL, N_RECOMPILED, src_path, out_path, ms);
+        if (w->stats_format != STATS_NONE)
+        {
+            stats_print(&w->stats, src_path, w->stats_format, stdout);
+            fflush(stdout);
+        }
+    }
+
+    free(src_path);
+    free(out_path);
+}
+
+/**
+ * Checks whether a file name is that of a GXT source. Hidden files, such as
+ * those editors keep while a file is open, are not sources.
+ */
+static bool is_source_name(const char *name)
+{
+    size_t len = strlen(name);
+    size_t ext_len = strlen(SRC_FILE_EXT);
+
+    return name[0] != '.' && len > ext_len
+        && strcmp(name + len - ext_len, SRC_FILE_EXT) == 0;
+}
+
+/**
+ * Builds the path to a file in a directory.
+ *
+ * @return the path (must be freed by the caller),
+ *         or NULL if memory could not be allocated
+ */
+static char * join_path(const char *dir, const char *name)
+{
+    size_t dir_len = strlen(dir);
+    size_t name_len = strlen(name);
+
+    char *path = (char *) malloc(dir_len + 1 + name_len + 1);
+    if (path == NULL)
+    {
+        return NULL;
+    }
+
+    memcpy(path, dir, dir_len);
+    if (dir_len > 0 && dir[dir_len - 1] != '/' && dir[dir_len - 1] != '\\')
+    {
+        path[dir_len++] = '/';
+    }
+    memcpy(path + dir_len, name, name_len + 1);
+
+    return path;
+}
+
+/**
+ * Prints a diagnostic straight away (gxtmaker diagnostics function).
+ */
+static void print_message(void *ctx, const char *msg)
+{
+    (void) ctx;
+
+    fprintf(stderr, "%s\n", msg);
+}
+
+#endif /* __linux__ */
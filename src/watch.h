@@ -0,0 +1,46 @@
+/*
+ * Copyright (c) 2017 Wes Hampson <thehambone93@gmail.com>
+ *
+ * Licensed under the MIT License. See LICENSE at top level directory.
+ */
+
+#ifndef _GXTMAKER_WATCH_H_
+#define _GXTMAKER_WATCH_H_
+
+#include "compiler.h"
+#include "stats.h"
+
+/* How long a source must go unchanged before it is recompiled, so that a
+   burst of saves only compiles it once */
+#define WATCH_DEBOUNCE_MS 5
+
+/**
+ * Compiles every GXT source file (*.txt) in a directory, then keeps
+ * recompiling each one whenever it changes, until the process is stopped.
+ *
+ * Outputs are named and placed as for compile_batch(), and each is replaced
+ * all at once, so a game or tool reading it never sees a partly written
+ * file. Every compile runs in this process with the same gxtmaker instance,
+ * so memory from earlier compiles is reused, and with opts->use_cache only
+ * the entries that changed are re-encoded. Diagnostics and a line for each
+ * compiled file are printed to the standard error stream as they happen.
+ *
+ * Changes are only noticed on platforms that can report them (Linux).
+ *
+ * @param src_dir   the directory to watch
+ * @param out_dir   the directory to write compiled files to
+ * @param num_jobs  the number of threads to compile each file with
+ * @param opts      the settings to compile every file with; num_threads and
+ *                  stats are ignored and worked out from the other arguments
+ * @param stats     the format to print each compile's statistics to stdout
+ *                  in, or STATS_NONE to not collect them
+ *
+ * @return nonzero if the directory could not be watched, or stopped being
+ *         watchable (for instance by being deleted); it does not return
+ *         otherwise
+ */
+int watch_directory(const char *src_dir, const char *out_dir, int num_jobs,
+                    const struct compile_options *opts,
+                    enum stats_format stats);
+
+#endif /* _GXTMAKER_WATCH_H_ */
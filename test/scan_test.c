@@ -0,0 +1,385 @@
+/*
+ * Copyright (c) 2017 Wes Hampson <thehambone93@gmail.com>
+ *
+ * Licensed under the MIT License. See LICENSE at top level directory.
+ */
+
+/**
+ * Checks every vector scanner against its scalar reference implementation.
+ *
+ * Each file given is scanned from every start offset, both with short
+ * lengths that end partway through and just after 16- and 32-byte blocks,
+ * and with long lengths that run through many blocks. The vector scanners
+ * are static, so scan.c is built into this program directly. The AVX2
+ * scanners are only checked if the CPU supports them.
+ *
+ * Text never matches in the same byte lane often enough to overflow the
+ * counters, so the counters are also checked on a long run of one byte.
+ *
+ * Usage: scan_test file...
+ */
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "scan.c"
+
+#define MIN(a, b) ((a < b) ? (a) : (b))
+
+/* Longest "long" scan, in bytes, other than those that run to the end */
+#define LONG_SCAN_LEN   4096
+
+/* Offsets at which every delimiter set gets a long scan (coprime to 32, so
+   every alignment is covered) */
+#define LONG_SCAN_STEP  61
+
+/* Offsets below which counts run to the end of the file, far enough to
+   drain the byte-wide counters several times */
+#define FULL_COUNT_OFFSETS 64
+
+/* Size of the run of one byte the counters are checked on, enough to fill
+   the byte-wide counters of the widest scanner a few times over */
+#define RUN_SIZE (3 * MAX_COUNT_ITERATIONS * 32 + 100)
+
+/* Lengths each scan is checked with at every offset, besides (offset % 97)
+   and the long lengths */
+static const size_t short_lens[] =
+{
+    0, 1, 15, 16, 17, 31, 32, 33, 63, 64, 65
+};
+
+typedef size_t (*delims_fn)(const char *buf, size_t len,
+                            const char delims[SCAN_NUM_DELIMS]);
+typedef size_t (*count_fn)(const char *buf, size_t len, char c);
+typedef size_t (*delims16_fn)(const char *buf, size_t len,
+                              const uint16_t delims[SCAN_NUM_DELIMS]);
+typedef size_t (*count16_fn)(const char *buf, size_t len, uint16_t c);
+
+/**
+ * A scanner to check, along with whether it needs AVX2.
+ */
+struct impl
+{
+    const char *name;
+    void (*fn)(void);
+    bool needs_avx2;
+};
+
+#define IMPL(fn, needs_avx2) { #fn, (void (*)(void)) fn, needs_avx2 }
+
+static const struct impl delims_impls[] =
+{
+    IMPL(scan_delims, false),
+#if defined(SCAN_HAVE_SSE2)
+    IMPL(scan_delims_sse2, false),
+#endif
+#if defined(SCAN_HAVE_AVX2)
+    IMPL(scan_delims_avx2, true),
+#endif
+};
+
+static const struct impl count_impls[] =
+{
+    IMPL(scan_count, false),
+#if defined(SCAN_HAVE_SSE2)
+    IMPL(scan_count_sse2, false),
+#endif
+#if defined(SCAN_HAVE_AVX2)
+    IMPL(scan_count_avx2, true),
+#endif
+};
+
+static const struct impl delims16_impls[] =
+{
+    IMPL(scan_delims16, false),
+#if defined(SCAN_HAVE_SSE2)
+    IMPL(scan_delims16_sse2, false),
+#endif
+#if defined(SCAN_HAVE_AVX2)
+    IMPL(scan_delims16_avx2, true),
+#endif
+};
+
+static const struct impl count16_impls[] =
+{
+    IMPL(scan_count16, false),
+#if defined(SCAN_HAVE_SSE2)
+    IMPL(scan_count16_sse2, false),
+#endif
+};
+
+#define NUM_IMPLS(list) (sizeof(list) / sizeof(list[0]))
+
+/**
+ * The delimiters a file is scanned for.
+ */
+struct scan_sets
+{
+    char common[SCAN_NUM_DELIMS];       /* Found on most lines. */
+    char rare[SCAN_NUM_DELIMS];
+    char high[SCAN_NUM_DELIMS];         /* Bytes with the top bit set. */
+    uint16_t units[SCAN_NUM_DELIMS];    /* Units taken from the file. */
+};
+
+static bool has_avx2;
+static int num_failures;
+
+static char * read_file(const char *path, size_t *size);
+static void check_file(const char *path, const char *data, size_t size);
+static void check_run(void);
+static void check_delims(const char *path, const char *data,
+                         size_t offset, size_t len,
+                         const char delims[SCAN_NUM_DELIMS]);
+static void check_count(const char *path, const char *data,
+                        size_t offset, size_t len, char c);
+static void check_delims16(const char *path, const char *data,
+                           size_t offset, size_t len,
+                           const uint16_t delims[SCAN_NUM_DELIMS]);
+static void check_count16(const char *path, const char *data,
+                          size_t offset, size_t len, uint16_t c);
+static bool is_checked(const struct impl *impl);
+static void report(const char *path, const char *name, size_t offset,
+                   size_t len, size_t expected, size_t actual);
+
+int main(int argc, char *argv[])
+{
+#if defined(SCAN_HAVE_AVX2)
+    has_avx2 = __builtin_cpu_supports("avx2");
+#endif
+
+    if (argc < 2)
+    {
+        fprintf(stderr, "usage: scan_test file...\n");
+        return 2;
+    }
+
+    check_run();
+
+    for (int i = 1; i < argc; i++)
+    {
+        size_t size;
+        char *data = read_file(argv[i], &size);
+        if (data == NULL)
+        {
+            fprintf(stderr, "%s: unable to read file\n", argv[i]);
+            return 2;
+        }
+
+        check_file(argv[i], data, size);
+        free(data);
+    }
+
+    printf("%s vector scanners against the scalar ones: %d failures\n",
+           has_avx2 ? "SSE2 and AVX2" : "SSE2", num_failures);
+
+    return (num_failures == 0) ? 0 : 1;
+}
+
+/**
+ * Reads a whole file into a buffer of its own size, so that any read past
+ * its end can be caught by a memory checker.
+ */
+static char * read_file(const char *path, size_t *size)
+{
+    FILE *f = fopen(path, "rb");
+    if (f == NULL)
+    {
+        return NULL;
+    }
+
+    fseek(f, 0, SEEK_END);
+    long end = ftell(f);
+    fseek(f, 0, SEEK_SET);
+
+    char *data = (end >= 0) ? (char *) malloc((size_t) end + 1) : NULL;
+    if (data != NULL && fread(data, 1, (size_t) end, f) != (size_t) end)
+    {
+        free(data);
+        data = NULL;
+    }
+    fclose(f);
+
+    *size = (size_t) end;
+    return data;
+}
+
+static void check_file(const char *path, const char *data, size_t size)
+{
+    struct scan_sets sets =
+    {
+        { '[', '{', '\n', '\r' },
+        { '~', '~', '~', '~' },
+        { (char) 0xC3, (char) 0xE2, (char) 0x80, (char) 0xA9 },
+        { 0, 0, 0, 0 }
+    };
+
+    /* Take units from the file itself, so that they are found */
+    for (int i = 0; i < SCAN_NUM_DELIMS && size >= 2; i++)
+    {
+        sets.units[i] = load_unit(data + (size - 2) * (i + 1) / 5);
+    }
+
+    for (size_t offset = 0; offset < size; offset++)
+    {
+        size_t rest = size - offset;
+        size_t long_len = MIN(rest, LONG_SCAN_LEN);
+        bool is_long_offset = (offset % LONG_SCAN_STEP == 0);
+
+        for (size_t i = 0; i <= NUM_IMPLS(short_lens); i++)
+        {
+            size_t len = (i < NUM_IMPLS(short_lens)) ? short_lens[i]
+                                                     : offset % 97;
+            if (len > rest)
+            {
+                continue;
+            }
+
+            check_delims(path, data, offset, len, sets.common);
+            check_delims(path, data, offset, len, sets.rare);
+            check_delims(path, data, offset, len, sets.high);
+            check_count(path, data, offset, len, '\n');
+            check_count(path, data, offset, len, (char) 0xC3);
+
+            if (len * 2 <= rest)
+            {
+                check_delims16(path, data, offset, len, sets.units);
+                check_count16(path, data, offset, len, sets.units[0]);
+            }
+        }
+
+        /* A scan for common delimiters stops soon, so it can always run to
+           the end of the file */
+        check_delims(path, data, offset, rest, sets.common);
+
+        if (is_long_offset)
+        {
+            check_delims(path, data, offset, long_len, sets.rare);
+            check_delims(path, data, offset, long_len, sets.high);
+            check_delims16(path, data, offset, long_len / 2,
+                           sets.units);
+            check_count(path, data, offset, long_len, '\n');
+            check_count16(path, data, offset, long_len / 2,
+                          sets.units[1]);
+        }
+
+        if (offset < FULL_COUNT_OFFSETS)
+        {
+            check_count(path, data, offset, rest, '\n');
+            check_count(path, data, offset, rest, ' ');
+            check_count16(path, data, offset, rest / 2,
+                          sets.units[2]);
+        }
+    }
+}
+
+static void check_run(void)
+{
+    static char run[RUN_SIZE];
+    memset(run, 'x', sizeof(run));
+
+    for (size_t offset = 0; offset < 32; offset++)
+    {
+        size_t len = sizeof(run) - offset;
+        check_count("run", run, offset, len, 'x');
+        check_count16("run", run, offset, len / 2, ('x' << 8) | 'x');
+    }
+}
+
+static void check_delims(const char *path, const char *data,
+                         size_t offset, size_t len,
+                         const char delims[SCAN_NUM_DELIMS])
+{
+    size_t expected = scan_delims_scalar(data + offset, len, delims);
+
+    for (size_t i = 0; i < NUM_IMPLS(delims_impls); i++)
+    {
+        const struct impl *impl = &delims_impls[i];
+        if (is_checked(impl))
+        {
+            size_t actual = ((delims_fn) impl->fn)(data + offset, len, delims);
+            if (actual != expected)
+            {
+                report(path, impl->name, offset, len, expected, actual);
+            }
+        }
+    }
+}
+
+static void check_count(const char *path, const char *data,
+                        size_t offset, size_t len, char c)
+{
+    size_t expected = scan_count_scalar(data + offset, len, c);
+
+    for (size_t i = 0; i < NUM_IMPLS(count_impls); i++)
+    {
+        const struct impl *impl = &count_impls[i];
+        if (is_checked(impl))
+        {
+            size_t actual = ((count_fn) impl->fn)(data + offset, len, c);
+            if (actual != expected)
+            {
+                report(path, impl->name, offset, len, expected, actual);
+            }
+        }
+    }
+}
+
+static void check_delims16(const char *path, const char *data,
+                           size_t offset, size_t len,
+                           const uint16_t delims[SCAN_NUM_DELIMS])
+{
+    size_t expected = scan_delims16_scalar(data + offset, len, delims);
+
+    for (size_t i = 0; i < NUM_IMPLS(delims16_impls); i++)
+    {
+        const struct impl *impl = &delims16_impls[i];
+        if (is_checked(impl))
+        {
+            size_t actual =
+                ((delims16_fn) impl->fn)(data + offset, len, delims);
+            if (actual != expected)
+            {
+                report(path, impl->name, offset, len, expected, actual);
+            }
+        }
+    }
+}
+
+static void check_count16(const char *path, const char *data,
+                          size_t offset, size_t len, uint16_t c)
+{
+    size_t expected = scan_count16_scalar(data + offset, len, c);
+
+    for (size_t i = 0; i < NUM_IMPLS(count16_impls); i++)
+    {
+        const struct impl *impl = &count16_impls[i];
+        if (is_checked(impl))
+        {
+            size_t actual = ((count16_fn) impl->fn)(data + offset, len, c);
+            if (actual != expected)
+            {
+                report(path, impl->name, offset, len, expected, actual);
+            }
+        }
+    }
+}
+
+static bool is_checked(const struct impl *impl)
+{
+    return !impl->needs_avx2 || has_avx2;
+}
+
+/**
+ * Reports a scanner that disagreed with its reference. Only the first few
+ * failures are printed.
+ */
+static void report(const char *path, const char *name, size_t offset,
+                   size_t len, size_t expected, size_t actual)
+{
+    if (num_failures++ < 20)
+    {
+        fprintf(stderr, "%s: %s at offset %zu, length %zu: expected %zu, "
+                "got %zu\n", path, name, offset, len, expected, actual);
+    }
+}